@@ -51,6 +51,7 @@ void HardFault_Handler(void);
 void SVC_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
+void TIM16_FDCAN_IT0_IRQHandler(void);
 void USB_UCPD1_2_IRQHandler(void);
 /* USER CODE BEGIN EFP */
 
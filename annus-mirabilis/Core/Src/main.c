@@ -29,6 +29,7 @@
 #include "usbd_cdc_if.h"
 #include "buffer.h"
 #include "can.h"
+#include "event.h"
 #include "led.h"
 #include "nvm.h"
 #include "slcan.h"
@@ -103,8 +104,8 @@ int main(void)
   buf_init();
   can_init();
   nvm_init();
-  led_blink_sequence(5);
   nvm_apply_startup_cfg();
+  led_blink_sequence(5);
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -114,9 +115,31 @@ int main(void)
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
-    led_process();
-    can_process();
-    buf_process();
+    // Sleep until an interrupt posts work, then do the most urgent one
+    switch (event_wait())
+    {
+    case EVENT_CAN_RX:
+      can_process_rx();
+      break;
+    case EVENT_CDC_RX:
+      buf_process_cdc_rx();
+      break;
+    case EVENT_CAN_TX:
+      buf_process_can_tx();
+      break;
+    case EVENT_CDC_TX:
+      buf_process_cdc_tx();
+      break;
+    case EVENT_TICK:
+      can_process_status();
+      buf_process_can_tx();
+      buf_process_cdc_tx();
+      led_process();
+      nvm_process();
+      break;
+    default:
+      break;
+    }
   }
   /* USER CODE END 3 */
 }
@@ -50,6 +50,19 @@ extern "C" {
 #define CDC_CMD_EP                                  0x82U  /* EP2 for CDC commands */
 #endif /* CDC_CMD_EP  */
 
+/* Second ACM function (interfaces 2 and 3) */
+#ifndef CDC2_IN_EP
+#define CDC2_IN_EP                                  0x83U  /* EP3 for data IN */
+#endif /* CDC2_IN_EP */
+#ifndef CDC2_OUT_EP
+#define CDC2_OUT_EP                                 0x03U  /* EP3 for data OUT */
+#endif /* CDC2_OUT_EP */
+#ifndef CDC2_CMD_EP
+#define CDC2_CMD_EP                                 0x84U  /* EP4 for CDC commands */
+#endif /* CDC2_CMD_EP  */
+
+#define CDC_NUM_PORTS                               2U  /* ACM functions in the configuration */
+
 #ifndef CDC_HS_BINTERVAL
 #define CDC_HS_BINTERVAL                            0x10U
 #endif /* CDC_HS_BINTERVAL */
@@ -63,7 +76,8 @@ extern "C" {
 #define CDC_DATA_FS_MAX_PACKET_SIZE                 64U  /* Endpoint IN & OUT Packet size */
 #define CDC_CMD_PACKET_SIZE                         8U  /* Control Endpoint Packet size */
 
-#define USB_CDC_CONFIG_DESC_SIZ                     67U
+#define USB_CDC_FUNC_DESC_SIZ                       66U  /* IAD + ACM interfaces + endpoints */
+#define USB_CDC_CONFIG_DESC_SIZ                     (9U + (CDC_NUM_PORTS * USB_CDC_FUNC_DESC_SIZ))
 #define CDC_DATA_HS_IN_PACKET_SIZE                  CDC_DATA_HS_MAX_PACKET_SIZE
 #define CDC_DATA_HS_OUT_PACKET_SIZE                 CDC_DATA_HS_MAX_PACKET_SIZE
 
@@ -151,20 +165,14 @@ extern USBD_ClassTypeDef USBD_CDC;
 /** @defgroup USB_CORE_Exported_Functions
   * @{
   */
-uint8_t USBD_CDC_RegisterInterface(USBD_HandleTypeDef *pdev,
+uint8_t USBD_CDC_RegisterInterface(USBD_HandleTypeDef *pdev, uint8_t port,
                                    USBD_CDC_ItfTypeDef *fops);
 
-#ifdef USE_USBD_COMPOSITE
-uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff,
-                             uint32_t length, uint8_t ClassId);
-uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev, uint8_t ClassId);
-#else
-uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff,
-                             uint32_t length);
-uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev);
-#endif /* USE_USBD_COMPOSITE */
-uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff);
-uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev);
+uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t port,
+                             uint8_t *pbuff, uint32_t length);
+uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev, uint8_t port);
+uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t port, uint8_t *pbuff);
+uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev, uint8_t port);
 /**
   * @}
   */
@@ -33,6 +33,7 @@
   *             - Device descriptor management
   *             - Configuration descriptor management
   *             - Enumeration as CDC device with 2 data endpoints (IN and OUT) and 1 command endpoint (IN)
+  *               per port, each port grouped by an Interface Association Descriptor
   *             - Requests management (as described in section 6.2 in specification)
   *             - Abstract Control Model compliant
   *             - Union Functional collection (using 1 IN endpoint for control)
@@ -165,15 +166,103 @@ USBD_ClassTypeDef  USBD_CDC =
 };
 
 #ifndef USE_USBD_COMPOSITE
+/* One ACM function: IAD, communication interface and data interface */
+#define USBD_CDC_FUNC_DESC(if_num, cmd_ep, out_ep, in_ep)                                                 \
+  /* Interface Association Descriptor */                                                               \
+  USB_IAD_DESC_SIZE,                          /* bLength: IAD size */                                  \
+  USB_DESC_TYPE_IAD,                          /* bDescriptorType: Interface Association */             \
+  (if_num),                                   /* bFirstInterface */                                    \
+  0x02,                                       /* bInterfaceCount */                                    \
+  0x02,                                       /* bFunctionClass: Communication Interface Class */      \
+  0x02,                                       /* bFunctionSubClass: Abstract Control Model */          \
+  0x01,                                       /* bFunctionProtocol: Common AT commands */              \
+  0x00,                                       /* iFunction */                                          \
+                                                                                                       \
+  /* Interface Descriptor */                                                                           \
+  0x09,                                       /* bLength: Interface Descriptor size */                 \
+  USB_DESC_TYPE_INTERFACE,                    /* bDescriptorType: Interface */                         \
+  (if_num),                                   /* bInterfaceNumber: Number of Interface */              \
+  0x00,                                       /* bAlternateSetting: Alternate setting */               \
+  0x01,                                       /* bNumEndpoints: One endpoint used */                   \
+  0x02,                                       /* bInterfaceClass: Communication Interface Class */     \
+  0x02,                                       /* bInterfaceSubClass: Abstract Control Model */         \
+  0x01,                                       /* bInterfaceProtocol: Common AT commands */             \
+  0x00,                                       /* iInterface */                                         \
+                                                                                                       \
+  /* Header Functional Descriptor */                                                                   \
+  0x05,                                       /* bLength: Endpoint Descriptor size */                  \
+  0x24,                                       /* bDescriptorType: CS_INTERFACE */                      \
+  0x00,                                       /* bDescriptorSubtype: Header Func Desc */               \
+  0x10,                                       /* bcdCDC: spec release number */                        \
+  0x01,                                                                                                \
+                                                                                                       \
+  /* Call Management Functional Descriptor */                                                          \
+  0x05,                                       /* bFunctionLength */                                    \
+  0x24,                                       /* bDescriptorType: CS_INTERFACE */                      \
+  0x01,                                       /* bDescriptorSubtype: Call Management Func Desc */      \
+  0x00,                                       /* bmCapabilities: D0+D1 */                              \
+  (if_num) + 1U,                              /* bDataInterface */                                     \
+                                                                                                       \
+  /* ACM Functional Descriptor */                                                                      \
+  0x04,                                       /* bFunctionLength */                                    \
+  0x24,                                       /* bDescriptorType: CS_INTERFACE */                      \
+  0x02,                                       /* bDescriptorSubtype: Abstract Control Management desc */ \
+  0x02,                                       /* bmCapabilities */                                     \
+                                                                                                       \
+  /* Union Functional Descriptor */                                                                    \
+  0x05,                                       /* bFunctionLength */                                    \
+  0x24,                                       /* bDescriptorType: CS_INTERFACE */                      \
+  0x06,                                       /* bDescriptorSubtype: Union func desc */                \
+  (if_num),                                   /* bMasterInterface: Communication class interface */    \
+  (if_num) + 1U,                              /* bSlaveInterface0: Data Class Interface */             \
+                                                                                                       \
+  /* Command Endpoint Descriptor */                                                                    \
+  0x07,                                       /* bLength: Endpoint Descriptor size */                  \
+  USB_DESC_TYPE_ENDPOINT,                     /* bDescriptorType: Endpoint */                          \
+  (cmd_ep),                                   /* bEndpointAddress */                                   \
+  0x03,                                       /* bmAttributes: Interrupt */                            \
+  LOBYTE(CDC_CMD_PACKET_SIZE),                /* wMaxPacketSize */                                     \
+  HIBYTE(CDC_CMD_PACKET_SIZE),                                                                         \
+  CDC_FS_BINTERVAL,                           /* bInterval */                                          \
+                                                                                                       \
+  /* Data class interface descriptor */                                                                \
+  0x09,                                       /* bLength: Endpoint Descriptor size */                  \
+  USB_DESC_TYPE_INTERFACE,                    /* bDescriptorType: */                                   \
+  (if_num) + 1U,                              /* bInterfaceNumber: Number of Interface */              \
+  0x00,                                       /* bAlternateSetting: Alternate setting */               \
+  0x02,                                       /* bNumEndpoints: Two endpoints used */                  \
+  0x0A,                                       /* bInterfaceClass: CDC */                               \
+  0x00,                                       /* bInterfaceSubClass */                                 \
+  0x00,                                       /* bInterfaceProtocol */                                 \
+  0x00,                                       /* iInterface */                                         \
+                                                                                                       \
+  /* Endpoint OUT Descriptor */                                                                        \
+  0x07,                                       /* bLength: Endpoint Descriptor size */                  \
+  USB_DESC_TYPE_ENDPOINT,                     /* bDescriptorType: Endpoint */                          \
+  (out_ep),                                   /* bEndpointAddress */                                   \
+  0x02,                                       /* bmAttributes: Bulk */                                 \
+  LOBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),        /* wMaxPacketSize */                                     \
+  HIBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),                                                                 \
+  0x00,                                       /* bInterval */                                          \
+                                                                                                       \
+  /* Endpoint IN Descriptor */                                                                         \
+  0x07,                                       /* bLength: Endpoint Descriptor size */                  \
+  USB_DESC_TYPE_ENDPOINT,                     /* bDescriptorType: Endpoint */                          \
+  (in_ep),                                    /* bEndpointAddress */                                   \
+  0x02,                                       /* bmAttributes: Bulk */                                 \
+  LOBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),        /* wMaxPacketSize */                                     \
+  HIBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),                                                                 \
+  0x00                                        /* bInterval */
+
 /* USB CDC device Configuration Descriptor */
 __ALIGN_BEGIN static uint8_t USBD_CDC_CfgDesc[USB_CDC_CONFIG_DESC_SIZ] __ALIGN_END =
 {
   /* Configuration Descriptor */
   0x09,                                       /* bLength: Configuration Descriptor size */
   USB_DESC_TYPE_CONFIGURATION,                /* bDescriptorType: Configuration */
-  USB_CDC_CONFIG_DESC_SIZ,                    /* wTotalLength */
-  0x00,
-  0x02,                                       /* bNumInterfaces: 2 interfaces */
+  LOBYTE(USB_CDC_CONFIG_DESC_SIZ),            /* wTotalLength */
+  HIBYTE(USB_CDC_CONFIG_DESC_SIZ),
+  CDC_NUM_PORTS * 2U,                         /* bNumInterfaces: 2 interfaces per port */
   0x01,                                       /* bConfigurationValue: Configuration value */
   0x00,                                       /* iConfiguration: Index of string descriptor
                                                  describing the configuration */
@@ -185,90 +274,22 @@ __ALIGN_BEGIN static uint8_t USBD_CDC_CfgDesc[USB_CDC_CONFIG_DESC_SIZ] __ALIGN_E
   USBD_MAX_POWER,                             /* MaxPower (mA) */
 
   /*---------------------------------------------------------------------------*/
+  USBD_CDC_FUNC_DESC(0x00U, CDC_CMD_EP, CDC_OUT_EP, CDC_IN_EP),
 
-  /* Interface Descriptor */
-  0x09,                                       /* bLength: Interface Descriptor size */
-  USB_DESC_TYPE_INTERFACE,                    /* bDescriptorType: Interface */
-  /* Interface descriptor type */
-  0x00,                                       /* bInterfaceNumber: Number of Interface */
-  0x00,                                       /* bAlternateSetting: Alternate setting */
-  0x01,                                       /* bNumEndpoints: One endpoint used */
-  0x02,                                       /* bInterfaceClass: Communication Interface Class */
-  0x02,                                       /* bInterfaceSubClass: Abstract Control Model */
-  0x01,                                       /* bInterfaceProtocol: Common AT commands */
-  0x00,                                       /* iInterface */
-
-  /* Header Functional Descriptor */
-  0x05,                                       /* bLength: Endpoint Descriptor size */
-  0x24,                                       /* bDescriptorType: CS_INTERFACE */
-  0x00,                                       /* bDescriptorSubtype: Header Func Desc */
-  0x10,                                       /* bcdCDC: spec release number */
-  0x01,
-
-  /* Call Management Functional Descriptor */
-  0x05,                                       /* bFunctionLength */
-  0x24,                                       /* bDescriptorType: CS_INTERFACE */
-  0x01,                                       /* bDescriptorSubtype: Call Management Func Desc */
-  0x00,                                       /* bmCapabilities: D0+D1 */
-  0x01,                                       /* bDataInterface */
-
-  /* ACM Functional Descriptor */
-  0x04,                                       /* bFunctionLength */
-  0x24,                                       /* bDescriptorType: CS_INTERFACE */
-  0x02,                                       /* bDescriptorSubtype: Abstract Control Management desc */
-  0x02,                                       /* bmCapabilities */
-
-  /* Union Functional Descriptor */
-  0x05,                                       /* bFunctionLength */
-  0x24,                                       /* bDescriptorType: CS_INTERFACE */
-  0x06,                                       /* bDescriptorSubtype: Union func desc */
-  0x00,                                       /* bMasterInterface: Communication class interface */
-  0x01,                                       /* bSlaveInterface0: Data Class Interface */
-
-  /* Endpoint 2 Descriptor */
-  0x07,                                       /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,                     /* bDescriptorType: Endpoint */
-  CDC_CMD_EP,                                 /* bEndpointAddress */
-  0x03,                                       /* bmAttributes: Interrupt */
-  LOBYTE(CDC_CMD_PACKET_SIZE),                /* wMaxPacketSize */
-  HIBYTE(CDC_CMD_PACKET_SIZE),
-  CDC_FS_BINTERVAL,                           /* bInterval */
   /*---------------------------------------------------------------------------*/
-
-  /* Data class interface descriptor */
-  0x09,                                       /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_INTERFACE,                    /* bDescriptorType: */
-  0x01,                                       /* bInterfaceNumber: Number of Interface */
-  0x00,                                       /* bAlternateSetting: Alternate setting */
-  0x02,                                       /* bNumEndpoints: Two endpoints used */
-  0x0A,                                       /* bInterfaceClass: CDC */
-  0x00,                                       /* bInterfaceSubClass */
-  0x00,                                       /* bInterfaceProtocol */
-  0x00,                                       /* iInterface */
-
-  /* Endpoint OUT Descriptor */
-  0x07,                                       /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,                     /* bDescriptorType: Endpoint */
-  CDC_OUT_EP,                                 /* bEndpointAddress */
-  0x02,                                       /* bmAttributes: Bulk */
-  LOBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),        /* wMaxPacketSize */
-  HIBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),
-  0x00,                                       /* bInterval */
-
-  /* Endpoint IN Descriptor */
-  0x07,                                       /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,                     /* bDescriptorType: Endpoint */
-  CDC_IN_EP,                                  /* bEndpointAddress */
-  0x02,                                       /* bmAttributes: Bulk */
-  LOBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),        /* wMaxPacketSize */
-  HIBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),
-  0x00                                        /* bInterval */
+  USBD_CDC_FUNC_DESC(0x02U, CDC2_CMD_EP, CDC2_OUT_EP, CDC2_IN_EP)
 };
 #endif /* USE_USBD_COMPOSITE  */
 
-static uint8_t CDCInEpAdd = CDC_IN_EP;
-static uint8_t CDCOutEpAdd = CDC_OUT_EP;
-static uint8_t CDCCmdEpAdd = CDC_CMD_EP;
+#ifdef USE_USBD_COMPOSITE
+#error "The dual port CDC class does not support the composite builder"
+#endif /* USE_USBD_COMPOSITE */
+
+static const uint8_t CDCInEpAdd[CDC_NUM_PORTS] = {CDC_IN_EP, CDC2_IN_EP};
+static const uint8_t CDCOutEpAdd[CDC_NUM_PORTS] = {CDC_OUT_EP, CDC2_OUT_EP};
+static const uint8_t CDCCmdEpAdd[CDC_NUM_PORTS] = {CDC_CMD_EP, CDC2_CMD_EP};
+
+static USBD_CDC_ItfTypeDef *CDCItf[CDC_NUM_PORTS];
 
 /**
   * @}
@@ -278,6 +299,47 @@ static uint8_t CDCCmdEpAdd = CDC_CMD_EP;
   * @{
   */
 
+/**
+  * @brief  USBD_CDC_GetHandle
+  *         Return the handle of a port (the class data holds one per port)
+  * @param  pdev: device instance
+  * @param  port: port index
+  * @retval handle or NULL
+  */
+static USBD_CDC_HandleTypeDef *USBD_CDC_GetHandle(USBD_HandleTypeDef *pdev, uint8_t port)
+{
+  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  if ((hcdc == NULL) || (port >= CDC_NUM_PORTS))
+  {
+    return NULL;
+  }
+
+  return &hcdc[port];
+}
+
+/**
+  * @brief  USBD_CDC_GetPort
+  *         Find the port owning a data endpoint
+  * @param  epnum: endpoint number (direction bit ignored)
+  * @retval port index or CDC_NUM_PORTS if not found
+  */
+static uint8_t USBD_CDC_GetPort(uint8_t epnum)
+{
+  uint8_t port;
+
+  for (port = 0U; port < CDC_NUM_PORTS; port++)
+  {
+    if (((epnum & 0xFU) == (CDCInEpAdd[port] & 0xFU)) ||
+        ((epnum & 0xFU) == (CDCOutEpAdd[port] & 0xFU)))
+    {
+      break;
+    }
+  }
+
+  return port;
+}
+
 /**
   * @brief  USBD_CDC_Init
   *         Initialize the CDC interface
@@ -289,8 +351,9 @@ static uint8_t USBD_CDC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 {
   UNUSED(cfgidx);
   USBD_CDC_HandleTypeDef *hcdc;
+  uint8_t port;
 
-  hcdc = (USBD_CDC_HandleTypeDef *)USBD_malloc(sizeof(USBD_CDC_HandleTypeDef));
+  hcdc = (USBD_CDC_HandleTypeDef *)USBD_malloc(sizeof(USBD_CDC_HandleTypeDef) * CDC_NUM_PORTS);
 
   if (hcdc == NULL)
   {
@@ -298,82 +361,82 @@ static uint8_t USBD_CDC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
     return (uint8_t)USBD_EMEM;
   }
 
-  (void)USBD_memset(hcdc, 0, sizeof(USBD_CDC_HandleTypeDef));
+  (void)USBD_memset(hcdc, 0, sizeof(USBD_CDC_HandleTypeDef) * CDC_NUM_PORTS);
 
   pdev->pClassDataCmsit[pdev->classId] = (void *)hcdc;
   pdev->pClassData = pdev->pClassDataCmsit[pdev->classId];
 
-#ifdef USE_USBD_COMPOSITE
-  /* Get the Endpoints addresses allocated for this class instance */
-  CDCInEpAdd  = USBD_CoreGetEPAdd(pdev, USBD_EP_IN, USBD_EP_TYPE_BULK, (uint8_t)pdev->classId);
-  CDCOutEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_OUT, USBD_EP_TYPE_BULK, (uint8_t)pdev->classId);
-  CDCCmdEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_IN, USBD_EP_TYPE_INTR, (uint8_t)pdev->classId);
-#endif /* USE_USBD_COMPOSITE */
-
-  if (pdev->dev_speed == USBD_SPEED_HIGH)
+  for (port = 0U; port < CDC_NUM_PORTS; port++)
   {
-    /* Open EP IN */
-    (void)USBD_LL_OpenEP(pdev, CDCInEpAdd, USBD_EP_TYPE_BULK,
-                         CDC_DATA_HS_IN_PACKET_SIZE);
+    if (pdev->dev_speed == USBD_SPEED_HIGH)
+    {
+      /* Open EP IN */
+      (void)USBD_LL_OpenEP(pdev, CDCInEpAdd[port], USBD_EP_TYPE_BULK,
+                           CDC_DATA_HS_IN_PACKET_SIZE);
 
-    pdev->ep_in[CDCInEpAdd & 0xFU].is_used = 1U;
+      pdev->ep_in[CDCInEpAdd[port] & 0xFU].is_used = 1U;
 
-    /* Open EP OUT */
-    (void)USBD_LL_OpenEP(pdev, CDCOutEpAdd, USBD_EP_TYPE_BULK,
-                         CDC_DATA_HS_OUT_PACKET_SIZE);
+      /* Open EP OUT */
+      (void)USBD_LL_OpenEP(pdev, CDCOutEpAdd[port], USBD_EP_TYPE_BULK,
+                           CDC_DATA_HS_OUT_PACKET_SIZE);
 
-    pdev->ep_out[CDCOutEpAdd & 0xFU].is_used = 1U;
+      pdev->ep_out[CDCOutEpAdd[port] & 0xFU].is_used = 1U;
 
-    /* Set bInterval for CDC CMD Endpoint */
-    pdev->ep_in[CDCCmdEpAdd & 0xFU].bInterval = CDC_HS_BINTERVAL;
-  }
-  else
-  {
-    /* Open EP IN */
-    (void)USBD_LL_OpenEP(pdev, CDCInEpAdd, USBD_EP_TYPE_BULK,
-                         CDC_DATA_FS_IN_PACKET_SIZE);
+      /* Set bInterval for CDC CMD Endpoint */
+      pdev->ep_in[CDCCmdEpAdd[port] & 0xFU].bInterval = CDC_HS_BINTERVAL;
+    }
+    else
+    {
+      /* Open EP IN */
+      (void)USBD_LL_OpenEP(pdev, CDCInEpAdd[port], USBD_EP_TYPE_BULK,
+                           CDC_DATA_FS_IN_PACKET_SIZE);
 
-    pdev->ep_in[CDCInEpAdd & 0xFU].is_used = 1U;
+      pdev->ep_in[CDCInEpAdd[port] & 0xFU].is_used = 1U;
 
-    /* Open EP OUT */
-    (void)USBD_LL_OpenEP(pdev, CDCOutEpAdd, USBD_EP_TYPE_BULK,
-                         CDC_DATA_FS_OUT_PACKET_SIZE);
+      /* Open EP OUT */
+      (void)USBD_LL_OpenEP(pdev, CDCOutEpAdd[port], USBD_EP_TYPE_BULK,
+                           CDC_DATA_FS_OUT_PACKET_SIZE);
 
-    pdev->ep_out[CDCOutEpAdd & 0xFU].is_used = 1U;
+      pdev->ep_out[CDCOutEpAdd[port] & 0xFU].is_used = 1U;
 
-    /* Set bInterval for CMD Endpoint */
-    pdev->ep_in[CDCCmdEpAdd & 0xFU].bInterval = CDC_FS_BINTERVAL;
-  }
+      /* Set bInterval for CMD Endpoint */
+      pdev->ep_in[CDCCmdEpAdd[port] & 0xFU].bInterval = CDC_FS_BINTERVAL;
+    }
 
-  /* Open Command IN EP */
-  (void)USBD_LL_OpenEP(pdev, CDCCmdEpAdd, USBD_EP_TYPE_INTR, CDC_CMD_PACKET_SIZE);
-  pdev->ep_in[CDCCmdEpAdd & 0xFU].is_used = 1U;
+    /* Open Command IN EP */
+    (void)USBD_LL_OpenEP(pdev, CDCCmdEpAdd[port], USBD_EP_TYPE_INTR, CDC_CMD_PACKET_SIZE);
+    pdev->ep_in[CDCCmdEpAdd[port] & 0xFU].is_used = 1U;
 
-  hcdc->RxBuffer = NULL;
+    hcdc[port].RxBuffer = NULL;
+    hcdc[port].CmdOpCode = 0xFFU;
 
-  /* Init  physical Interface components */
-  ((USBD_CDC_ItfTypeDef *)pdev->pUserData[pdev->classId])->Init();
+    /* Init  physical Interface components */
+    if (CDCItf[port] != NULL)
+    {
+      CDCItf[port]->Init();
+    }
 
-  /* Init Xfer states */
-  hcdc->TxState = 0U;
-  hcdc->RxState = 0U;
+    /* Init Xfer states */
+    hcdc[port].TxState = 0U;
+    hcdc[port].RxState = 0U;
 
-  if (hcdc->RxBuffer == NULL)
-  {
-    return (uint8_t)USBD_EMEM;
-  }
+    if (hcdc[port].RxBuffer == NULL)
+    {
+      return (uint8_t)USBD_EMEM;
+    }
 
-  if (pdev->dev_speed == USBD_SPEED_HIGH)
-  {
-    /* Prepare Out endpoint to receive next packet */
-    (void)USBD_LL_PrepareReceive(pdev, CDCOutEpAdd, hcdc->RxBuffer,
-                                 CDC_DATA_HS_OUT_PACKET_SIZE);
-  }
-  else
-  {
-    /* Prepare Out endpoint to receive next packet */
-    (void)USBD_LL_PrepareReceive(pdev, CDCOutEpAdd, hcdc->RxBuffer,
-                                 CDC_DATA_FS_OUT_PACKET_SIZE);
+    if (pdev->dev_speed == USBD_SPEED_HIGH)
+    {
+      /* Prepare Out endpoint to receive next packet */
+      (void)USBD_LL_PrepareReceive(pdev, CDCOutEpAdd[port], hcdc[port].RxBuffer,
+                                   CDC_DATA_HS_OUT_PACKET_SIZE);
+    }
+    else
+    {
+      /* Prepare Out endpoint to receive next packet */
+      (void)USBD_LL_PrepareReceive(pdev, CDCOutEpAdd[port], hcdc[port].RxBuffer,
+                                   CDC_DATA_FS_OUT_PACKET_SIZE);
+    }
   }
 
   return (uint8_t)USBD_OK;
@@ -389,32 +452,34 @@ static uint8_t USBD_CDC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 static uint8_t USBD_CDC_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 {
   UNUSED(cfgidx);
+  uint8_t port;
 
+  for (port = 0U; port < CDC_NUM_PORTS; port++)
+  {
+    /* Close EP IN */
+    (void)USBD_LL_CloseEP(pdev, CDCInEpAdd[port]);
+    pdev->ep_in[CDCInEpAdd[port] & 0xFU].is_used = 0U;
 
-#ifdef USE_USBD_COMPOSITE
-  /* Get the Endpoints addresses allocated for this CDC class instance */
-  CDCInEpAdd  = USBD_CoreGetEPAdd(pdev, USBD_EP_IN, USBD_EP_TYPE_BULK, (uint8_t)pdev->classId);
-  CDCOutEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_OUT, USBD_EP_TYPE_BULK, (uint8_t)pdev->classId);
-  CDCCmdEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_IN, USBD_EP_TYPE_INTR, (uint8_t)pdev->classId);
-#endif /* USE_USBD_COMPOSITE */
-
-  /* Close EP IN */
-  (void)USBD_LL_CloseEP(pdev, CDCInEpAdd);
-  pdev->ep_in[CDCInEpAdd & 0xFU].is_used = 0U;
-
-  /* Close EP OUT */
-  (void)USBD_LL_CloseEP(pdev, CDCOutEpAdd);
-  pdev->ep_out[CDCOutEpAdd & 0xFU].is_used = 0U;
+    /* Close EP OUT */
+    (void)USBD_LL_CloseEP(pdev, CDCOutEpAdd[port]);
+    pdev->ep_out[CDCOutEpAdd[port] & 0xFU].is_used = 0U;
 
-  /* Close Command IN EP */
-  (void)USBD_LL_CloseEP(pdev, CDCCmdEpAdd);
-  pdev->ep_in[CDCCmdEpAdd & 0xFU].is_used = 0U;
-  pdev->ep_in[CDCCmdEpAdd & 0xFU].bInterval = 0U;
+    /* Close Command IN EP */
+    (void)USBD_LL_CloseEP(pdev, CDCCmdEpAdd[port]);
+    pdev->ep_in[CDCCmdEpAdd[port] & 0xFU].is_used = 0U;
+    pdev->ep_in[CDCCmdEpAdd[port] & 0xFU].bInterval = 0U;
+  }
 
   /* DeInit  physical Interface components */
   if (pdev->pClassDataCmsit[pdev->classId] != NULL)
   {
-    ((USBD_CDC_ItfTypeDef *)pdev->pUserData[pdev->classId])->DeInit();
+    for (port = 0U; port < CDC_NUM_PORTS; port++)
+    {
+      if (CDCItf[port] != NULL)
+      {
+        CDCItf[port]->DeInit();
+      }
+    }
     (void)USBD_free(pdev->pClassDataCmsit[pdev->classId]);
     pdev->pClassDataCmsit[pdev->classId] = NULL;
     pdev->pClassData = NULL;
@@ -433,13 +498,23 @@ static uint8_t USBD_CDC_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 static uint8_t USBD_CDC_Setup(USBD_HandleTypeDef *pdev,
                               USBD_SetupReqTypedef *req)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  /* Each port owns a pair of interfaces, and EP1/EP2 or EP3/EP4 for endpoint requests */
+  uint8_t port;
+  if ((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_ENDPOINT)
+  {
+    port = ((LOBYTE(req->wIndex) & 0x7FU) <= (CDC_CMD_EP & 0x7FU)) ? 0U : 1U;
+  }
+  else
+  {
+    port = LOBYTE(req->wIndex) / 2U;
+  }
+  USBD_CDC_HandleTypeDef *hcdc = USBD_CDC_GetHandle(pdev, port);
   uint16_t len;
   uint8_t ifalt = 0U;
   uint16_t status_info = 0U;
   USBD_StatusTypeDef ret = USBD_OK;
 
-  if (hcdc == NULL)
+  if ((hcdc == NULL) || (CDCItf[port] == NULL))
   {
     return (uint8_t)USBD_FAIL;
   }
@@ -451,9 +526,7 @@ static uint8_t USBD_CDC_Setup(USBD_HandleTypeDef *pdev,
       {
         if ((req->bmRequest & 0x80U) != 0U)
         {
-          ((USBD_CDC_ItfTypeDef *)pdev->pUserData[pdev->classId])->Control(req->bRequest,
-                                                                           (uint8_t *)hcdc->data,
-                                                                           req->wLength);
+          CDCItf[port]->Control(req->bRequest, (uint8_t *)hcdc->data, req->wLength);
 
           len = MIN(CDC_REQ_MAX_DATA_SIZE, req->wLength);
           (void)USBD_CtlSendData(pdev, (uint8_t *)hcdc->data, len);
@@ -468,8 +541,7 @@ static uint8_t USBD_CDC_Setup(USBD_HandleTypeDef *pdev,
       }
       else
       {
-        ((USBD_CDC_ItfTypeDef *)pdev->pUserData[pdev->classId])->Control(req->bRequest,
-                                                                         (uint8_t *)req, 0U);
+        CDCItf[port]->Control(req->bRequest, (uint8_t *)req, 0U);
       }
       break;
 
@@ -536,16 +608,15 @@ static uint8_t USBD_CDC_Setup(USBD_HandleTypeDef *pdev,
   */
 static uint8_t USBD_CDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
-  USBD_CDC_HandleTypeDef *hcdc;
+  uint8_t port = USBD_CDC_GetPort(epnum);
+  USBD_CDC_HandleTypeDef *hcdc = USBD_CDC_GetHandle(pdev, port);
   PCD_HandleTypeDef *hpcd = (PCD_HandleTypeDef *)pdev->pData;
 
-  if (pdev->pClassDataCmsit[pdev->classId] == NULL)
+  if (hcdc == NULL)
   {
     return (uint8_t)USBD_FAIL;
   }
 
-  hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
-
   if ((pdev->ep_in[epnum & 0xFU].total_length > 0U) &&
       ((pdev->ep_in[epnum & 0xFU].total_length % hpcd->IN_ep[epnum & 0xFU].maxpacket) == 0U))
   {
@@ -559,9 +630,9 @@ static uint8_t USBD_CDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
   {
     hcdc->TxState = 0U;
 
-    if (((USBD_CDC_ItfTypeDef *)pdev->pUserData[pdev->classId])->TransmitCplt != NULL)
+    if ((CDCItf[port] != NULL) && (CDCItf[port]->TransmitCplt != NULL))
     {
-      ((USBD_CDC_ItfTypeDef *)pdev->pUserData[pdev->classId])->TransmitCplt(hcdc->TxBuffer, &hcdc->TxLength, epnum);
+      CDCItf[port]->TransmitCplt(hcdc->TxBuffer, &hcdc->TxLength, epnum);
     }
   }
 
@@ -577,9 +648,10 @@ static uint8_t USBD_CDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
   */
 static uint8_t USBD_CDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  uint8_t port = USBD_CDC_GetPort(epnum);
+  USBD_CDC_HandleTypeDef *hcdc = USBD_CDC_GetHandle(pdev, port);
 
-  if (pdev->pClassDataCmsit[pdev->classId] == NULL)
+  if ((hcdc == NULL) || (CDCItf[port] == NULL))
   {
     return (uint8_t)USBD_FAIL;
   }
@@ -590,7 +662,7 @@ static uint8_t USBD_CDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
   /* USB data will be immediately processed, this allow next USB traffic being
   NAKed till the end of the application Xfer */
 
-  ((USBD_CDC_ItfTypeDef *)pdev->pUserData[pdev->classId])->Receive(hcdc->RxBuffer, &hcdc->RxLength);
+  CDCItf[port]->Receive(hcdc->RxBuffer, &hcdc->RxLength);
 
   return (uint8_t)USBD_OK;
 }
@@ -603,50 +675,75 @@ static uint8_t USBD_CDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
   */
 static uint8_t USBD_CDC_EP0_RxReady(USBD_HandleTypeDef *pdev)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  USBD_CDC_HandleTypeDef *hcdc;
+  uint8_t port;
 
-  if (hcdc == NULL)
+  if (pdev->pClassDataCmsit[pdev->classId] == NULL)
   {
     return (uint8_t)USBD_FAIL;
   }
 
-  if ((pdev->pUserData[pdev->classId] != NULL) && (hcdc->CmdOpCode != 0xFFU))
+  /* Only the port that accepted the setup stage has a pending command */
+  for (port = 0U; port < CDC_NUM_PORTS; port++)
   {
-    ((USBD_CDC_ItfTypeDef *)pdev->pUserData[pdev->classId])->Control(hcdc->CmdOpCode,
-                                                                     (uint8_t *)hcdc->data,
-                                                                     (uint16_t)hcdc->CmdLength);
-    hcdc->CmdOpCode = 0xFFU;
+    hcdc = USBD_CDC_GetHandle(pdev, port);
+
+    if ((CDCItf[port] != NULL) && (hcdc->CmdOpCode != 0xFFU))
+    {
+      CDCItf[port]->Control(hcdc->CmdOpCode, (uint8_t *)hcdc->data, (uint16_t)hcdc->CmdLength);
+      hcdc->CmdOpCode = 0xFFU;
+    }
   }
 
   return (uint8_t)USBD_OK;
 }
 #ifndef USE_USBD_COMPOSITE
 /**
-  * @brief  USBD_CDC_GetFSCfgDesc
-  *         Return configuration descriptor
-  * @param  length : pointer data length
-  * @retval pointer to descriptor buffer
+  * @brief  USBD_CDC_SetCfgEpDesc
+  *         Patch the endpoint descriptors of every port for the given speed
+  * @param  bInterval: command endpoint interval
+  * @param  wMaxPacketSize: data endpoint packet size
+  * @retval None
   */
-static uint8_t *USBD_CDC_GetFSCfgDesc(uint16_t *length)
+static void USBD_CDC_SetCfgEpDesc(uint8_t bInterval, uint16_t wMaxPacketSize)
 {
-  USBD_EpDescTypeDef *pEpCmdDesc = USBD_GetEpDesc(USBD_CDC_CfgDesc, CDC_CMD_EP);
-  USBD_EpDescTypeDef *pEpOutDesc = USBD_GetEpDesc(USBD_CDC_CfgDesc, CDC_OUT_EP);
-  USBD_EpDescTypeDef *pEpInDesc = USBD_GetEpDesc(USBD_CDC_CfgDesc, CDC_IN_EP);
+  USBD_EpDescTypeDef *pEpCmdDesc;
+  USBD_EpDescTypeDef *pEpOutDesc;
+  USBD_EpDescTypeDef *pEpInDesc;
+  uint8_t port;
 
-  if (pEpCmdDesc != NULL)
+  for (port = 0U; port < CDC_NUM_PORTS; port++)
   {
-    pEpCmdDesc->bInterval = CDC_FS_BINTERVAL;
-  }
+    pEpCmdDesc = USBD_GetEpDesc(USBD_CDC_CfgDesc, CDCCmdEpAdd[port]);
+    pEpOutDesc = USBD_GetEpDesc(USBD_CDC_CfgDesc, CDCOutEpAdd[port]);
+    pEpInDesc = USBD_GetEpDesc(USBD_CDC_CfgDesc, CDCInEpAdd[port]);
 
-  if (pEpOutDesc != NULL)
-  {
-    pEpOutDesc->wMaxPacketSize = CDC_DATA_FS_MAX_PACKET_SIZE;
-  }
+    if (pEpCmdDesc != NULL)
+    {
+      pEpCmdDesc->bInterval = bInterval;
+    }
 
-  if (pEpInDesc != NULL)
-  {
-    pEpInDesc->wMaxPacketSize = CDC_DATA_FS_MAX_PACKET_SIZE;
+    if (pEpOutDesc != NULL)
+    {
+      pEpOutDesc->wMaxPacketSize = wMaxPacketSize;
+    }
+
+    if (pEpInDesc != NULL)
+    {
+      pEpInDesc->wMaxPacketSize = wMaxPacketSize;
+    }
   }
+}
+
+/**
+  * @brief  USBD_CDC_GetFSCfgDesc
+  *         Return configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_CDC_GetFSCfgDesc(uint16_t *length)
+{
+  USBD_CDC_SetCfgEpDesc(CDC_FS_BINTERVAL, CDC_DATA_FS_MAX_PACKET_SIZE);
 
   *length = (uint16_t)sizeof(USBD_CDC_CfgDesc);
   return USBD_CDC_CfgDesc;
@@ -660,24 +757,7 @@ static uint8_t *USBD_CDC_GetFSCfgDesc(uint16_t *length)
   */
 static uint8_t *USBD_CDC_GetHSCfgDesc(uint16_t *length)
 {
-  USBD_EpDescTypeDef *pEpCmdDesc = USBD_GetEpDesc(USBD_CDC_CfgDesc, CDC_CMD_EP);
-  USBD_EpDescTypeDef *pEpOutDesc = USBD_GetEpDesc(USBD_CDC_CfgDesc, CDC_OUT_EP);
-  USBD_EpDescTypeDef *pEpInDesc = USBD_GetEpDesc(USBD_CDC_CfgDesc, CDC_IN_EP);
-
-  if (pEpCmdDesc != NULL)
-  {
-    pEpCmdDesc->bInterval = CDC_HS_BINTERVAL;
-  }
-
-  if (pEpOutDesc != NULL)
-  {
-    pEpOutDesc->wMaxPacketSize = CDC_DATA_HS_MAX_PACKET_SIZE;
-  }
-
-  if (pEpInDesc != NULL)
-  {
-    pEpInDesc->wMaxPacketSize = CDC_DATA_HS_MAX_PACKET_SIZE;
-  }
+  USBD_CDC_SetCfgEpDesc(CDC_HS_BINTERVAL, CDC_DATA_HS_MAX_PACKET_SIZE);
 
   *length = (uint16_t)sizeof(USBD_CDC_CfgDesc);
   return USBD_CDC_CfgDesc;
@@ -691,24 +771,7 @@ static uint8_t *USBD_CDC_GetHSCfgDesc(uint16_t *length)
   */
 static uint8_t *USBD_CDC_GetOtherSpeedCfgDesc(uint16_t *length)
 {
-  USBD_EpDescTypeDef *pEpCmdDesc = USBD_GetEpDesc(USBD_CDC_CfgDesc, CDC_CMD_EP);
-  USBD_EpDescTypeDef *pEpOutDesc = USBD_GetEpDesc(USBD_CDC_CfgDesc, CDC_OUT_EP);
-  USBD_EpDescTypeDef *pEpInDesc = USBD_GetEpDesc(USBD_CDC_CfgDesc, CDC_IN_EP);
-
-  if (pEpCmdDesc != NULL)
-  {
-    pEpCmdDesc->bInterval = CDC_FS_BINTERVAL;
-  }
-
-  if (pEpOutDesc != NULL)
-  {
-    pEpOutDesc->wMaxPacketSize = CDC_DATA_FS_MAX_PACKET_SIZE;
-  }
-
-  if (pEpInDesc != NULL)
-  {
-    pEpInDesc->wMaxPacketSize = CDC_DATA_FS_MAX_PACKET_SIZE;
-  }
+  USBD_CDC_SetCfgEpDesc(CDC_FS_BINTERVAL, CDC_DATA_FS_MAX_PACKET_SIZE);
 
   *length = (uint16_t)sizeof(USBD_CDC_CfgDesc);
   return USBD_CDC_CfgDesc;
@@ -730,18 +793,25 @@ uint8_t *USBD_CDC_GetDeviceQualifierDescriptor(uint16_t *length)
 /**
   * @brief  USBD_CDC_RegisterInterface
   * @param  pdev: device instance
+  * @param  port: port index
   * @param  fops: CD  Interface callback
   * @retval status
   */
-uint8_t USBD_CDC_RegisterInterface(USBD_HandleTypeDef *pdev,
+uint8_t USBD_CDC_RegisterInterface(USBD_HandleTypeDef *pdev, uint8_t port,
                                    USBD_CDC_ItfTypeDef *fops)
 {
-  if (fops == NULL)
+  if ((fops == NULL) || (port >= CDC_NUM_PORTS))
   {
     return (uint8_t)USBD_FAIL;
   }
 
-  pdev->pUserData[pdev->classId] = fops;
+  CDCItf[port] = fops;
+
+  /* Keep the core's user data pointing to the first port */
+  if (port == 0U)
+  {
+    pdev->pUserData[pdev->classId] = fops;
+  }
 
   return (uint8_t)USBD_OK;
 }
@@ -750,22 +820,15 @@ uint8_t USBD_CDC_RegisterInterface(USBD_HandleTypeDef *pdev,
 /**
   * @brief  USBD_CDC_SetTxBuffer
   * @param  pdev: device instance
+  * @param  port: port index
   * @param  pbuff: Tx Buffer
   * @param  length: length of data to be sent
-  * @param  ClassId: The Class ID
   * @retval status
   */
-#ifdef USE_USBD_COMPOSITE
-uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev,
-                             uint8_t *pbuff, uint32_t length, uint8_t ClassId)
-{
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDataCmsit[ClassId];
-#else
-uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev,
+uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t port,
                              uint8_t *pbuff, uint32_t length)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
-#endif /* USE_USBD_COMPOSITE */
+  USBD_CDC_HandleTypeDef *hcdc = USBD_CDC_GetHandle(pdev, port);
 
   if (hcdc == NULL)
   {
@@ -781,12 +844,13 @@ uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev,
 /**
   * @brief  USBD_CDC_SetRxBuffer
   * @param  pdev: device instance
+  * @param  port: port index
   * @param  pbuff: Rx Buffer
   * @retval status
   */
-uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff)
+uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t port, uint8_t *pbuff)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  USBD_CDC_HandleTypeDef *hcdc = USBD_CDC_GetHandle(pdev, port);
 
   if (hcdc == NULL)
   {
@@ -803,26 +867,14 @@ uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff)
   * @brief  USBD_CDC_TransmitPacket
   *         Transmit packet on IN endpoint
   * @param  pdev: device instance
-  * @param  ClassId: The Class ID
+  * @param  port: port index
   * @retval status
   */
-#ifdef USE_USBD_COMPOSITE
-uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev, uint8_t ClassId)
-{
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDataCmsit[ClassId];
-#else
-uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev)
+uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev, uint8_t port)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
-#endif  /* USE_USBD_COMPOSITE */
-
+  USBD_CDC_HandleTypeDef *hcdc = USBD_CDC_GetHandle(pdev, port);
   USBD_StatusTypeDef ret = USBD_BUSY;
 
-#ifdef USE_USBD_COMPOSITE
-  /* Get the Endpoints addresses allocated for this class instance */
-  CDCInEpAdd  = USBD_CoreGetEPAdd(pdev, USBD_EP_IN, USBD_EP_TYPE_BULK, ClassId);
-#endif  /* USE_USBD_COMPOSITE */
-
   if (hcdc == NULL)
   {
     return (uint8_t)USBD_FAIL;
@@ -834,10 +886,10 @@ uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev)
     hcdc->TxState = 1U;
 
     /* Update the packet total length */
-    pdev->ep_in[CDCInEpAdd & 0xFU].total_length = hcdc->TxLength;
+    pdev->ep_in[CDCInEpAdd[port] & 0xFU].total_length = hcdc->TxLength;
 
     /* Transmit next packet */
-    (void)USBD_LL_Transmit(pdev, CDCInEpAdd, hcdc->TxBuffer, hcdc->TxLength);
+    (void)USBD_LL_Transmit(pdev, CDCInEpAdd[port], hcdc->TxBuffer, hcdc->TxLength);
 
     ret = USBD_OK;
   }
@@ -849,18 +901,14 @@ uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev)
   * @brief  USBD_CDC_ReceivePacket
   *         prepare OUT Endpoint for reception
   * @param  pdev: device instance
+  * @param  port: port index
   * @retval status
   */
-uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev)
+uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev, uint8_t port)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  USBD_CDC_HandleTypeDef *hcdc = USBD_CDC_GetHandle(pdev, port);
 
-#ifdef USE_USBD_COMPOSITE
-  /* Get the Endpoints addresses allocated for this class instance */
-  CDCOutEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_OUT, USBD_EP_TYPE_BULK, (uint8_t)pdev->classId);
-#endif /* USE_USBD_COMPOSITE */
-
-  if (pdev->pClassDataCmsit[pdev->classId] == NULL)
+  if (hcdc == NULL)
   {
     return (uint8_t)USBD_FAIL;
   }
@@ -868,13 +916,13 @@ uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev)
   if (pdev->dev_speed == USBD_SPEED_HIGH)
   {
     /* Prepare Out endpoint to receive next packet */
-    (void)USBD_LL_PrepareReceive(pdev, CDCOutEpAdd, hcdc->RxBuffer,
+    (void)USBD_LL_PrepareReceive(pdev, CDCOutEpAdd[port], hcdc->RxBuffer,
                                  CDC_DATA_HS_OUT_PACKET_SIZE);
   }
   else
   {
     /* Prepare Out endpoint to receive next packet */
-    (void)USBD_LL_PrepareReceive(pdev, CDCOutEpAdd, hcdc->RxBuffer,
+    (void)USBD_LL_PrepareReceive(pdev, CDCOutEpAdd[port], hcdc->RxBuffer,
                                  CDC_DATA_FS_OUT_PACKET_SIZE);
   }
 
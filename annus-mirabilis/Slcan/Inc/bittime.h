@@ -0,0 +1,54 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _BITTIME_H
+#define _BITTIME_H
+
+// Bit timing solver and the fixed timings of the S and Y commands.
+// Pure arithmetic without the peripheral, so it is also built for the host test.
+
+#include <stdint.h>
+
+#define BITTIME_CLOCK_HZ            60000000    /* FDCAN kernel clock (PCLK1) */
+#define BITTIME_TOLERANCE_PPM       1000        /* Max deviation of a solved bitrate from the target */
+
+// Register limits for bit timing (time_seg1 and prescaler limited by struct can_bitrate_cfg and NVM)
+struct bittime_limit
+{
+    uint16_t prescaler_max;
+    uint16_t time_seg1_max;
+    uint16_t time_seg2_max;
+    uint16_t sjw_max;
+};
+
+extern const struct bittime_limit bittime_limit_nominal;
+extern const struct bittime_limit bittime_limit_data;
+extern const uint32_t bittime_nominal_bitrate[CAN_BITRATE_INVALID];
+extern const struct can_bitrate_cfg bittime_nominal_cfg[CAN_BITRATE_INVALID];
+extern const uint32_t bittime_data_bitrate[CAN_DATA_BITRATE_INVALID];
+extern const struct can_bitrate_cfg bittime_data_cfg[CAN_DATA_BITRATE_INVALID];
+
+// Prototypes
+HAL_StatusTypeDef bittime_solve(uint32_t bitrate, uint16_t sample_point, uint8_t sjw,
+                                const struct bittime_limit *limit, struct can_bitrate_cfg *cfg);
+
+#endif // _BITTIME_H
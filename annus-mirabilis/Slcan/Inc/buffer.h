@@ -33,10 +33,19 @@
 // CDC transmit buffering
 #define BUF_CDC_TX_NUM_BUFS 3
 #define BUF_CDC_TX_BUF_SIZE 4096 // Set to 64 * 64 for max single packet size
+#define BUF_CDC_TX_STAMP_NUM (BUF_CDC_TX_BUF_SIZE / 6)  // Rx frames in a buffer, shortest report is "t0000\r"
 
 // CAN transmit buffering
 #define BUF_CAN_TXQUEUE_LEN 64   // Number of buffers allocated
 
+// CDC ports (one ACM function each, same order as the class driver)
+enum buf_cdc_port
+{
+    BUF_CDC_PORT_DATA = 0,  // Frame stream, also accepts commands
+    BUF_CDC_PORT_CTRL,      // Commands, status and statistics only
+    BUF_CDC_PORT_NUM
+};
+
 // Receive buffering: circular FIFO buffer
 struct buf_cdc_rx
 {
@@ -56,21 +65,31 @@ struct buf_cdc_tx
 };
 
 // Public variables
-extern volatile struct buf_cdc_tx buf_cdc_tx;
-extern volatile struct buf_cdc_rx buf_cdc_rx;
+extern volatile struct buf_cdc_tx buf_cdc_tx[BUF_CDC_PORT_NUM];
+extern volatile struct buf_cdc_rx buf_cdc_rx[BUF_CDC_PORT_NUM];
 
 // Prototypes
 void buf_init(void);
-void buf_process(void);
+void buf_process_cdc_rx(void);
+void buf_process_cdc_tx(void);
+void buf_process_can_tx(void);
 
 void buf_enqueue_cdc(uint8_t* buf, uint16_t len);
+void buf_enqueue_cdc_port(enum buf_cdc_port port, uint8_t* buf, uint16_t len);
 uint8_t *buf_get_cdc_dest(void);
 void buf_comit_cdc_dest(uint32_t len);
+enum buf_cdc_port buf_get_cdc_dest_port(void);
+uint32_t buf_get_cdc_tx_level(void);
+void buf_stamp_cdc_rx_frame(uint32_t stamp_us);
+void buf_mark_cdc_tx_handoff(uint8_t port, uint32_t index);
 
 FDCAN_TxHeaderTypeDef *buf_get_can_dest_header(void);
 uint8_t *buf_get_can_dest_data(void);
 HAL_StatusTypeDef buf_comit_can_dest(void);
-uint8_t *buf_dequeue_can_tx_data(void);
+uint8_t *buf_get_can_tx_data(uint32_t marker);
+FDCAN_TxHeaderTypeDef *buf_get_can_tx_header(uint32_t marker);
+void buf_release_can_tx(uint32_t marker);
+uint32_t buf_get_can_tx_stamp_us(uint32_t marker);
 void buf_clear_can_buffer(void);
 
 #endif // _BUFFER_H
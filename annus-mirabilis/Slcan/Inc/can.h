@@ -48,6 +48,7 @@ enum can_bitrate_data
     CAN_DATA_BITRATE_3M,
     CAN_DATA_BITRATE_4M,
     CAN_DATA_BITRATE_5M,
+    CAN_DATA_BITRATE_6M,
 
     CAN_DATA_BITRATE_INVALID,
 };
@@ -56,7 +57,8 @@ enum can_bitrate_data
 enum can_bus_state
 {
     BUS_CLOSED,
-    BUS_OPENED
+    BUS_OPENED,
+    BUS_DETECTING       // Closed for the host, listening for the bitrate detection
 };
 
 // Structure for CAN bus error state
@@ -69,6 +71,35 @@ struct can_error_state
     uint32_t last_err_code;
 };
 
+// Transmission attempts of the frames sent since the last clear
+struct can_tx_attempt_stat
+{
+    uint32_t frames;
+    uint32_t arb_lost;          // Attempts lost in arbitration
+    uint32_t err_retry;         // Attempts stopped by an error
+    uint32_t attempts_max;      // Most attempts for one frame
+    uint32_t cancel_retry;      // Frames cancelled over the retry limit
+    uint32_t cancel_expiry;     // Frames cancelled over the expiry time
+};
+
+// Bus off events and recoveries since power on
+struct can_bus_off_stat
+{
+    uint32_t bus_off_cnt;
+    uint32_t recovery_cnt;      // Recoveries started, automatic or by the host
+    uint32_t last_ms;           // Duration of the last bus off
+    uint32_t max_ms;
+    uint32_t total_ms;
+};
+
+// Reason to remove a frame without transmission, value is used in the report
+enum can_tx_cancel
+{
+    CAN_TX_CANCEL_NONE = 0,
+    CAN_TX_CANCEL_RETRY,
+    CAN_TX_CANCEL_EXPIRY,
+};
+
 // Structure for CAN/FD bitrate configuration
 struct can_bitrate_cfg
 {
@@ -78,12 +109,21 @@ struct can_bitrate_cfg
     uint8_t sjw;
 };
 
+// Called from the main loop when the bitrate detection ends, the data bitrate is CAN_DATA_BITRATE_INVALID if not seen
+typedef void (*can_detect_done_t)(HAL_StatusTypeDef status, enum can_bitrate_nominal nominal, enum can_bitrate_data data);
+
 #define CAN_STD_DLC_TO_HAL_DLC(val)   ((uint32_t)(val) * FDCAN_DLC_BYTES_1)
 #define CAN_HAL_DLC_TO_STD_DLC(val)   ((uint8_t)(((val) / FDCAN_DLC_BYTES_1) & 0xF))
 
 // CANFD parameter
 #define CAN_MAX_DATALEN                 64  // CAN maximum data length. Must be 64 for canfd.
 
+// Number of tx FIFO elements in the message RAM (fixed on STM32G0)
+#define CAN_TX_FIFO_SIZE                3
+
+// Boot time is not recorded before the first bus open
+#define CAN_BOOT_TO_OPEN_NONE           0xFFFFFFFF
+
 // Public variable
 extern uint8_t can_dlc_to_bytes[];
 
@@ -91,19 +131,26 @@ extern uint8_t can_dlc_to_bytes[];
 void can_init(void);
 HAL_StatusTypeDef can_enable(void);
 HAL_StatusTypeDef can_disable(void);
-void can_process(void);
+void can_process_rx(void);
+void can_process_status(void);
 
 // Bit rate functions
 HAL_StatusTypeDef can_set_nominal_bitrate(enum can_bitrate_nominal bitrate);
 HAL_StatusTypeDef can_set_data_bitrate(enum can_bitrate_data bitrate);
+HAL_StatusTypeDef can_check_nominal_bitrate_cfg(struct can_bitrate_cfg bitrate_cfg);
+HAL_StatusTypeDef can_check_data_bitrate_cfg(struct can_bitrate_cfg bitrate_cfg);
 HAL_StatusTypeDef can_set_nominal_bitrate_cfg(struct can_bitrate_cfg bitrate_cfg);
 HAL_StatusTypeDef can_set_data_bitrate_cfg(struct can_bitrate_cfg bitrate_cfg);
+HAL_StatusTypeDef can_set_nominal_bitrate_target(uint32_t bitrate, uint16_t sample_point, uint8_t sjw);
+HAL_StatusTypeDef can_set_data_bitrate_target(uint32_t bitrate, uint16_t sample_point, uint8_t sjw);
+HAL_StatusTypeDef can_detect_bitrate(can_detect_done_t done);
 struct can_bitrate_cfg can_get_bitrate_cfg(void);
 struct can_bitrate_cfg can_get_data_bitrate_cfg(void);
 
 // Filter functions
 HAL_StatusTypeDef can_set_filter_std(FunctionalState state, uint32_t code, uint32_t mask);
 HAL_StatusTypeDef can_set_filter_ext(FunctionalState state, uint32_t code, uint32_t mask);
+HAL_StatusTypeDef can_reload_filter(void);
 FunctionalState can_is_filter_std_enabled(void);
 FunctionalState can_is_filter_ext_enabled(void);
 uint32_t can_get_filter_std_code(void);
@@ -114,15 +161,33 @@ uint32_t can_get_filter_ext_mask(void);
 // CAN mode and status
 HAL_StatusTypeDef can_set_mode(uint32_t mode);
 HAL_StatusTypeDef can_set_auto_retransmit(FunctionalState state);
+HAL_StatusTypeDef can_set_tx_limit(uint8_t retry_limit, uint16_t expiry_ms);
+uint8_t can_get_tx_retry_limit(void);
+uint16_t can_get_tx_expiry_ms(void);
+FunctionalState can_is_tx_expired(uint32_t stamp_us);
+HAL_StatusTypeDef can_set_recovery(FunctionalState auto_recover, uint16_t delay_ms, uint8_t max_num);
+HAL_StatusTypeDef can_recover_bus_off(void);
+struct can_bus_off_stat can_get_bus_off_stat(void);
+void can_report_tx_cancel(FDCAN_TxHeaderTypeDef *header, enum can_tx_cancel reason);
 enum can_bus_state can_get_bus_state(void);
 struct can_error_state can_get_error_state(void);
 FunctionalState can_is_tx_enabled(void);
 uint32_t can_get_bus_load_ppm(void);
+uint32_t can_get_idle_time_ms(void);
+uint32_t can_get_boot_to_open_time_us(void);
+uint32_t can_get_protocol_err_cnt(void);
 
 // Cycle time functions
-void can_clear_cycle_time(void);
-uint32_t can_get_cycle_ave_time_ns(void);
-uint32_t can_get_cycle_max_time_ns(void);
+void can_clear_rx_latency(void);
+uint32_t can_get_rx_latency_max_us(void);
+uint32_t can_get_rx_cycle_ave(void);
+void can_clear_latency_hist(void);
+struct hist *can_get_tx_latency_hist(void);
+struct hist *can_get_rx_latency_hist(void);
+void can_clear_tx_attempt_stat(void);
+struct can_tx_attempt_stat can_get_tx_attempt_stat(void);
+void can_mark_tx_submit(uint32_t marker);
+uint32_t can_get_uptime_us(void);
 
 FDCAN_HandleTypeDef *can_get_handle(void);
 
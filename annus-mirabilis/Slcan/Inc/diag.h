@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _DIAG_H
+#define _DIAG_H
+
+#include <stdint.h>
+
+// Causes of data loss, one counter each
+enum diag_loss
+{
+    DIAG_LOSS_CAN_RX_FIFO0 = 0,     // FDCAN rx FIFO 0 full, frame lost on bus side
+    DIAG_LOSS_CAN_RX_FIFO1,         // FDCAN rx FIFO 1 full, frame lost on bus side
+    DIAG_LOSS_CAN_TX_EVENT,         // FDCAN tx event FIFO full, tx report lost
+    DIAG_LOSS_CAN_TX_QUEUE,         // buf_can_tx full, frame from host rejected
+    DIAG_LOSS_CAN_TX_ADD,           // Frame not accepted by FDCAN tx FIFO
+    DIAG_LOSS_CDC_RX_DATA,          // buf_cdc_rx full on data port, packet from host overwritten
+    DIAG_LOSS_CDC_RX_CTRL,          // buf_cdc_rx full on control port, packet from host overwritten
+    DIAG_LOSS_CDC_TX_DATA,          // buf_cdc_tx full on data port, report to host lost
+    DIAG_LOSS_CDC_TX_CTRL,          // buf_cdc_tx full on control port, report to host lost
+    DIAG_LOSS_SHED_CLASS0,          // Rx frame of priority class 0 shed before the buffer to host is full
+    DIAG_LOSS_SHED_CLASS1,
+    DIAG_LOSS_SHED_CLASS2,
+    DIAG_LOSS_SHED_CLASS3,
+
+    DIAG_LOSS_NUM
+};
+
+// Buffer stages with a high-water mark
+enum diag_peak
+{
+    DIAG_PEAK_CAN_RX_FIFO0 = 0,     // Frames in FDCAN rx FIFO 0
+    DIAG_PEAK_CAN_RX_FIFO1,         // Frames in FDCAN rx FIFO 1
+    DIAG_PEAK_CAN_TX_EVENT,         // Elements in FDCAN tx event FIFO
+    DIAG_PEAK_CAN_TX_FIFO,          // Frames in FDCAN tx FIFO
+    DIAG_PEAK_CAN_TX_QUEUE,         // Frames in buf_can_tx
+    DIAG_PEAK_CDC_RX_DATA,          // Packets in buf_cdc_rx on data port
+    DIAG_PEAK_CDC_RX_CTRL,          // Packets in buf_cdc_rx on control port
+    DIAG_PEAK_CDC_TX_DATA,          // Bytes in the filling buf_cdc_tx on data port
+    DIAG_PEAK_CDC_TX_CTRL,          // Bytes in the filling buf_cdc_tx on control port
+
+    DIAG_PEAK_NUM
+};
+
+// Prototypes
+void diag_count_loss(enum diag_loss cause);
+void diag_update_peak(enum diag_peak stage, uint32_t level);
+uint32_t diag_get_loss(enum diag_loss cause);
+uint32_t diag_get_peak(enum diag_peak stage);
+void diag_clear(void);
+
+#endif // _DIAG_H
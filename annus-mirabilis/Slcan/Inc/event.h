@@ -0,0 +1,45 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _EVENT_H
+#define _EVENT_H
+
+// Events in priority order (lower value is dispatched first)
+enum event_id
+{
+    EVENT_CAN_RX = 0,       // Frame received or transmitted on CAN bus
+    EVENT_CDC_RX,           // Data received from USB host
+    EVENT_CAN_TX,           // Frame queued or space available in CAN tx FIFO
+    EVENT_CDC_TX,           // Data queued or transfer completed to USB host
+    EVENT_TICK,             // System tick (1ms) for time based tasks
+
+    EVENT_NUM
+};
+
+// Prototypes
+void event_post(enum event_id id);
+enum event_id event_wait(void);
+void event_clear_cycle_time(void);
+uint32_t event_get_cycle_ave_time_ns(void);
+uint32_t event_get_cycle_max_time_ns(void);
+
+#endif // _EVENT_H
@@ -0,0 +1,47 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _HIST_H
+#define _HIST_H
+
+#include <stdint.h>
+
+// Log-linear buckets: 4 per power of two, exact below 8, 1/4 resolution up to 0xFFFF
+#define HIST_SUB_BITS           2
+#define HIST_BUCKET_NUM         ((16 - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+// Histogram of a latency in microseconds
+struct hist
+{
+    uint32_t count[HIST_BUCKET_NUM];
+    uint32_t total;
+    uint32_t max;
+};
+
+// Prototypes
+void hist_clear(struct hist *hist);
+void hist_add(struct hist *hist, uint32_t value);
+uint32_t hist_get_percentile(struct hist *hist, uint16_t permille);
+uint32_t hist_get_max(struct hist *hist);
+uint32_t hist_get_total(struct hist *hist);
+
+#endif // _HIST_H
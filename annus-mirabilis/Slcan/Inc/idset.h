@@ -0,0 +1,47 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _IDSET_H
+#define _IDSET_H
+
+// Size of the ID lists
+#define IDSET_STD_ID_MAX        512
+#define IDSET_EXT_ID_MAX        256
+
+// Filter elements for the ID set, all elements of the FDCAN but the last extended one for the remote frame reply
+#define IDSET_STD_FILTER_MAX    28
+#define IDSET_EXT_FILTER_MAX    7
+
+// Prototypes
+void idset_set_state(FunctionalState state);
+FunctionalState idset_is_enabled(void);
+HAL_StatusTypeDef idset_add_id(uint32_t id_type, uint32_t id);
+void idset_clear(void);
+void idset_compile(void);
+uint16_t idset_get_id_nbr(uint32_t id_type);
+uint8_t idset_get_filter_nbr(uint32_t id_type);
+FDCAN_FilterTypeDef *idset_get_filter(uint32_t id_type, uint8_t index);
+uint32_t idset_get_false_accept_nbr(uint32_t id_type);
+uint32_t idset_get_false_accept_ppm(void);
+FunctionalState idset_is_accepted(FDCAN_RxHeaderTypeDef *frame_header);
+
+#endif // _IDSET_H
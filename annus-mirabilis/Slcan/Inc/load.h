@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _LOAD_H
+#define _LOAD_H
+
+#include <stdint.h>
+
+#define LOAD_SAMPLE_NUM         256     // Samples kept until read
+#define LOAD_SAMPLE_LEN         (8 + 4 + 4 + 4)     // Hex digits of a sample
+#define LOAD_READ_NUM           8       // Samples in one reply
+
+// Bus activity in one sample interval
+struct load_sample
+{
+    uint32_t bits;          // Frame bits on the wire in nominal bit time
+    uint16_t frames;        // Frames received or transmitted (saturated)
+    uint16_t errors;        // Protocol errors (saturated)
+    uint16_t burst_max;     // Longest run of back-to-back frames (saturated)
+};
+
+// Prototypes
+HAL_StatusTypeDef load_set_config(uint16_t interval_ms, FunctionalState stream);
+uint16_t load_get_interval_ms(void);
+void load_clear(void);
+void load_count_frame(uint16_t sof_us, uint16_t bits, uint32_t bit_time_ns);
+void load_process(void);
+uint32_t load_read(struct load_sample *sample, uint32_t num);
+int32_t load_generate_sample(uint8_t *buf, struct load_sample *sample);
+
+#endif // _LOAD_H
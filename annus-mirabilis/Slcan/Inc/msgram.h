@@ -0,0 +1,36 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MSGRAM_H
+#define _MSGRAM_H
+
+// Use the HAL functions instead of the direct access to compare the cost
+//#define MSGRAM_USE_HAL
+
+// Prototypes
+HAL_StatusTypeDef msgram_peek_rx(uint32_t fifo, FDCAN_RxHeaderTypeDef *header, uint8_t **data);
+void msgram_release_rx(uint32_t fifo);
+uint32_t msgram_count_rx_between(uint32_t fifo, uint16_t after_us, uint16_t before_us);
+HAL_StatusTypeDef msgram_get_tx_event(FDCAN_TxEventFifoTypeDef *event);
+HAL_StatusTypeDef msgram_add_tx(FDCAN_TxHeaderTypeDef *header, uint8_t *data);
+
+#endif // _MSGRAM_H
@@ -23,12 +23,18 @@
 #ifndef _NVM_H
 #define _NVM_H
 
+// Number of configuration profiles stored, numbered from 1 (0 is the default at power on)
+#define NVM_PROFILE_NBR           (3)
+
 // Prototypes
 void nvm_init(void);
+void nvm_process(void);
 HAL_StatusTypeDef nvm_get_serial_number(uint16_t *num);
 HAL_StatusTypeDef nvm_update_serial_number(uint16_t num);
 
 HAL_StatusTypeDef nvm_apply_startup_cfg(void);
 HAL_StatusTypeDef nvm_update_startup_cfg(uint8_t mode);
+HAL_StatusTypeDef nvm_apply_profile(uint8_t idx, uint8_t *mode);
+HAL_StatusTypeDef nvm_update_profile(uint8_t idx, uint8_t mode);
 
 #endif // _NVM_H
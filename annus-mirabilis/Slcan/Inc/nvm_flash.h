@@ -0,0 +1,36 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _NVM_FLASH_H
+#define _NVM_FLASH_H
+
+// Flash pages used for the non-volatile memory (see RM0444-3.3.1)
+#define NVM_FLASH_PAGE_SIZE       (2048)
+#define NVM_FLASH_PAGE_NBR        (2)
+#define NVM_FLASH_ERASED          (0xFFFFFFFFFFFFFFFFULL)      /* Flash memory store 0xFF when cleared */
+
+// Prototypes (page is relative to the first data page, offset is in bytes and aligned to 8)
+uint64_t nvm_flash_read(uint8_t page, uint16_t offset);
+HAL_StatusTypeDef nvm_flash_program(uint8_t page, uint16_t offset, uint64_t data);
+HAL_StatusTypeDef nvm_flash_erase(uint8_t page);
+
+#endif // _NVM_FLASH_H
@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _PAYLOAD_H
+#define _PAYLOAD_H
+
+// Number of payload filter rules (one bit each in the decision table)
+#define PAYLOAD_RULE_NUM        16
+#define PAYLOAD_BYTE_NUM        8       // Leading data bytes checked by a rule
+
+// Frame types, value is bit position in the type field of a rule
+enum payload_type
+{
+    PAYLOAD_TYPE_REMOTE = 0,
+    PAYLOAD_TYPE_CLASSIC,
+    PAYLOAD_TYPE_FD,
+    PAYLOAD_TYPE_FD_BRS,
+
+    PAYLOAD_TYPE_NUM
+};
+
+// Payload filter rule
+struct payload_rule
+{
+    uint8_t type;                           // Bit set for accepted frame type
+    uint8_t dlc_min;
+    uint8_t dlc_max;
+    uint8_t code[PAYLOAD_BYTE_NUM];
+    uint8_t mask[PAYLOAD_BYTE_NUM];         // Bit set for don't care
+};
+
+// Prototypes
+HAL_StatusTypeDef payload_set_rule(uint8_t index, struct payload_rule *rule);
+HAL_StatusTypeDef payload_clear_rule(uint8_t index);
+FunctionalState payload_is_accepted(FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data);
+
+#endif // _PAYLOAD_H
@@ -0,0 +1,35 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _QOS_H
+#define _QOS_H
+
+// Priority classes, lower value is kept longer under overload
+#define QOS_CLASS_NUM           4
+#define QOS_RULE_NUM            (QOS_CLASS_NUM - 1)     // Last class is for the frames matching no rule
+
+// Prototypes
+HAL_StatusTypeDef qos_set_rule(uint8_t class, FunctionalState state, uint32_t code, uint32_t mask);
+uint8_t qos_get_class(FDCAN_RxHeaderTypeDef *frame_header);
+FunctionalState qos_is_reported(FDCAN_RxHeaderTypeDef *frame_header);
+
+#endif // _QOS_H
@@ -52,7 +52,7 @@ enum slcan_status_flag
     SLCAN_STS_DATA_OVERRUN,
     SLCAN_STS_RESERVED,
     SLCAN_STS_ERROR_PASSIVE,
-    SLCAN_STS_ARBITRATION_LOST,     /* Not supported */
+    SLCAN_STS_ARBITRATION_LOST,     /* Normal mode with auto retransmission only */
     SLCAN_STS_BUS_ERROR
 };
 
@@ -64,11 +64,15 @@ enum slcan_report_flag
     //SLCAN_REPORT_ERROR,
     //SLCAN_REPORT_OVRLOAD,
     SLCAN_REPORT_ESI = 4,
+    SLCAN_REPORT_SEQ,
+    SLCAN_REPORT_TX_LATENCY,
+    SLCAN_REPORT_TX_ATTEMPT,
 };
 
 // Maximum rx buffer len
-#define SLCAN_MTU           (1 + 138 + 8 + 1 + 1 + 16) 
-                            /* tx z/Z plus frame 138 plus timestamp 8 plus ESI plus \r plus some padding */
+#define SLCAN_MTU           (1 + 138 + 8 + 1 + 4 + 4 + 2 + 1 + 16)
+                            /* tx z/Z plus frame 138 plus timestamp 8 plus ESI plus sequence 4 plus latency 4 plus attempts 2 plus \r plus some padding */
+#define SLCAN_DROP_LEN      (1 + 8 + 1)     /* x plus number of frames plus \r, fits in the padding */
 #define SLCAN_STD_ID_LEN    (3)
 #define SLCAN_EXT_ID_LEN    (8)
 
@@ -79,11 +83,14 @@ extern uint16_t slcan_report_reg;
 
 // Prototypes
 int32_t slcan_generate_rx_frame(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data);
-int32_t slcan_generate_tx_event(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data);
+int32_t slcan_generate_tx_event(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data, uint32_t latency_us, uint32_t attempts);
+int32_t slcan_generate_tx_cancel(uint8_t *buf, FDCAN_TxHeaderTypeDef *frame_header, uint8_t reason);
+void slcan_bind_generator(void);
 uint16_t slcan_get_timestamp_ms(void);
 uint32_t slcan_get_timestamp_us_from_tim3(uint16_t tim3_us);
 void slcan_set_timestamp_mode(enum slcan_timestamp_mode mode);
 void slcan_set_report_mode(uint16_t reg);
+void slcan_clear_sequence(void);
 enum slcan_timestamp_mode slcan_get_timestamp_mode(void);
 uint16_t slcan_get_report_mode(void);
 
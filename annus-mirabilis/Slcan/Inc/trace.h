@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdint.h>
+
+// Record the probes below in a RAM ring, dumped with the '#' command
+//#define TRACE_ENABLE
+
+#define TRACE_RECORD_NUM        512         // 8 bytes each
+#define TRACE_PAYLOAD_MASK      0x00FFFFFF
+
+// Probe points, the payload of each is noted
+enum trace_event
+{
+    TRACE_NONE = 0,
+    TRACE_USB_RX,               // Port << 16 | bytes received
+    TRACE_USB_TX_START,         // Port << 16 | bytes handed to the IN endpoint
+    TRACE_USB_TX_CPLT,          // Port
+    TRACE_CAN_RX0,              // CAN ID, lower 24 bits, of the frame read from rx FIFO 0
+    TRACE_CAN_RX1,              // CAN ID, lower 24 bits, of the frame read from rx FIFO 1
+    TRACE_CAN_TX_EVENT,         // Message marker of the tx event read
+    TRACE_CAN_TX_SUBMIT,        // CAN ID, lower 24 bits, of the frame added to the tx FIFO
+    TRACE_PARSE_START,          // Command character << 16 | length
+    TRACE_PARSE_END,            // Command character << 16 | length
+    TRACE_FLASH_PROGRAM_START,  // Page << 16 | offset
+    TRACE_FLASH_PROGRAM_END,    // HAL status
+    TRACE_FLASH_ERASE_START,    // Page
+    TRACE_FLASH_ERASE_END,      // Faulty page, 0xFFFFFF for OK
+
+    TRACE_EVENT_NUM
+};
+
+// One record: event id in the lowest byte, payload above, then the lower 32 bits of the cycle counter
+struct trace_record
+{
+    uint32_t event;
+    uint32_t cycle;
+};
+
+#ifdef TRACE_ENABLE
+#define TRACE(event, payload)   trace_add((event), (uint32_t)(payload))
+#else
+#define TRACE(event, payload)   ((void)0)
+#endif
+
+// Prototypes
+void trace_add(enum trace_event event, uint32_t payload);
+uint32_t trace_read(struct trace_record *record, uint32_t num);
+void trace_set_state(uint8_t is_running);
+uint32_t trace_get_lost(void);
+
+#endif // _TRACE_H
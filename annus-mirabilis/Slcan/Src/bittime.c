@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+// Solve bit timing for a target bitrate, and the fixed timings of the S and Y commands.
+
+#include "stm32g0xx_hal.h"
+#include "can.h"
+#include "bittime.h"
+
+const struct bittime_limit bittime_limit_nominal = {255, 255, 128, 128};
+const struct bittime_limit bittime_limit_data = {32, 32, 16, 16};
+
+// Fixed timings in the order of enum can_bitrate_nominal
+const uint32_t bittime_nominal_bitrate[CAN_BITRATE_INVALID] =
+{
+    10000, 20000, 50000, 100000, 125000, 250000, 500000, 800000, 1000000
+};
+const struct can_bitrate_cfg bittime_nominal_cfg[CAN_BITRATE_INVALID] =
+{
+    {50, 105, 14, 13},
+    {25, 105, 14, 13},
+    {10, 105, 14, 13},
+    {5, 105, 14, 13},
+    {4, 105, 14, 13},
+    {2, 105, 14, 13},
+    {1, 105, 14, 13},
+    {1, 65, 9, 8},
+    {1, 52, 7, 6},
+};
+
+// Fixed timings in the order of enum can_bitrate_data
+const uint32_t bittime_data_bitrate[CAN_DATA_BITRATE_INVALID] =
+{
+    500000, 1000000, 2000000, 3000000, 4000000, 5000000, 6000000
+};
+const struct can_bitrate_cfg bittime_data_cfg[CAN_DATA_BITRATE_INVALID] =
+{
+    {8, 10, 4, 3},
+    {4, 10, 4, 3},
+    {2, 10, 4, 3},
+    {1, 14, 5, 4},
+    {1, 10, 4, 3},
+    {1, 8, 3, 2},
+    {1, 7, 2, 1},
+};
+
+// Search the prescaler and time segments closest to the target bitrate and sample point
+HAL_StatusTypeDef bittime_solve(uint32_t bitrate, uint16_t sample_point, uint8_t sjw,
+                                const struct bittime_limit *limit, struct can_bitrate_cfg *cfg)
+{
+    uint32_t best_rate_err = UINT32_MAX;
+    uint32_t best_sp_err = UINT32_MAX;
+
+    if (bitrate == 0 || sample_point == 0 || 1000 <= sample_point) return HAL_ERROR;
+
+    // Smaller prescaler first, so a tie is won by the finer time quantum
+    for (uint32_t prescaler = 1; prescaler <= limit->prescaler_max; prescaler++)
+    {
+        // Time quanta in one bit, rounded to the nearest
+        uint64_t tq_rate = (uint64_t)prescaler * bitrate;
+        uint32_t tq_nbr = (uint32_t)((BITTIME_CLOCK_HZ + tq_rate / 2) / tq_rate);
+        if (tq_nbr < 3 || 1 + limit->time_seg1_max + limit->time_seg2_max < tq_nbr) continue;
+
+        // Deviation from the target bitrate
+        uint64_t clock = tq_rate * tq_nbr;
+        uint64_t diff = (clock < BITTIME_CLOCK_HZ) ? (BITTIME_CLOCK_HZ - clock) : (clock - BITTIME_CLOCK_HZ);
+        uint32_t rate_err = (uint32_t)(diff * 1000000 / clock);
+
+        // Sync segment and time segment 1 end at the sample point
+        int32_t time_seg1 = (int32_t)((tq_nbr * sample_point + 500) / 1000) - 1;
+        if (time_seg1 < 1) time_seg1 = 1;
+        if ((int32_t)tq_nbr - 1 - time_seg1 < 1) time_seg1 = tq_nbr - 2;
+        if ((int32_t)limit->time_seg1_max < time_seg1) time_seg1 = limit->time_seg1_max;
+        int32_t time_seg2 = tq_nbr - 1 - time_seg1;
+        if ((int32_t)limit->time_seg2_max < time_seg2) continue;
+
+        // Deviation from the target sample point in ppm of one bit
+        int32_t sp_err = (int32_t)(((uint32_t)(1 + time_seg1) * 1000000) / tq_nbr) - (int32_t)sample_point * 1000;
+        if (sp_err < 0) sp_err = -sp_err;
+
+        if (rate_err < best_rate_err || (rate_err == best_rate_err && (uint32_t)sp_err < best_sp_err))
+        {
+            best_rate_err = rate_err;
+            best_sp_err = (uint32_t)sp_err;
+            cfg->prescaler = prescaler;
+            cfg->time_seg1 = time_seg1;
+            cfg->time_seg2 = time_seg2;
+        }
+    }
+
+    if (BITTIME_TOLERANCE_PPM < best_rate_err) return HAL_ERROR;
+
+    // SJW must not exceed the phase segment after the sample point
+    if (sjw == 0)
+        sjw = (limit->sjw_max < cfg->time_seg2) ? limit->sjw_max : cfg->time_seg2;
+    if (limit->sjw_max < sjw || cfg->time_seg2 < sjw) return HAL_ERROR;
+    cfg->sjw = sjw;
+
+    return HAL_OK;
+}
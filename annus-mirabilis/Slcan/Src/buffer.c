@@ -26,41 +26,72 @@
 #include "usbd_cdc_if.h"
 #include "buffer.h"
 #include "can.h"
+#include "diag.h"
+#include "event.h"
+#include "hist.h"
 #include "led.h"
+#include "msgram.h"
 #include "slcan.h"
+#include "trace.h"
 
 // Cirbuf structure for CAN TX frames
 struct buf_can_tx
 {
     FDCAN_TxHeaderTypeDef header[BUF_CAN_TXQUEUE_LEN];  // Header buffer
-    uint8_t data[BUF_CAN_TXQUEUE_LEN][CAN_MAX_DATALEN]; // Data buffer
+    uint8_t data[BUF_CAN_TXQUEUE_LEN][CAN_MAX_DATALEN] __ALIGNED(4);   // Data buffer, word aligned for the message RAM
+    uint32_t stamp_us[BUF_CAN_TXQUEUE_LEN];     // Time queued, found by the message marker of the tx event
+    uint8_t done[BUF_CAN_TXQUEUE_LEN];          // Sent or cancelled, the tail moves over it
     uint16_t head;                              // Head pointer
     uint16_t send;                              // Send pointer
     uint16_t tail;                              // Tail pointer
     uint8_t full;                               // Set this when it is full, clear when the tail moves one.
 };
 
+// Reception time of the rx frames in each buffer to host on data port
+struct buf_cdc_stamp
+{
+    uint32_t stamp_us[BUF_CDC_TX_NUM_BUFS][BUF_CDC_TX_STAMP_NUM];
+    uint16_t num[BUF_CDC_TX_NUM_BUFS];
+    volatile uint32_t handoff_us[BUF_CDC_TX_NUM_BUFS];  // Time handed to USB, also set in interrupt
+    uint32_t counted;                                   // Last buffer handed to USB and counted
+};
+
 // Public variables (shared with interrupts)
-volatile struct buf_cdc_tx buf_cdc_tx = {0};
-volatile struct buf_cdc_rx buf_cdc_rx = {0};
+volatile struct buf_cdc_tx buf_cdc_tx[BUF_CDC_PORT_NUM] = {0};
+volatile struct buf_cdc_rx buf_cdc_rx[BUF_CDC_PORT_NUM] = {0};
 
 // Private variables
 static struct buf_can_tx buf_can_tx = {0};
-static uint8_t slcan_str[SLCAN_MTU];
-static uint8_t slcan_str_index = 0;
+static struct buf_cdc_stamp buf_cdc_stamp = {0};
+static uint8_t slcan_str[BUF_CDC_PORT_NUM][SLCAN_MTU];
+static uint8_t slcan_str_index[BUF_CDC_PORT_NUM] = {0};
+static enum buf_cdc_port buf_cdc_dest_port = BUF_CDC_PORT_DATA;   // Port written by buf_enqueue_cdc and buf_get_cdc_dest
 
 // Private prototypes
+static uint8_t buf_process_cdc_rx_port(enum buf_cdc_port port);
+static void buf_process_cdc_tx_port(enum buf_cdc_port port);
+static void buf_count_rx_latency(void);
 
 // Initializes
 void buf_init(void)
 {
-    buf_cdc_rx.head = 0;
-    buf_cdc_rx.tail = 0;
+    for (uint8_t port = 0; port < BUF_CDC_PORT_NUM; port++)
+    {
+        buf_cdc_rx[port].head = 0;
+        buf_cdc_rx[port].tail = 0;
 
-    buf_cdc_tx.head = 1;
-    buf_cdc_tx.msglen[buf_cdc_tx.head] = 0;
-    buf_cdc_tx.tail = 0;
-    buf_cdc_tx.msglen[buf_cdc_tx.tail] = 0;
+        buf_cdc_tx[port].head = 1;
+        buf_cdc_tx[port].msglen[buf_cdc_tx[port].head] = 0;
+        buf_cdc_tx[port].tail = 0;
+        buf_cdc_tx[port].msglen[buf_cdc_tx[port].tail] = 0;
+
+        slcan_str_index[port] = 0;
+    }
+    buf_cdc_dest_port = BUF_CDC_PORT_DATA;
+
+    for (uint8_t i = 0; i < BUF_CDC_TX_NUM_BUFS; i++)
+        buf_cdc_stamp.num[i] = 0;
+    buf_cdc_stamp.counted = buf_cdc_tx[BUF_CDC_PORT_DATA].tail;
 
     buf_can_tx.head = 0;
     buf_can_tx.send = 0;
@@ -68,124 +99,146 @@ void buf_init(void)
     buf_can_tx.full = 0;
 }
 
-// Process
-void buf_process(void)
+// Parse one received buffer of each port, repost the event while more are waiting
+__RAM_FUNC void buf_process_cdc_rx(void)
 {
-    // Process cdc receive buffer
-    __disable_irq();
-    uint32_t tmp_head = buf_cdc_rx.head;
-    __enable_irq();
-    if (buf_cdc_rx.tail != tmp_head)
-    {
-        //  Process one whole buffer
-        for (uint32_t i = 0; i < buf_cdc_rx.msglen[buf_cdc_rx.tail]; i++)
-	    {
-            if (buf_cdc_rx.data[buf_cdc_rx.tail][i] == '\r')
-            {
-                slcan_parse_str(slcan_str, slcan_str_index);
-                slcan_str_index = 0;
-
-                // Blink blue LED as slcan rx if bus closed
-                if (can_get_bus_state() == BUS_CLOSED) led_blink_rxd();
-            }
-            else
-            {
-                // Check for buffer overflow
-                if (slcan_str_index >= SLCAN_MTU)
-                {
-                    slcan_str_index = 0;
-                }
-
-                slcan_str[slcan_str_index++] = buf_cdc_rx.data[buf_cdc_rx.tail][i];
-            }
-        }
+    uint8_t is_pending = 0;
 
-        // Move on to the next buffer
-    	__disable_irq();
-        buf_cdc_rx.tail = (buf_cdc_rx.tail + 1) % BUF_CDC_RX_NUM_BUFS;
-    	__enable_irq();
-    }
-
-    // Process cdc transmit buffer
-    uint32_t new_head = (buf_cdc_tx.head + 1UL) % BUF_CDC_TX_NUM_BUFS;
-    if (new_head != buf_cdc_tx.tail)
+    for (uint8_t port = 0; port < BUF_CDC_PORT_NUM; port++)
     {
-        if (0 < buf_cdc_tx.msglen[buf_cdc_tx.head])
-        {
-            buf_cdc_tx.head = new_head;
-            buf_cdc_tx.msglen[new_head] = 0;
-        }
+        is_pending |= buf_process_cdc_rx_port(port);
     }
-    __disable_irq();
-    uint32_t new_tail = (buf_cdc_tx.tail + 1UL) % BUF_CDC_TX_NUM_BUFS;
-    if (new_tail != buf_cdc_tx.head)
+
+    // Give the CAN rx a chance between buffers
+    if (is_pending) event_post(EVENT_CDC_RX);
+}
+
+// Send the buffered replies and frames of each port to host
+__RAM_FUNC void buf_process_cdc_tx(void)
+{
+    for (uint8_t port = 0; port < BUF_CDC_PORT_NUM; port++)
     {
-        if (CDC_Transmit_FS((uint8_t *)buf_cdc_tx.data[new_tail], buf_cdc_tx.msglen[new_tail]) == USBD_OK)
-        {
-            buf_cdc_tx.tail = new_tail;
-        }
+        buf_process_cdc_tx_port(port);
     }
-    __enable_irq();
-
+}
 
-    // Process can transmit buffer
+// Move frames from can transmit buffer to the tx FIFO while it has space
+__RAM_FUNC void buf_process_can_tx(void)
+{
     while ((buf_can_tx.send != buf_can_tx.head || buf_can_tx.full) && (HAL_FDCAN_GetTxFifoFreeLevel(can_get_handle()) > 0))
     {
         HAL_StatusTypeDef status;
+        uint32_t marker = buf_can_tx.header[buf_can_tx.send].MessageMarker;
+
+        // Drop the frame waited too long, never put it on the bus
+        if (can_is_tx_expired(buf_can_tx.stamp_us[buf_can_tx.send]) == ENABLE)
+        {
+            buf_can_tx.send = (buf_can_tx.send + 1) % BUF_CAN_TXQUEUE_LEN;
+            can_report_tx_cancel(&buf_can_tx.header[marker], CAN_TX_CANCEL_EXPIRY);
+            buf_release_can_tx(marker);
+            continue;
+        }
 
         // Transmit can frame
-        status = HAL_FDCAN_AddMessageToTxFifoQ(can_get_handle(), 
-                                               &buf_can_tx.header[buf_can_tx.send], 
-                                               buf_can_tx.data[buf_can_tx.send]);
+        status = msgram_add_tx(&buf_can_tx.header[buf_can_tx.send], buf_can_tx.data[buf_can_tx.send]);
+        TRACE(TRACE_CAN_TX_SUBMIT, buf_can_tx.header[buf_can_tx.send].Identifier);
 
         buf_can_tx.send = (buf_can_tx.send + 1) % BUF_CAN_TXQUEUE_LEN;
 
         if (status != HAL_OK)
         {
+            diag_count_loss(DIAG_LOSS_CAN_TX_ADD);
             slcan_raise_error(SLCAN_STS_DATA_OVERRUN);
+            buf_release_can_tx(marker);
+        }
+        else
+        {
+            can_mark_tx_submit(marker);
+            diag_update_peak(DIAG_PEAK_CAN_TX_FIFO, CAN_TX_FIFO_SIZE - HAL_FDCAN_GetTxFifoFreeLevel(can_get_handle()));
         }
     }
 }
 
 // Enqueue data for transmission over USB CDC to host (copy and comit = slow)
-void buf_enqueue_cdc(uint8_t* buf, uint16_t len)
+__RAM_FUNC void buf_enqueue_cdc(uint8_t* buf, uint16_t len)
+{
+    buf_enqueue_cdc_port(buf_cdc_dest_port, buf, len);
+}
+
+// Enqueue data for a given port, regardless of the port the command came from
+__RAM_FUNC void buf_enqueue_cdc_port(enum buf_cdc_port port, uint8_t* buf, uint16_t len)
 {
-    if (BUF_CDC_TX_BUF_SIZE - len < buf_cdc_tx.msglen[buf_cdc_tx.head])
+    volatile struct buf_cdc_tx *tx = &buf_cdc_tx[port];
+
+    if (BUF_CDC_TX_BUF_SIZE - len < tx->msglen[tx->head])
     {
+        diag_count_loss(DIAG_LOSS_CDC_TX_DATA + port);
         slcan_raise_error(SLCAN_STS_CAN_RX_FIFO_FULL);  // The data does not fit in the buffer
     }
     else
     {
         // Copy data
-        memcpy((uint8_t *)&buf_cdc_tx.data[buf_cdc_tx.head][buf_cdc_tx.msglen[buf_cdc_tx.head]], buf, len);
-        buf_cdc_tx.msglen[buf_cdc_tx.head] += len;
+        memcpy((uint8_t *)&tx->data[tx->head][tx->msglen[tx->head]], buf, len);
+        tx->msglen[tx->head] += len;
+        diag_update_peak(DIAG_PEAK_CDC_TX_DATA + port, tx->msglen[tx->head]);
+        event_post(EVENT_CDC_TX);
     }
 }
 
 // Get destination pointer of cdc buffer (Start position of write access)
-uint8_t *buf_get_cdc_dest(void)
+__RAM_FUNC uint8_t *buf_get_cdc_dest(void)
 {
-    if (BUF_CDC_TX_BUF_SIZE - SLCAN_MTU < buf_cdc_tx.msglen[buf_cdc_tx.head])  // TODO do not use slcan parameter
+    volatile struct buf_cdc_tx *tx = &buf_cdc_tx[buf_cdc_dest_port];
+
+    if (BUF_CDC_TX_BUF_SIZE - SLCAN_MTU < tx->msglen[tx->head])  // TODO do not use slcan parameter
     {
+        diag_count_loss(DIAG_LOSS_CDC_TX_DATA + buf_cdc_dest_port);
         slcan_raise_error(SLCAN_STS_CAN_RX_FIFO_FULL);  // The data will not fit in the buffer
         return NULL;
     }
 
-    return (uint8_t *)&buf_cdc_tx.data[buf_cdc_tx.head][buf_cdc_tx.msglen[buf_cdc_tx.head]];
+    return (uint8_t *)&tx->data[tx->head][tx->msglen[tx->head]];
 }
 
 // Send the data bytes in destination area over USB CDC to host
-void buf_comit_cdc_dest(uint32_t len)
+__RAM_FUNC void buf_comit_cdc_dest(uint32_t len)
+{
+    buf_cdc_tx[buf_cdc_dest_port].msglen[buf_cdc_tx[buf_cdc_dest_port].head] += len;  // TODO protection against overrun
+    if (0 < len)
+    {
+        diag_update_peak(DIAG_PEAK_CDC_TX_DATA + buf_cdc_dest_port, buf_cdc_tx[buf_cdc_dest_port].msglen[buf_cdc_tx[buf_cdc_dest_port].head]);
+        event_post(EVENT_CDC_TX);
+    }
+}
+
+// Record the reception time of a rx frame just reported to the data port
+__RAM_FUNC void buf_stamp_cdc_rx_frame(uint32_t stamp_us)
 {
-    buf_cdc_tx.msglen[buf_cdc_tx.head] += len;  // TODO protection against overrun
+    uint32_t head = buf_cdc_tx[BUF_CDC_PORT_DATA].head;
+
+    if (buf_cdc_stamp.num[head] < BUF_CDC_TX_STAMP_NUM)
+        buf_cdc_stamp.stamp_us[head][buf_cdc_stamp.num[head]++] = stamp_us;
+}
+
+// Get the port the command being parsed came from
+enum buf_cdc_port buf_get_cdc_dest_port(void)
+{
+    return buf_cdc_dest_port;
+}
+
+// Get the number of bytes waiting in the buffer being filled for the destination port
+__RAM_FUNC uint32_t buf_get_cdc_tx_level(void)
+{
+    return buf_cdc_tx[buf_cdc_dest_port].msglen[buf_cdc_tx[buf_cdc_dest_port].head];
 }
 
 // Get destination pointer of can tx frame header
-FDCAN_TxHeaderTypeDef *buf_get_can_dest_header(void)
+__RAM_FUNC FDCAN_TxHeaderTypeDef *buf_get_can_dest_header(void)
 {
     if (buf_can_tx.full)
     {
-        slcan_raise_error(SLCAN_STS_CAN_TX_FIFO_FULL);;
+        diag_count_loss(DIAG_LOSS_CAN_TX_QUEUE);    // Count here, called first for every frame
+        slcan_raise_error(SLCAN_STS_CAN_TX_FIFO_FULL);
         return NULL;
     }
 
@@ -193,11 +246,11 @@ FDCAN_TxHeaderTypeDef *buf_get_can_dest_header(void)
 }
 
 // Get destination pointer of can tx frame data bytes
-uint8_t *buf_get_can_dest_data(void)
+__RAM_FUNC uint8_t *buf_get_can_dest_data(void)
 {
     if (buf_can_tx.full)
     {
-        slcan_raise_error(SLCAN_STS_CAN_TX_FIFO_FULL);;
+        slcan_raise_error(SLCAN_STS_CAN_TX_FIFO_FULL);
         return NULL;
     }
 
@@ -205,20 +258,27 @@ uint8_t *buf_get_can_dest_data(void)
 }
 
 // Send the message in destination slot on the CAN bus.
-HAL_StatusTypeDef buf_comit_can_dest(void)
+__RAM_FUNC HAL_StatusTypeDef buf_comit_can_dest(void)
 {
     if (can_is_tx_enabled() == ENABLE)
     {
         // If the queue is full
         if (buf_can_tx.full)
         {
-            slcan_raise_error(SLCAN_STS_CAN_TX_FIFO_FULL);;
+            slcan_raise_error(SLCAN_STS_CAN_TX_FIFO_FULL);
             return HAL_ERROR;
         }
 
+        // Mark the frame with its slot to get the time queued back from the tx event
+        buf_can_tx.header[buf_can_tx.head].MessageMarker = buf_can_tx.head;
+        buf_can_tx.stamp_us[buf_can_tx.head] = can_get_uptime_us();
+
         // Increment the head pointer
         buf_can_tx.head = (buf_can_tx.head + 1) % BUF_CAN_TXQUEUE_LEN;
         if (buf_can_tx.head == buf_can_tx.tail) buf_can_tx.full = 1;
+        diag_update_peak(DIAG_PEAK_CAN_TX_QUEUE, buf_can_tx.full ? BUF_CAN_TXQUEUE_LEN :
+                         (buf_can_tx.head + BUF_CAN_TXQUEUE_LEN - buf_can_tx.tail) % BUF_CAN_TXQUEUE_LEN);
+        event_post(EVENT_CAN_TX);
     }
     else
     {
@@ -228,15 +288,36 @@ HAL_StatusTypeDef buf_comit_can_dest(void)
     return HAL_OK;
 }
 
-// Dequeue data bytes from the can tx buffer (Delete one frame)
-uint8_t *buf_dequeue_can_tx_data(void)
+// Get data bytes of a frame in the can tx buffer from its message marker
+__RAM_FUNC uint8_t *buf_get_can_tx_data(uint32_t marker)
 {
-    uint32_t tmp_tail = buf_can_tx.tail;
+    return buf_can_tx.data[marker % BUF_CAN_TXQUEUE_LEN];
+}
 
-    buf_can_tx.tail = (buf_can_tx.tail + 1) % BUF_CAN_TXQUEUE_LEN;
-    buf_can_tx.full = 0;
+// Get header of a frame in the can tx buffer from its message marker
+FDCAN_TxHeaderTypeDef *buf_get_can_tx_header(uint32_t marker)
+{
+    return &buf_can_tx.header[marker % BUF_CAN_TXQUEUE_LEN];
+}
+
+// Free a frame sent or cancelled, frames can be cancelled out of order
+__RAM_FUNC void buf_release_can_tx(uint32_t marker)
+{
+    buf_can_tx.done[marker % BUF_CAN_TXQUEUE_LEN] = 1;
+
+    // Move the tail over the frames done, but not over the ones not submitted yet (all submitted if full at send)
+    while ((buf_can_tx.tail != buf_can_tx.send || buf_can_tx.full) && buf_can_tx.done[buf_can_tx.tail])
+    {
+        buf_can_tx.done[buf_can_tx.tail] = 0;
+        buf_can_tx.tail = (buf_can_tx.tail + 1) % BUF_CAN_TXQUEUE_LEN;
+        buf_can_tx.full = 0;
+    }
+}
 
-    return buf_can_tx.data[tmp_tail];
+// Get the time a frame was queued from the message marker of its tx event
+__RAM_FUNC uint32_t buf_get_can_tx_stamp_us(uint32_t marker)
+{
+    return buf_can_tx.stamp_us[marker % BUF_CAN_TXQUEUE_LEN];
 }
 
 // Clear can tx buffer
@@ -245,4 +326,109 @@ void buf_clear_can_buffer(void)
     buf_can_tx.tail = buf_can_tx.head;
     buf_can_tx.send = buf_can_tx.head;
     buf_can_tx.full = 0;
+    memset(buf_can_tx.done, 0, sizeof(buf_can_tx.done));
+}
+
+// Parse the received lines of a port, replies go back to the same port. Return 1 if more buffers wait.
+__RAM_FUNC static uint8_t buf_process_cdc_rx_port(enum buf_cdc_port port)
+{
+    volatile struct buf_cdc_rx *rx = &buf_cdc_rx[port];
+
+    __disable_irq();
+    uint32_t tmp_head = rx->head;
+    __enable_irq();
+    if (rx->tail != tmp_head)
+    {
+        //  Process one whole buffer
+        for (uint32_t i = 0; i < rx->msglen[rx->tail]; i++)
+        {
+            if (rx->data[rx->tail][i] == '\r')
+            {
+                buf_cdc_dest_port = port;
+                TRACE(TRACE_PARSE_START, (slcan_str[port][0] << 16) | slcan_str_index[port]);
+                slcan_parse_str(slcan_str[port], slcan_str_index[port]);
+                TRACE(TRACE_PARSE_END, (slcan_str[port][0] << 16) | slcan_str_index[port]);
+                buf_cdc_dest_port = BUF_CDC_PORT_DATA;
+                slcan_str_index[port] = 0;
+
+                // Blink blue LED as slcan rx if bus closed
+                if (can_get_bus_state() == BUS_CLOSED) led_blink_rxd();
+            }
+            else
+            {
+                // Check for buffer overflow
+                if (slcan_str_index[port] >= SLCAN_MTU)
+                {
+                    slcan_str_index[port] = 0;
+                }
+
+                slcan_str[port][slcan_str_index[port]++] = rx->data[rx->tail][i];
+            }
+        }
+
+        // Move on to the next buffer
+        __disable_irq();
+        rx->tail = (rx->tail + 1) % BUF_CDC_RX_NUM_BUFS;
+        tmp_head = rx->head;
+        __enable_irq();
+    }
+
+    return (rx->tail != tmp_head);
+}
+
+// Rotate the triple buffer of a port and start the transfer if the port is idle
+__RAM_FUNC static void buf_process_cdc_tx_port(enum buf_cdc_port port)
+{
+    volatile struct buf_cdc_tx *tx = &buf_cdc_tx[port];
+
+    // Count the buffers handed to USB, also by the interrupt, before one is reused
+    if (port == BUF_CDC_PORT_DATA) buf_count_rx_latency();
+
+    uint32_t new_head = (tx->head + 1UL) % BUF_CDC_TX_NUM_BUFS;
+    if (new_head != tx->tail)
+    {
+        if (0 < tx->msglen[tx->head])
+        {
+            tx->head = new_head;
+            tx->msglen[new_head] = 0;
+        }
+    }
+    __disable_irq();
+    uint32_t new_tail = (tx->tail + 1UL) % BUF_CDC_TX_NUM_BUFS;
+    if (new_tail != tx->head)
+    {
+        if (CDC_Transmit_Port_FS(port, (uint8_t *)tx->data[new_tail], tx->msglen[new_tail]) == USBD_OK)
+        {
+            buf_mark_cdc_tx_handoff(port, new_tail);
+            tx->tail = new_tail;
+        }
+    }
+    __enable_irq();
+
+    if (port == BUF_CDC_PORT_DATA) buf_count_rx_latency();
+}
+
+// Record the time a buffer to host is handed to USB, called before the tail moves to it
+__RAM_FUNC void buf_mark_cdc_tx_handoff(uint8_t port, uint32_t index)
+{
+    if (port == BUF_CDC_PORT_DATA)
+        buf_cdc_stamp.handoff_us[index] = can_get_uptime_us();
+}
+
+// Count the time from reception to handing to USB of the rx frames in the buffers handed since the last call
+__RAM_FUNC static void buf_count_rx_latency(void)
+{
+    struct hist *rx_hist = can_get_rx_latency_hist();
+    uint32_t tail = buf_cdc_tx[BUF_CDC_PORT_DATA].tail;
+
+    while (buf_cdc_stamp.counted != tail)
+    {
+        uint32_t index = (buf_cdc_stamp.counted + 1) % BUF_CDC_TX_NUM_BUFS;
+        uint32_t handoff_us = buf_cdc_stamp.handoff_us[index];
+
+        for (uint32_t i = 0; i < buf_cdc_stamp.num[index]; i++)
+            hist_add(rx_hist, handoff_us - buf_cdc_stamp.stamp_us[index][i]);
+        buf_cdc_stamp.num[index] = 0;
+        buf_cdc_stamp.counted = index;
+    }
 }
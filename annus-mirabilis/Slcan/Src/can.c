@@ -23,12 +23,23 @@
 // Initializes and provides methods to interact with the FDCAN peripheral
 
 #include "stm32g0xx_hal.h"
+#include "perf_counter.h"
 #include "usbd_cdc_if.h"
 #include "fdcan.h"
 #include "buffer.h"
 #include "can.h"
+#include "diag.h"
+#include "event.h"
+#include "hist.h"
+#include "idset.h"
 #include "led.h"
+#include "load.h"
+#include "msgram.h"
+#include "payload.h"
+#include "qos.h"
 #include "slcan.h"
+#include "trace.h"
+#include "bittime.h"
 
 // Bit number for each frame type with zero data length
 #define CAN_BIT_NBR_WOD_CBFF            47
@@ -38,6 +49,26 @@
 #define CAN_BIT_NBR_WOD_FXFF_DATA_S     26
 #define CAN_BIT_NBR_WOD_FXFF_DATA_L     30
 
+// Remote frame to reply to, routed to FIFO1 by the last extended filter element
+#define CAN_REPLY_ID                    0x19050630
+#define CAN_REPLY_DLC                   0xE
+#define CAN_EXT_FILTER_NBR              (IDSET_EXT_FILTER_MAX + 1)
+
+// Transmitter delay compensation
+#define CAN_TDC_MIN_BITRATE             1000000     /* Use delay compensation above this data bitrate */
+#define CAN_TDC_MAX_PRESCALER           2           /* Delay compensation works with data prescaler 1 or 2 only */
+#define CAN_TDC_MAX_OFFSET              0x7F
+
+// Frames summed for the average cycles per frame, the sum fits 32 bits up to 65535 cycles each
+#define CAN_RX_CYCLE_CNT_MAX            0x10000
+
+// Error counters decrease on successful frames without interrupt
+#define CAN_ERROR_FOLLOW_MS             10          /* Min interval to read them again on frame events */
+
+// Automatic bitrate detection
+#define CAN_DETECT_DWELL_MS             100         /* Max listening time for one candidate */
+#define CAN_DETECT_MIN_FRAMES           2           /* Valid frames to accept a data bitrate early */
+
 // Parameter to calculate bus load
 #define CAN_TIME_CNT_MAX_REWIND         360         /* Max cycle ~120ms X 3 times margin. should be < MIN_BIT_NBR * 9 */
 #define CAN_BUS_LOAD_BUILDUP_PPM        1125000     /* Compensate stuff bits and round down in laod calc */
@@ -45,23 +76,129 @@
 // Public variable
 uint8_t can_dlc_to_bytes[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
 
+// Frame in a tx FIFO element of the message RAM
+struct can_tx_slot
+{
+    uint8_t used;
+    uint8_t marker;
+    enum can_tx_cancel cancel;              // Reason of the cancel requested, CAN_TX_CANCEL_NONE if not
+    uint16_t submit_us;                     // Time of submission (us timer, 16bit)
+    uint32_t order;                         // Submission order, the oldest one is on the bus
+};
+
+// Frames in the tx FIFO and the attempts of the oldest one
+struct can_tx_attempt
+{
+    FunctionalState tracked;                // Attempts are counted
+    struct can_tx_slot slot[CAN_TX_FIFO_SIZE];
+    uint32_t order;
+    int8_t contender;                       // Slot of the oldest frame, -1 if none
+    uint16_t contend_us;                    // Time the oldest frame began to contend for the bus (us timer, 16bit)
+    uint32_t arb_lost;
+    uint32_t err_cnt_start;
+};
+
+// Policy to recover from bus off without closing the channel
+struct can_recovery_cfg
+{
+    FunctionalState auto_recover;
+    uint16_t delay_ms;          // From bus off to recovery
+    uint8_t max_num;            // Automatic recoveries after open, 0 for no limit
+};
+
+// Counters collected while listening with one candidate timing
+struct can_detect_count
+{
+    uint32_t frames;
+    uint32_t brs_frames;
+    uint32_t nominal_errors;
+    uint32_t data_errors;
+};
+
+// Phase of the bitrate detection
+enum can_detect_phase
+{
+    CAN_DETECT_NOMINAL,
+    CAN_DETECT_DATA
+};
+
+// Bitrate detection in progress, advanced by the main loop
+struct can_detect
+{
+    enum can_detect_phase phase;
+    uint8_t index;                      // Candidate in the bitrate table of the phase
+    uint32_t start_tick;                // Start of listening with the candidate
+    uint32_t nominal_err_cnt_start;
+    uint32_t data_err_cnt_start;
+    uint32_t start_err;                 // The controller did not start with the candidate
+    struct can_detect_count count;
+    enum can_bitrate_nominal nominal;
+    uint8_t has_data_phase;
+    struct can_bitrate_cfg prev_cfg_nominal;
+    struct can_bitrate_cfg prev_cfg_data;
+    uint32_t prev_mode;
+    can_detect_done_t done;
+};
+
 // Private variables
 static FDCAN_FilterTypeDef can_std_filter;
 static FDCAN_FilterTypeDef can_ext_filter;
-static FDCAN_FilterTypeDef can_std_pass_all;
-static FDCAN_FilterTypeDef can_ext_pass_all;
+static FDCAN_FilterTypeDef can_reply_filter;
 static enum can_bus_state can_bus_state;
-static struct can_error_state can_error_state = {0};
+static volatile struct can_error_state can_error_state = {0};    // Updated in interrupt
+static volatile uint32_t can_protocol_err_cnt_nominal = 0;
+static volatile uint32_t can_protocol_err_cnt_data = 0;
 static uint32_t can_mode = FDCAN_MODE_NORMAL;
 static FunctionalState can_auto_retransmit = ENABLE;
 static struct can_bitrate_cfg can_bit_cfg_nominal, can_bit_cfg_data = {0};
 
-static uint32_t can_cycle_max_time_ns = 0;
-static uint32_t can_cycle_ave_time_ns = 0;
+static uint16_t can_last_frame_time_cnt = 0;
+static uint32_t can_bit_cnt_message = 0;
+static uint32_t can_rx_latency_max_us = 0;
+static uint32_t can_rx_cycle_sum = 0;
+static uint32_t can_rx_cycle_cnt = 0;
+static struct hist can_tx_latency_hist = {0};
+static struct hist can_rx_latency_hist = {0};
+static struct can_tx_attempt can_tx_attempt = {0};
+static struct can_tx_attempt_stat can_tx_attempt_stat = {0};
+static volatile uint32_t can_tx_err_cnt = 0;     // Updated in interrupt
+static uint8_t can_tx_retry_limit = 0;
+static struct can_recovery_cfg can_recovery_cfg = {DISABLE, 0, 0};
+static struct can_bus_off_stat can_bus_off_stat = {0};
+static volatile uint32_t can_bus_off_tick = 0;          // Updated in interrupt
+static volatile uint8_t can_recovery_started = 0;       // Updated in interrupt
+static uint8_t can_recovery_num = 0;
+static uint16_t can_tx_expiry_ms = 0;
 static uint32_t can_bit_time_ns = 0;
 static uint32_t can_bus_load_ppm = 0;
+static uint32_t can_boot_to_open_time_us = CAN_BOOT_TO_OPEN_NONE;
+static uint32_t can_last_frame_tick = 0;
+static uint32_t can_error_follow_tick = 0;
+static struct can_detect can_detect = {0};
 
 // Private methods
+static HAL_StatusTypeDef can_start(void);
+static HAL_StatusTypeDef can_start_controller(uint32_t non_matching);
+static void can_stop_controller(void);
+static uint32_t can_get_tdc_offset(void);
+static void can_update_rx_latency(uint16_t rx_timestamp);
+static uint32_t can_update_tx_latency(FDCAN_TxEventFifoTypeDef *tx_event);
+static uint32_t can_update_tx_attempt(FDCAN_TxEventFifoTypeDef *tx_event);
+static void can_count_arbitration_lost(uint16_t rx_timestamp);
+static void can_select_tx_contender(uint16_t from_us);
+static void can_process_tx_limit(void);
+static void can_process_bus_off(void);
+static HAL_StatusTypeDef can_update_filter(const FDCAN_FilterTypeDef *filter);
+static HAL_StatusTypeDef can_load_filter(void);
+static void can_start_recovery(void);
+static void can_count_frame(uint16_t timestamp, uint16_t bits);
+static void can_update_rx_cycle(uint32_t cycle);
+static void can_detect_listen(void);
+static void can_detect_drain(void);
+static void can_process_detect(void);
+static void can_detect_finish(HAL_StatusTypeDef status);
+static void can_update_error_state(void);
+static void can_follow_error_count(void);
 static void can_update_bit_time_ns(void);
 static uint16_t can_get_bit_number_in_rx_frame(FDCAN_RxHeaderTypeDef *pRxHeader);
 static uint16_t can_get_bit_number_in_tx_event(FDCAN_TxEventFifoTypeDef *pRxHeader);
@@ -85,19 +222,13 @@ void can_init(void)
     can_ext_filter.FilterID1 = 0x1FFFFFFF;
     can_ext_filter.FilterID2 = 0x00000000;
 
-    can_std_pass_all.IdType = FDCAN_STANDARD_ID;
-    can_std_pass_all.FilterIndex = 1;
-    can_std_pass_all.FilterType = FDCAN_FILTER_MASK;
-    can_std_pass_all.FilterConfig = FDCAN_FILTER_TO_RXFIFO1;
-    can_std_pass_all.FilterID1 = 0x7FF;
-    can_std_pass_all.FilterID2 = 0x000;
-
-    can_ext_pass_all.IdType = FDCAN_EXTENDED_ID;
-    can_ext_pass_all.FilterIndex = 1;
-    can_ext_pass_all.FilterType = FDCAN_FILTER_MASK;
-    can_ext_pass_all.FilterConfig = FDCAN_FILTER_TO_RXFIFO1;
-    can_ext_pass_all.FilterID1 = 0x1FFFFFFF;
-    can_ext_pass_all.FilterID2 = 0x00000000;
+    // Only the remote frame to reply to goes to FIFO1 if the filters above reject it
+    can_reply_filter.IdType = FDCAN_EXTENDED_ID;
+    can_reply_filter.FilterIndex = IDSET_EXT_FILTER_MAX;
+    can_reply_filter.FilterType = FDCAN_FILTER_MASK;
+    can_reply_filter.FilterConfig = FDCAN_FILTER_TO_RXFIFO1;
+    can_reply_filter.FilterID1 = CAN_REPLY_ID;
+    can_reply_filter.FilterID2 = 0x1FFFFFFF;
 
     // default to 125 kbit/s & 2Mbit/s
     can_set_nominal_bitrate(CAN_BITRATE_125K);
@@ -106,72 +237,51 @@ void can_init(void)
     can_bus_state = BUS_CLOSED;
 }
 
-// Start the CAN peripheral and open the channel
+// Open the channel for the host (O, L, =, +, p and auto startup)
 HAL_StatusTypeDef can_enable(void)
 {
-    if (can_bus_state == BUS_CLOSED)
-    {
-        // Reset error counter etc.
-        __HAL_RCC_FDCAN_FORCE_RESET();
-        __HAL_RCC_FDCAN_RELEASE_RESET();
-
-        hfdcan1.Init.ClockDivider = FDCAN_CLOCK_DIV1;
-        hfdcan1.Init.FrameFormat = FDCAN_FRAME_FD_BRS;
-
-        hfdcan1.Init.Mode = can_mode;
-        hfdcan1.Init.AutoRetransmission = can_auto_retransmit;
-        hfdcan1.Init.TransmitPause = DISABLE;
-        hfdcan1.Init.ProtocolException = ENABLE;
-
-        hfdcan1.Init.NominalPrescaler = can_bit_cfg_nominal.prescaler;
-        hfdcan1.Init.NominalSyncJumpWidth = can_bit_cfg_nominal.sjw;
-        hfdcan1.Init.NominalTimeSeg1 = can_bit_cfg_nominal.time_seg1;
-        hfdcan1.Init.NominalTimeSeg2 = can_bit_cfg_nominal.time_seg2;
-
-        // FD only
-        hfdcan1.Init.DataPrescaler = can_bit_cfg_data.prescaler;
-        hfdcan1.Init.DataSyncJumpWidth = can_bit_cfg_data.sjw;
-        hfdcan1.Init.DataTimeSeg1 = can_bit_cfg_data.time_seg1;
-        hfdcan1.Init.DataTimeSeg2 = can_bit_cfg_data.time_seg2;
-
-        hfdcan1.Init.StdFiltersNbr = 2;
-        hfdcan1.Init.ExtFiltersNbr = 2;
-        hfdcan1.Init.TxFifoQueueMode = FDCAN_TX_FIFO_OPERATION;
-
-        if (HAL_FDCAN_Init(&hfdcan1) != HAL_OK) return HAL_ERROR;
-
-        // Setup Tx delay compensation
-        uint32_t offset = can_bit_cfg_data.prescaler * can_bit_cfg_data.time_seg1;
-        if (offset <= 0x1E)
-        {
-            if (HAL_FDCAN_ConfigTxDelayCompensation(&hfdcan1, offset, 0) != HAL_OK) return HAL_ERROR;
-            if (HAL_FDCAN_EnableTxDelayCompensation(&hfdcan1) != HAL_OK) return HAL_ERROR;
-        }
-        else
-        {
-            // The offset value 0x1E corresponds to bitrate 1Mbps @ 50% sampling point or 2Mbps @ 100% sampling point.
-            // Turn off at 1Mbps and Turn on at 2Mbps
-            HAL_FDCAN_DisableTxDelayCompensation(&hfdcan1);
-        }
+    if (can_start() != HAL_OK)
+        return HAL_ERROR;
 
-        if (HAL_FDCAN_ConfigFilter(&hfdcan1, &can_std_filter) != HAL_OK) return HAL_ERROR;
-        if (HAL_FDCAN_ConfigFilter(&hfdcan1, &can_ext_filter) != HAL_OK) return HAL_ERROR;
-        if (HAL_FDCAN_ConfigFilter(&hfdcan1, &can_std_pass_all) != HAL_OK) return HAL_ERROR;
-        if (HAL_FDCAN_ConfigFilter(&hfdcan1, &can_ext_pass_all) != HAL_OK) return HAL_ERROR;
-        HAL_FDCAN_ConfigGlobalFilter(&hfdcan1, FDCAN_REJECT, FDCAN_REJECT, FDCAN_FILTER_REMOTE, FDCAN_FILTER_REMOTE);
+    // Record the time only for the first open after power on
+    if (can_boot_to_open_time_us == CAN_BOOT_TO_OPEN_NONE)
+        can_boot_to_open_time_us = can_get_uptime_us();
 
-        HAL_FDCAN_ConfigTimestampCounter(&hfdcan1, FDCAN_TIMESTAMP_PRESC_1);
-        // Internal does not work to get time. External use TIM3 as source. See RM0444.
-        HAL_FDCAN_EnableTimestampCounter(&hfdcan1, FDCAN_TIMESTAMP_EXTERNAL);
+    return HAL_OK;
+}
 
-        if (HAL_FDCAN_Start(&hfdcan1) != HAL_OK) return HAL_ERROR;
+// Start the CAN peripheral and open the channel
+static HAL_StatusTypeDef can_start(void)
+{
+    if (can_bus_state == BUS_CLOSED)
+    {
+        // Frames not accepted are dropped by the hardware without an interrupt
+        if (can_start_controller(FDCAN_REJECT) != HAL_OK) return HAL_ERROR;
 
         buf_clear_can_buffer();
 
         can_update_bit_time_ns();
-        can_clear_cycle_time();
+        can_clear_rx_latency();
         can_bus_load_ppm = 0;
+        can_last_frame_tick = HAL_GetTick();
+        load_clear();
+
+        // Retries are hidden only in normal mode, and a frame losing once is dropped without auto retransmission
+        can_tx_attempt = (struct can_tx_attempt){0};
+        can_tx_attempt.contender = -1;
+        can_recovery_num = 0;
+        can_recovery_started = 0;
+        if (can_mode == FDCAN_MODE_NORMAL && can_auto_retransmit == ENABLE)
+            can_tx_attempt.tracked = ENABLE;
+        else
+            can_tx_attempt.tracked = DISABLE;
+        __disable_irq();
+        can_error_state.bus_off = 0;
+        can_error_state.err_pssv = 0;
+        can_error_state.tec = 0;
+        can_error_state.rec = 0;
         can_error_state.last_err_code = FDCAN_PROTOCOL_ERROR_NONE;
+        __enable_irq();
 
         led_turn_txd(LED_OFF);
 
@@ -182,17 +292,95 @@ HAL_StatusTypeDef can_enable(void)
     return HAL_ERROR;
 }
 
-// Disable the CAN peripheral and close the channel
+// Initialize and start the controller with the current settings, the buffers and statistics are left as they are
+static HAL_StatusTypeDef can_start_controller(uint32_t non_matching)
+{
+    // Reset error counter etc.
+    __HAL_RCC_FDCAN_FORCE_RESET();
+    __HAL_RCC_FDCAN_RELEASE_RESET();
+
+    hfdcan1.Init.ClockDivider = FDCAN_CLOCK_DIV1;
+    hfdcan1.Init.FrameFormat = FDCAN_FRAME_FD_BRS;
+
+    hfdcan1.Init.Mode = can_mode;
+    hfdcan1.Init.AutoRetransmission = can_auto_retransmit;
+    hfdcan1.Init.TransmitPause = DISABLE;
+    hfdcan1.Init.ProtocolException = ENABLE;
+
+    hfdcan1.Init.NominalPrescaler = can_bit_cfg_nominal.prescaler;
+    hfdcan1.Init.NominalSyncJumpWidth = can_bit_cfg_nominal.sjw;
+    hfdcan1.Init.NominalTimeSeg1 = can_bit_cfg_nominal.time_seg1;
+    hfdcan1.Init.NominalTimeSeg2 = can_bit_cfg_nominal.time_seg2;
+
+    // FD only
+    hfdcan1.Init.DataPrescaler = can_bit_cfg_data.prescaler;
+    hfdcan1.Init.DataSyncJumpWidth = can_bit_cfg_data.sjw;
+    hfdcan1.Init.DataTimeSeg1 = can_bit_cfg_data.time_seg1;
+    hfdcan1.Init.DataTimeSeg2 = can_bit_cfg_data.time_seg2;
+
+    // All elements are in the lists so that the filter mode and the ID set can change while open
+    if (idset_is_enabled() == ENABLE) idset_compile();
+    hfdcan1.Init.StdFiltersNbr = IDSET_STD_FILTER_MAX;
+    hfdcan1.Init.ExtFiltersNbr = CAN_EXT_FILTER_NBR;
+    hfdcan1.Init.TxFifoQueueMode = FDCAN_TX_FIFO_OPERATION;
+
+    if (HAL_FDCAN_Init(&hfdcan1) != HAL_OK) return HAL_ERROR;
+
+    // Setup Tx delay compensation
+    uint32_t offset = can_get_tdc_offset();
+    if (offset != 0)
+    {
+        if (HAL_FDCAN_ConfigTxDelayCompensation(&hfdcan1, offset, 0) != HAL_OK) return HAL_ERROR;
+        if (HAL_FDCAN_EnableTxDelayCompensation(&hfdcan1) != HAL_OK) return HAL_ERROR;
+    }
+    else
+    {
+        HAL_FDCAN_DisableTxDelayCompensation(&hfdcan1);
+    }
+
+    if (can_load_filter() != HAL_OK) return HAL_ERROR;
+    HAL_FDCAN_ConfigGlobalFilter(&hfdcan1, non_matching, non_matching, FDCAN_FILTER_REMOTE, FDCAN_FILTER_REMOTE);
+
+    HAL_FDCAN_ConfigTimestampCounter(&hfdcan1, FDCAN_TIMESTAMP_PRESC_1);
+    // Internal does not work to get time. External use TIM3 as source. See RM0444.
+    HAL_FDCAN_EnableTimestampCounter(&hfdcan1, FDCAN_TIMESTAMP_EXTERNAL);
+
+    // Wake up the main loop on frame reception and transmission
+    HAL_FDCAN_ActivateNotification(&hfdcan1, FDCAN_IT_RX_FIFO0_NEW_MESSAGE | FDCAN_IT_RX_FIFO1_NEW_MESSAGE | FDCAN_IT_TX_EVT_FIFO_NEW_DATA, 0);
+    // Track the message loss and the error state in interrupt
+    HAL_FDCAN_ActivateNotification(&hfdcan1, FDCAN_IT_RX_FIFO0_MESSAGE_LOST | FDCAN_IT_RX_FIFO1_MESSAGE_LOST | FDCAN_IT_TX_EVT_FIFO_ELT_LOST, 0);
+    HAL_FDCAN_ActivateNotification(&hfdcan1, FDCAN_IT_ERROR_WARNING | FDCAN_IT_ERROR_PASSIVE | FDCAN_IT_BUS_OFF, 0);
+    HAL_FDCAN_ActivateNotification(&hfdcan1, FDCAN_IT_ARB_PROTOCOL_ERROR | FDCAN_IT_DATA_PROTOCOL_ERROR, 0);
+
+    // Bind the report generators to the current settings, Z and z bind them again while open
+    slcan_bind_generator();
+
+    return HAL_FDCAN_Start(&hfdcan1);
+}
+
+// Stop the controller, the buffers and statistics are left as they are
+static void can_stop_controller(void)
+{
+    HAL_FDCAN_Stop(&hfdcan1);
+    HAL_FDCAN_DeInit(&hfdcan1);
+
+    // Reset error counter etc.
+    __HAL_RCC_FDCAN_FORCE_RESET();
+    __HAL_RCC_FDCAN_RELEASE_RESET();
+}
+
+// Disable the CAN peripheral and close the channel, or cancel the bitrate detection
 HAL_StatusTypeDef can_disable(void)
 {
+    if (can_bus_state == BUS_DETECTING)
+    {
+        can_stop_controller();
+        can_detect_finish(HAL_ERROR);
+        return HAL_OK;
+    }
     if (can_bus_state == BUS_OPENED)
     {
-        HAL_FDCAN_Stop(&hfdcan1);
-        HAL_FDCAN_DeInit(&hfdcan1);
-
-        // Reset error counter etc.
-        __HAL_RCC_FDCAN_FORCE_RESET();
-        __HAL_RCC_FDCAN_RELEASE_RESET();
+        can_stop_controller();
 
         buf_clear_can_buffer();
 
@@ -205,208 +393,215 @@ HAL_StatusTypeDef can_disable(void)
     return HAL_ERROR;
 }
 
-// Process data from CAN tx/rx circular buffers
-void can_process(void)
+// Report frames transmitted or received on the bus until the FIFOs are empty
+__RAM_FUNC void can_process_rx(void)
 {
-    static uint16_t last_frame_time_cnt = 0;
-    static uint32_t bit_cnt_message = 0;
     FDCAN_TxEventFifoTypeDef tx_event;
     FDCAN_RxHeaderTypeDef rx_msg_header;
-    uint8_t rx_msg_data[64] = {0};
-
-    // If message transmitted on bus, parse the frame
-    if (HAL_FDCAN_GetTxEvent(&hfdcan1, &tx_event) == HAL_OK)
-    {
-        int32_t len = slcan_generate_tx_event(buf_get_cdc_dest(), &tx_event, buf_dequeue_can_tx_data());
-        buf_comit_cdc_dest(len);
+    uint8_t *rx_msg_data;
+    uint8_t is_processed;
+    uint8_t has_frame = 0;
 
-        if (tx_event.TxTimestamp != last_frame_time_cnt)    // Don't count same frame.
-        {
-            bit_cnt_message += can_get_bit_number_in_tx_event(&tx_event);
-            last_frame_time_cnt = tx_event.TxTimestamp;
-        }
+    // The levels are highest before the drain
+    diag_update_peak(DIAG_PEAK_CAN_RX_FIFO0, HAL_FDCAN_GetRxFifoFillLevel(&hfdcan1, FDCAN_RX_FIFO0));
+    diag_update_peak(DIAG_PEAK_CAN_RX_FIFO1, HAL_FDCAN_GetRxFifoFillLevel(&hfdcan1, FDCAN_RX_FIFO1));
+    diag_update_peak(DIAG_PEAK_CAN_TX_EVENT, (hfdcan1.Instance->TXEFS & FDCAN_TXEFS_EFFL) >> FDCAN_TXEFS_EFFL_Pos);
 
-        led_blink_txd();
+    // Frames seen while detecting the bitrate are only counted
+    if (can_bus_state == BUS_DETECTING)
+    {
+        can_detect_drain();
+        return;
     }
 
-    // Message has been accepted, pull it from the buffer
-    if (HAL_FDCAN_GetRxMessage(&hfdcan1, FDCAN_RX_FIFO0, &rx_msg_header, rx_msg_data) == HAL_OK)
+    do
     {
-        int32_t len = slcan_generate_rx_frame(buf_get_cdc_dest(), &rx_msg_header, rx_msg_data);
-        buf_comit_cdc_dest(len);
+        is_processed = 0;
 
-        if (rx_msg_header.RxTimestamp != last_frame_time_cnt)   // Don't count same frame.
+        // If message transmitted on bus, parse the frame
+        if (msgram_get_tx_event(&tx_event) == HAL_OK)
         {
-            bit_cnt_message += can_get_bit_number_in_rx_frame(&rx_msg_header);
-            last_frame_time_cnt = rx_msg_header.RxTimestamp;
+            TRACE(TRACE_CAN_TX_EVENT, tx_event.MessageMarker);
+            uint32_t latency_us = can_update_tx_latency(&tx_event);
+            uint32_t attempts = can_update_tx_attempt(&tx_event);
+            int32_t len = slcan_generate_tx_event(buf_get_cdc_dest(), &tx_event, buf_get_can_tx_data(tx_event.MessageMarker), latency_us, attempts);
+            buf_comit_cdc_dest(len);
+            buf_release_can_tx(tx_event.MessageMarker);
+
+            if (tx_event.TxTimestamp != can_last_frame_time_cnt)    // Don't count same frame.
+                can_count_frame(tx_event.TxTimestamp, can_get_bit_number_in_tx_event(&tx_event));
+            can_last_frame_tick = HAL_GetTick();
+
+            // Space in tx FIFO for the next frame
+            event_post(EVENT_CAN_TX);
+
+            led_blink_txd();
+            is_processed = 1;
         }
 
-        // Pasa all accepted frames to the function to react to a remote frame
-        can_reply_to_remote_frame(&rx_msg_header, rx_msg_data);
+        // Message has been accepted, report it straight from the message RAM
+        int64_t start_cycle = get_system_ticks();
+        if (msgram_peek_rx(FDCAN_RX_FIFO0, &rx_msg_header, &rx_msg_data) == HAL_OK)
+        {
+            TRACE(TRACE_CAN_RX0, rx_msg_header.Identifier);
+            // Report only the frames passing the ID set and payload filters
+            if (idset_is_accepted(&rx_msg_header) == ENABLE && payload_is_accepted(&rx_msg_header, rx_msg_data) == ENABLE)
+            {
+                // Shed low priority frames first under overload, a NULL destination counts them as lost
+                uint8_t *dest = (qos_is_reported(&rx_msg_header) == ENABLE) ? buf_get_cdc_dest() : NULL;
+                int32_t len = slcan_generate_rx_frame(dest, &rx_msg_header, rx_msg_data);
+                buf_comit_cdc_dest(len);
+
+                // Reception time of the reported frame for the latency to USB
+                if (0 < len)
+                {
+                    uint32_t since_rx_us = (uint16_t)((uint16_t)TIM3->CNT - rx_msg_header.RxTimestamp);
+                    buf_stamp_cdc_rx_frame(can_get_uptime_us() - since_rx_us);
+                }
+            }
+            can_update_rx_latency(rx_msg_header.RxTimestamp);
 
-        led_blink_rxd();
-    }
+            can_count_arbitration_lost(rx_msg_header.RxTimestamp);
+            if (rx_msg_header.RxTimestamp != can_last_frame_time_cnt)   // Don't count same frame.
+                can_count_frame(rx_msg_header.RxTimestamp, can_get_bit_number_in_rx_frame(&rx_msg_header));
+            can_last_frame_tick = HAL_GetTick();
 
-    // Message has been received but not been accepted, pull it from the buffer
-    if (HAL_FDCAN_GetRxMessage(&hfdcan1, FDCAN_RX_FIFO1, &rx_msg_header, rx_msg_data) == HAL_OK)
-    {
-        if (rx_msg_header.RxTimestamp != last_frame_time_cnt)   // Don't count same frame.
-        {
-            bit_cnt_message += can_get_bit_number_in_rx_frame(&rx_msg_header);
-            last_frame_time_cnt = rx_msg_header.RxTimestamp;
+            // Pasa all accepted frames to the function to react to a remote frame
+            can_reply_to_remote_frame(&rx_msg_header, rx_msg_data);
+
+            msgram_release_rx(FDCAN_RX_FIFO0);
+            can_update_rx_cycle((uint32_t)(get_system_ticks() - start_cycle));
+
+            led_blink_rxd();
+            is_processed = 1;
         }
 
-        // Pasa all recieved but not accepted frames to the function to react to a remote frame
-        can_reply_to_remote_frame(&rx_msg_header, rx_msg_data);
+        // Remote frame to reply to but not accepted by the filter, only the header is used
+        if (msgram_peek_rx(FDCAN_RX_FIFO1, &rx_msg_header, &rx_msg_data) == HAL_OK)
+        {
+            TRACE(TRACE_CAN_RX1, rx_msg_header.Identifier);
+            msgram_release_rx(FDCAN_RX_FIFO1);
 
-        led_blink_rxd();
-    }
+            can_count_arbitration_lost(rx_msg_header.RxTimestamp);
+            if (rx_msg_header.RxTimestamp != can_last_frame_time_cnt)   // Don't count same frame.
+                can_count_frame(rx_msg_header.RxTimestamp, can_get_bit_number_in_rx_frame(&rx_msg_header));
+            can_last_frame_tick = HAL_GetTick();
 
+            // A remote frame has no data, so the header is enough
+            can_reply_to_remote_frame(&rx_msg_header, NULL);
+
+            led_blink_rxd();
+            is_processed = 1;
+        }
+        has_frame |= is_processed;
+    } while (is_processed);
+
+    if (has_frame) can_follow_error_count();
+}
+
+// Update bus load and error status, called periodically
+void can_process_status(void)
+{
     // Update bus load
     static uint32_t tick_last = 0;
     uint32_t tick_now = HAL_GetTick();
     if (100 <= (uint32_t)(tick_now - tick_last))    // Update in every 100ms interval
     {
-        uint32_t rate_us_per_ms = (uint32_t)bit_cnt_message * can_bit_time_ns / 1000 / 100;   // MAX: 1000 @ 1Mbps
+        uint32_t rate_us_per_ms = (uint32_t)can_bit_cnt_message * can_bit_time_ns / 1000 / 100;   // MAX: 1000 @ 1Mbps
         can_bus_load_ppm = (can_bus_load_ppm * 7 + (uint32_t)CAN_BUS_LOAD_BUILDUP_PPM * rate_us_per_ms / 1000) >> 3;
-        bit_cnt_message = 0;
+        can_bit_cnt_message = 0;
         tick_last = tick_now;
     }
 
-    // Check for message loss
-    if (__HAL_FDCAN_GET_FLAG(&hfdcan1, FDCAN_FLAG_TX_EVT_FIFO_ELT_LOST))
-    {
-        slcan_raise_error(SLCAN_STS_DATA_OVERRUN);
-        __HAL_FDCAN_CLEAR_FLAG(&hfdcan1, FDCAN_FLAG_TX_EVT_FIFO_ELT_LOST);
-    }
-
-    if (__HAL_FDCAN_GET_FLAG(&hfdcan1, FDCAN_FLAG_RX_FIFO0_MESSAGE_LOST))
-    {
-        slcan_raise_error(SLCAN_STS_DATA_OVERRUN);
-        __HAL_FDCAN_CLEAR_FLAG(&hfdcan1, FDCAN_FLAG_RX_FIFO0_MESSAGE_LOST);
-    }
-
-    if (__HAL_FDCAN_GET_FLAG(&hfdcan1, FDCAN_FLAG_RX_FIFO1_MESSAGE_LOST))
-    {
-        slcan_raise_error(SLCAN_STS_DATA_OVERRUN);
-        __HAL_FDCAN_CLEAR_FLAG(&hfdcan1, FDCAN_FLAG_RX_FIFO1_MESSAGE_LOST);
-    }
+    // Close the bus load telemetry sample
+    if (can_bus_state == BUS_OPENED)
+        load_process();
 
-    // Check for bus state and error counter
-    FDCAN_ProtocolStatusTypeDef sts;
-    FDCAN_ErrorCountersTypeDef cnt;
+    // Cancel the frames stuck in the tx FIFO so that the ones behind them can go
+    if (can_bus_state == BUS_OPENED)
+        can_process_tx_limit();
 
-    HAL_FDCAN_GetProtocolStatus(&hfdcan1, &sts);
-    HAL_FDCAN_GetErrorCounters(&hfdcan1, &cnt);
+    // Recover from bus off by the policy
+    if (can_bus_state == BUS_OPENED)
+        can_process_bus_off();
 
-    uint8_t rx_err_cnt = (uint8_t)(cnt.RxErrorPassive ? 128 : cnt.RxErrorCnt);
-    if (rx_err_cnt > can_error_state.rec || cnt.TxErrorCnt > can_error_state.tec)
-        slcan_raise_error(SLCAN_STS_BUS_ERROR);
-    if (sts.BusOff && !can_error_state.bus_off)
-    	slcan_raise_error(SLCAN_STS_BUS_ERROR);  // Capture counter increase that caused bus off
+    // Try the next bitrate candidate once the current one is judged
+    if (can_bus_state == BUS_DETECTING)
+        can_process_detect();
 
-    can_error_state.bus_off = (uint8_t)sts.BusOff;
-    can_error_state.err_pssv = (uint8_t)sts.ErrorPassive;
-    can_error_state.tec = (uint8_t)cnt.TxErrorCnt;
-    can_error_state.rec = (uint8_t)rx_err_cnt;
-    if (sts.DataLastErrorCode != FDCAN_PROTOCOL_ERROR_NONE && sts.DataLastErrorCode != FDCAN_PROTOCOL_ERROR_NO_CHANGE)
-        can_error_state.last_err_code = sts.DataLastErrorCode;
-    if (sts.LastErrorCode != FDCAN_PROTOCOL_ERROR_NONE && sts.LastErrorCode != FDCAN_PROTOCOL_ERROR_NO_CHANGE)
-        can_error_state.last_err_code = sts.LastErrorCode;
+    // Green LED on during bus closed
+    if (can_bus_state == BUS_CLOSED)
+        led_turn_txd(LED_ON);
+}
 
-    // Check for bus error flags
-    if (__HAL_FDCAN_GET_FLAG(&hfdcan1, FDCAN_FLAG_ERROR_WARNING))
+// FDCAN interrupt callbacks, defer the work to the main loop
+void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo0ITs)
+{
+    if (RxFifo0ITs & FDCAN_FLAG_RX_FIFO0_MESSAGE_LOST)
     {
-        slcan_raise_error(SLCAN_STS_ERROR_WARNING);
-        __HAL_FDCAN_CLEAR_FLAG(&hfdcan1, FDCAN_FLAG_ERROR_WARNING);
+        diag_count_loss(DIAG_LOSS_CAN_RX_FIFO0);
+        slcan_raise_error(SLCAN_STS_DATA_OVERRUN);
     }
+    event_post(EVENT_CAN_RX);
+}
 
-    if (__HAL_FDCAN_GET_FLAG(&hfdcan1, FDCAN_FLAG_ERROR_PASSIVE))
+void HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo1ITs)
+{
+    if (RxFifo1ITs & FDCAN_FLAG_RX_FIFO1_MESSAGE_LOST)
     {
-        slcan_raise_error(SLCAN_STS_ERROR_PASSIVE);
-        __HAL_FDCAN_CLEAR_FLAG(&hfdcan1, FDCAN_FLAG_ERROR_PASSIVE);
+        diag_count_loss(DIAG_LOSS_CAN_RX_FIFO1);
+        slcan_raise_error(SLCAN_STS_DATA_OVERRUN);
     }
+    event_post(EVENT_CAN_RX);
+}
 
-    if (__HAL_FDCAN_GET_FLAG(&hfdcan1, FDCAN_FLAG_BUS_OFF))
+void HAL_FDCAN_TxEventFifoCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t TxEventFifoITs)
+{
+    if (TxEventFifoITs & FDCAN_FLAG_TX_EVT_FIFO_ELT_LOST)
     {
-        // No status flag for bus off
-        __HAL_FDCAN_CLEAR_FLAG(&hfdcan1, FDCAN_FLAG_BUS_OFF);
+        diag_count_loss(DIAG_LOSS_CAN_TX_EVENT);
+        slcan_raise_error(SLCAN_STS_DATA_OVERRUN);
     }
+    event_post(EVENT_CAN_RX);
+}
 
-    // Update cycle time
-    static uint32_t last_time_stamp_cnt = 0;
-    uint16_t curr_time_stamp_cnt = HAL_FDCAN_GetTimestampCounter(&hfdcan1);
-    uint32_t cycle_time_ns;
-    if (last_time_stamp_cnt <= curr_time_stamp_cnt)
-        cycle_time_ns = ((uint32_t)curr_time_stamp_cnt - last_time_stamp_cnt) * 1000;
-    else
-        cycle_time_ns = ((uint32_t)UINT16_MAX - last_time_stamp_cnt + 1 + curr_time_stamp_cnt) * 1000;
-
-    if (can_cycle_max_time_ns < cycle_time_ns)
-        can_cycle_max_time_ns = cycle_time_ns;
-        
-    can_cycle_ave_time_ns = ((uint32_t)can_cycle_ave_time_ns * 15 + cycle_time_ns) >> 4;
-    
-    last_time_stamp_cnt = curr_time_stamp_cnt;
+// Error warning, error passive or bus off status changed
+void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t ErrorStatusITs)
+{
+    if (ErrorStatusITs & FDCAN_FLAG_ERROR_WARNING)
+        slcan_raise_error(SLCAN_STS_ERROR_WARNING);
+    if (ErrorStatusITs & FDCAN_FLAG_ERROR_PASSIVE)
+        slcan_raise_error(SLCAN_STS_ERROR_PASSIVE);
+    // No status flag for bus off
 
-    // Green LED on during bus closed
-    if (can_bus_state == BUS_CLOSED)
-        led_turn_txd(LED_ON);
+    can_update_error_state();
+}
 
+// Protocol error detected, the error counters have changed
+void HAL_FDCAN_ErrorCallback(FDCAN_HandleTypeDef *hfdcan)
+{
+    if (hfdcan->ErrorCode & HAL_FDCAN_ERROR_PROTOCOL_ARBT)
+        can_protocol_err_cnt_nominal++;
+    if (hfdcan->ErrorCode & HAL_FDCAN_ERROR_PROTOCOL_DATA)
+        can_protocol_err_cnt_data++;
+    if (hfdcan->ErrorCode & (HAL_FDCAN_ERROR_PROTOCOL_ARBT | HAL_FDCAN_ERROR_PROTOCOL_DATA))
+        can_update_error_state();
+
+    // Failures of the API calls are handled by their return values, don't call this again for them
+    hfdcan->ErrorCode = HAL_FDCAN_ERROR_NONE;
 }
 
 // Set the nominal bitrate of the CAN peripheral
 HAL_StatusTypeDef can_set_nominal_bitrate(enum can_bitrate_nominal bitrate)
 {
-    if (can_bus_state == BUS_OPENED)
+    if (can_bus_state != BUS_CLOSED)
     {
         // cannot set bitrate while on bus
         return HAL_ERROR;
     }
 
-    // Set default bitrate 125k
-    can_bit_cfg_nominal.prescaler = 4;
-    can_bit_cfg_nominal.sjw = 13;
-    can_bit_cfg_nominal.time_seg1 = 105;
-    can_bit_cfg_nominal.time_seg2 = 14;
-
-    switch (bitrate)
-    {
-    case CAN_BITRATE_10K:
-        can_bit_cfg_nominal.prescaler = 50;
-        break;
-    case CAN_BITRATE_20K:
-        can_bit_cfg_nominal.prescaler = 25;
-        break;
-    case CAN_BITRATE_50K:
-        can_bit_cfg_nominal.prescaler = 10;
-        break;
-    case CAN_BITRATE_100K:
-        can_bit_cfg_nominal.prescaler = 5;
-        break;
-    case CAN_BITRATE_125K:
-        break;
-    case CAN_BITRATE_250K:
-        can_bit_cfg_nominal.prescaler = 2;
-        break;
-    case CAN_BITRATE_500K:
-        can_bit_cfg_nominal.prescaler = 1;
-        break;
-    case CAN_BITRATE_800K:
-        can_bit_cfg_nominal.prescaler = 1;
-        can_bit_cfg_nominal.sjw = 8;
-        can_bit_cfg_nominal.time_seg1 = 65;
-        can_bit_cfg_nominal.time_seg2 = 9;
-        break;
-    case CAN_BITRATE_1000K:
-        can_bit_cfg_nominal.prescaler = 1;
-        can_bit_cfg_nominal.sjw = 6;
-        can_bit_cfg_nominal.time_seg1 = 52;
-        can_bit_cfg_nominal.time_seg2 = 7;
-        break;
-    default:
-        return HAL_ERROR;
-    }
+    if (CAN_BITRATE_INVALID <= (uint32_t)bitrate) return HAL_ERROR;
+    can_bit_cfg_nominal = bittime_nominal_cfg[bitrate];
 
     return HAL_OK;
 }
@@ -414,46 +609,25 @@ HAL_StatusTypeDef can_set_nominal_bitrate(enum can_bitrate_nominal bitrate)
 // Set the data bitrate of the CAN peripheral
 HAL_StatusTypeDef can_set_data_bitrate(enum can_bitrate_data bitrate)
 {
-    if (can_bus_state == BUS_OPENED)
+    if (can_bus_state != BUS_CLOSED)
     {
         // cannot set bitrate while on bus
         return HAL_ERROR;
     }
 
-    // Set default bitrate 2M
-    can_bit_cfg_data.prescaler = 2;
-    can_bit_cfg_data.sjw = 3;
-    can_bit_cfg_data.time_seg1 = 10;
-    can_bit_cfg_data.time_seg2 = 4;
-
-    switch (bitrate)
-    {
-    case CAN_DATA_BITRATE_500K:
-        can_bit_cfg_data.prescaler = 8;
-        break;
-    case CAN_DATA_BITRATE_1M:
-        can_bit_cfg_data.prescaler = 4;
-        break;
-    case CAN_DATA_BITRATE_2M:
-        break;
-    case CAN_DATA_BITRATE_3M:
-        can_bit_cfg_data.prescaler = 1;
-        can_bit_cfg_data.sjw = 4;
-        can_bit_cfg_data.time_seg1 = 14;
-        can_bit_cfg_data.time_seg2 = 5;
-        break;
-    case CAN_DATA_BITRATE_4M:
-        can_bit_cfg_data.prescaler = 1;
-        break;
-    case CAN_DATA_BITRATE_5M:
-        can_bit_cfg_data.prescaler = 1;
-        can_bit_cfg_data.sjw = 2;
-        can_bit_cfg_data.time_seg1 = 8;
-        can_bit_cfg_data.time_seg2 = 3;
-        break;
-    default:
-        return HAL_ERROR;
-    }
+    if (CAN_DATA_BITRATE_INVALID <= (uint32_t)bitrate) return HAL_ERROR;
+    can_bit_cfg_data = bittime_data_cfg[bitrate];
+
+    return HAL_OK;
+}
+
+// Check the nominal bitrate configuration fits in the registers of the CAN peripheral
+HAL_StatusTypeDef can_check_nominal_bitrate_cfg(struct can_bitrate_cfg bitrate_cfg)
+{
+    if (!IS_FDCAN_NOMINAL_PRESCALER(bitrate_cfg.prescaler)) return HAL_ERROR;
+    if (!IS_FDCAN_NOMINAL_TSEG1(bitrate_cfg.time_seg1)) return HAL_ERROR;
+    if (!IS_FDCAN_NOMINAL_TSEG2(bitrate_cfg.time_seg2)) return HAL_ERROR;
+    if (!IS_FDCAN_NOMINAL_SJW(bitrate_cfg.sjw)) return HAL_ERROR;
 
     return HAL_OK;
 }
@@ -461,41 +635,91 @@ HAL_StatusTypeDef can_set_data_bitrate(enum can_bitrate_data bitrate)
 // Set the nominal bitrate configuration of the CAN peripheral
 HAL_StatusTypeDef can_set_nominal_bitrate_cfg(struct can_bitrate_cfg bitrate_cfg)
 {
-    if (can_bus_state == BUS_OPENED)
+    if (can_bus_state != BUS_CLOSED)
     {
         // cannot set bitrate while on bus
         return HAL_ERROR;
     }
 
-    if (!IS_FDCAN_NOMINAL_PRESCALER(bitrate_cfg.prescaler)) return HAL_ERROR;
-    if (!IS_FDCAN_NOMINAL_TSEG1(bitrate_cfg.time_seg1)) return HAL_ERROR;
-    if (!IS_FDCAN_NOMINAL_TSEG2(bitrate_cfg.time_seg2)) return HAL_ERROR;
-    if (!IS_FDCAN_NOMINAL_SJW(bitrate_cfg.sjw)) return HAL_ERROR;
+    if (can_check_nominal_bitrate_cfg(bitrate_cfg) != HAL_OK) return HAL_ERROR;
 
     can_bit_cfg_nominal = bitrate_cfg;
 
     return HAL_OK;
 }
 
+// Check the data bitrate configuration fits in the registers of the CAN peripheral
+HAL_StatusTypeDef can_check_data_bitrate_cfg(struct can_bitrate_cfg bitrate_cfg)
+{
+    if (!IS_FDCAN_DATA_PRESCALER(bitrate_cfg.prescaler)) return HAL_ERROR;
+    if (!IS_FDCAN_DATA_TSEG1(bitrate_cfg.time_seg1)) return HAL_ERROR;
+    if (!IS_FDCAN_DATA_TSEG2(bitrate_cfg.time_seg2)) return HAL_ERROR;
+    if (!IS_FDCAN_DATA_SJW(bitrate_cfg.sjw)) return HAL_ERROR;
+
+    return HAL_OK;
+}
+
 // Set the data bitrate configuration of the CAN peripheral
 HAL_StatusTypeDef can_set_data_bitrate_cfg(struct can_bitrate_cfg bitrate_cfg)
 {
-    if (can_bus_state == BUS_OPENED)
+    if (can_bus_state != BUS_CLOSED)
     {
         // cannot set bitrate while on bus
         return HAL_ERROR;
     }
 
-    if (!IS_FDCAN_DATA_PRESCALER(bitrate_cfg.prescaler)) return HAL_ERROR;
-    if (!IS_FDCAN_DATA_TSEG1(bitrate_cfg.time_seg1)) return HAL_ERROR;
-    if (!IS_FDCAN_DATA_TSEG2(bitrate_cfg.time_seg2)) return HAL_ERROR;
-    if (!IS_FDCAN_DATA_SJW(bitrate_cfg.sjw)) return HAL_ERROR;
+    if (can_check_data_bitrate_cfg(bitrate_cfg) != HAL_OK) return HAL_ERROR;
 
     can_bit_cfg_data = bitrate_cfg;
 
     return HAL_OK;
 }
 
+// Set the nominal bitrate from a target bitrate, sample point (permille) and SJW (0: same as time segment 2)
+HAL_StatusTypeDef can_set_nominal_bitrate_target(uint32_t bitrate, uint16_t sample_point, uint8_t sjw)
+{
+    struct can_bitrate_cfg bitrate_cfg;
+
+    if (bittime_solve(bitrate, sample_point, sjw, &bittime_limit_nominal, &bitrate_cfg) != HAL_OK) return HAL_ERROR;
+
+    return can_set_nominal_bitrate_cfg(bitrate_cfg);
+}
+
+// Set the data bitrate from a target bitrate, sample point (permille) and SJW (0: same as time segment 2)
+HAL_StatusTypeDef can_set_data_bitrate_target(uint32_t bitrate, uint16_t sample_point, uint8_t sjw)
+{
+    struct can_bitrate_cfg bitrate_cfg;
+
+    if (bittime_solve(bitrate, sample_point, sjw, &bittime_limit_data, &bitrate_cfg) != HAL_OK) return HAL_ERROR;
+
+    return can_set_data_bitrate_cfg(bitrate_cfg);
+}
+
+// Start detecting the bitrate of the bus by listening in bus monitoring mode (never transmits, no ACK)
+// Returns at once, the main loop tries the candidates and calls done within
+// (CAN_BITRATE_INVALID + CAN_DATA_BITRATE_INVALID) x CAN_DETECT_DWELL_MS.
+// On success, the detected bitrates are applied and the data bitrate is CAN_DATA_BITRATE_INVALID
+// if no bitrate switching frame was seen. On failure or C, the previous settings are restored.
+HAL_StatusTypeDef can_detect_bitrate(can_detect_done_t done)
+{
+    if (can_bus_state != BUS_CLOSED || done == NULL) return HAL_ERROR;
+
+    can_detect.prev_cfg_nominal = can_bit_cfg_nominal;
+    can_detect.prev_cfg_data = can_bit_cfg_data;
+    can_detect.prev_mode = can_mode;
+    can_detect.done = done;
+    can_detect.phase = CAN_DETECT_NOMINAL;
+    can_detect.index = 0;
+    can_detect.nominal = CAN_BITRATE_INVALID;
+    can_detect.has_data_phase = 0;
+
+    can_mode = FDCAN_MODE_BUS_MONITORING;
+    can_bus_state = BUS_DETECTING;
+    can_detect_listen();
+
+    return HAL_OK;
+}
+
 // Get the data bitrate configuration of the CAN peripheral
 struct can_bitrate_cfg can_get_data_bitrate_cfg(void)
 {
@@ -513,7 +737,6 @@ HAL_StatusTypeDef can_set_filter_std(FunctionalState state, uint32_t code, uint3
 {
     HAL_StatusTypeDef ret = HAL_OK;
     
-    if (can_bus_state == BUS_OPENED) return HAL_ERROR;
     if (state == ENABLE)
         can_std_filter.FilterConfig = FDCAN_FILTER_TO_RXFIFO0;
     else if (state == DISABLE)
@@ -530,6 +753,10 @@ HAL_StatusTypeDef can_set_filter_std(FunctionalState state, uint32_t code, uint3
         ret = HAL_ERROR;
     else
         can_std_filter.FilterID2 = mask;
+
+    // Apply to the running controller unless the ID set filter is in use
+    if (ret == HAL_OK && can_bus_state == BUS_OPENED && idset_is_enabled() == DISABLE)
+        ret = can_update_filter(&can_std_filter);
     
     return ret;
 }
@@ -539,7 +766,6 @@ HAL_StatusTypeDef can_set_filter_ext(FunctionalState state, uint32_t code, uint3
 {
     HAL_StatusTypeDef ret = HAL_OK;
     
-    if (can_bus_state == BUS_OPENED) return HAL_ERROR;
     if (state == ENABLE)
         can_ext_filter.FilterConfig = FDCAN_FILTER_TO_RXFIFO0;
     else if (state == DISABLE)
@@ -556,10 +782,23 @@ HAL_StatusTypeDef can_set_filter_ext(FunctionalState state, uint32_t code, uint3
         ret = HAL_ERROR;
     else
         can_ext_filter.FilterID2 = mask;
+
+    // Apply to the running controller unless the ID set filter is in use
+    if (ret == HAL_OK && can_bus_state == BUS_OPENED && idset_is_enabled() == DISABLE)
+        ret = can_update_filter(&can_ext_filter);
     
     return ret;
 }
 
+// Apply a changed filter mode or ID set to the running controller
+HAL_StatusTypeDef can_reload_filter(void)
+{
+    if (can_bus_state != BUS_OPENED) return HAL_OK;
+
+    if (idset_is_enabled() == ENABLE) idset_compile();
+    return can_load_filter();
+}
+
 // Get filter state for standard CAN ID
 FunctionalState can_is_filter_std_enabled(void)
 {
@@ -609,7 +848,7 @@ uint32_t can_get_filter_ext_mask(void)
 // external: FDCAN_MODE_EXTERNAL_LOOPBACK
 HAL_StatusTypeDef can_set_mode(uint32_t mode)
 {
-    if (can_bus_state == BUS_OPENED)
+    if (can_bus_state != BUS_CLOSED)
     {
         // cannot set silent mode while on bus
         return HAL_ERROR;
@@ -622,7 +861,7 @@ HAL_StatusTypeDef can_set_mode(uint32_t mode)
 // Set auto retransmit function
 HAL_StatusTypeDef can_set_auto_retransmit(FunctionalState state)
 {
-    if (can_bus_state == BUS_OPENED)
+    if (can_bus_state != BUS_CLOSED)
     {
         // cannot set state while on bus
         return HAL_ERROR;
@@ -640,7 +879,15 @@ enum can_bus_state can_get_bus_state(void)
 
 struct can_error_state can_get_error_state(void)
 {
-    return can_error_state;
+    struct can_error_state err;
+
+    // Read the registers on demand, the interrupts follow only the changes of the state
+    __disable_irq();
+    if (can_bus_state == BUS_OPENED) can_update_error_state();
+    err = can_error_state;
+    __enable_irq();
+
+    return err;
 }
 
 FunctionalState can_is_tx_enabled(void)
@@ -661,23 +908,169 @@ uint32_t can_get_bus_load_ppm(void)
     return can_bus_load_ppm;
 }
 
-// Clear the maximum and average cycle time
-void can_clear_cycle_time(void)
+// Clear the maximum latency from frame reception to report
+void can_clear_rx_latency(void)
+{
+    can_rx_latency_max_us = 0;
+    can_rx_cycle_sum = 0;
+    can_rx_cycle_cnt = 0;
+}
+
+// Return the maximum latency from frame reception to report in micro seconds
+uint32_t can_get_rx_latency_max_us(void)
 {
-    can_cycle_max_time_ns = 0;
-    can_cycle_ave_time_ns = 0;
+    return can_rx_latency_max_us;
 }
 
-// Return the maximum cycle time in nano seconds
-uint32_t can_get_cycle_max_time_ns(void)
+// Return the number of protocol errors in both phases since power on
+uint32_t can_get_protocol_err_cnt(void)
 {
-    return can_cycle_max_time_ns;
+    return can_protocol_err_cnt_nominal + can_protocol_err_cnt_data;
 }
 
-// Return the average cycle time in nano seconds
-uint32_t can_get_cycle_ave_time_ns(void)
+// Return the average CPU cycles to handle an accepted frame since the last clear
+uint32_t can_get_rx_cycle_ave(void)
 {
-    return can_cycle_ave_time_ns;
+    return (can_rx_cycle_cnt == 0) ? 0 : can_rx_cycle_sum / can_rx_cycle_cnt;
+}
+
+// Clear the latency histograms
+void can_clear_latency_hist(void)
+{
+    hist_clear(&can_tx_latency_hist);
+    hist_clear(&can_rx_latency_hist);
+}
+
+// Clear the transmission attempt counters
+void can_clear_tx_attempt_stat(void)
+{
+    can_tx_attempt_stat = (struct can_tx_attempt_stat){0};
+}
+
+// Return the transmission attempt counters
+struct can_tx_attempt_stat can_get_tx_attempt_stat(void)
+{
+    return can_tx_attempt_stat;
+}
+
+// Record a frame put to the tx FIFO, the marker identifies it in the tx event
+__RAM_FUNC void can_mark_tx_submit(uint32_t marker)
+{
+    uint32_t idx = __builtin_ctz(HAL_FDCAN_GetLatestTxFifoQRequestBuffer(&hfdcan1));
+    struct can_tx_slot *slot = &can_tx_attempt.slot[idx % CAN_TX_FIFO_SIZE];
+
+    slot->used = 1;
+    slot->marker = (uint8_t)marker;
+    slot->cancel = CAN_TX_CANCEL_NONE;
+    slot->submit_us = (uint16_t)TIM3->CNT;
+    slot->order = can_tx_attempt.order++;
+
+    // Contends from now if no frame is waiting
+    if (can_tx_attempt.contender < 0)
+        can_select_tx_contender(slot->submit_us);
+}
+
+// Set the retries (0 for no limit) and the time in the device (0 for no limit) before a frame is cancelled
+HAL_StatusTypeDef can_set_tx_limit(uint8_t retry_limit, uint16_t expiry_ms)
+{
+    if (can_bus_state != BUS_CLOSED)
+    {
+        // cannot set limit while on bus
+        return HAL_ERROR;
+    }
+    can_tx_retry_limit = retry_limit;
+    can_tx_expiry_ms = expiry_ms;
+
+    return HAL_OK;
+}
+
+// Return the retry limit of a frame, 0 for no limit
+uint8_t can_get_tx_retry_limit(void)
+{
+    return can_tx_retry_limit;
+}
+
+// Return the expiry time of a frame in ms, 0 for no limit
+uint16_t can_get_tx_expiry_ms(void)
+{
+    return can_tx_expiry_ms;
+}
+
+// Check if a frame queued at the time has been in the device longer than the expiry time
+__RAM_FUNC FunctionalState can_is_tx_expired(uint32_t stamp_us)
+{
+    if (can_tx_expiry_ms == 0) return DISABLE;
+    if ((uint32_t)(can_get_uptime_us() - stamp_us) < (uint32_t)can_tx_expiry_ms * 1000) return DISABLE;
+    return ENABLE;
+}
+
+// Report a frame removed without transmission
+void can_report_tx_cancel(FDCAN_TxHeaderTypeDef *header, enum can_tx_cancel reason)
+{
+    int32_t len = slcan_generate_tx_cancel(buf_get_cdc_dest(), header, reason);
+    buf_comit_cdc_dest(len);
+
+    if (reason == CAN_TX_CANCEL_RETRY)
+        can_tx_attempt_stat.cancel_retry++;
+    else
+        can_tx_attempt_stat.cancel_expiry++;
+}
+
+// Set the bus off recovery, automatic after the delay up to the number of times after open (0 for no limit) or by the host
+HAL_StatusTypeDef can_set_recovery(FunctionalState auto_recover, uint16_t delay_ms, uint8_t max_num)
+{
+    if (auto_recover != ENABLE && auto_recover != DISABLE) return HAL_ERROR;
+
+    can_recovery_cfg.auto_recover = auto_recover;
+    can_recovery_cfg.delay_ms = delay_ms;
+    can_recovery_cfg.max_num = max_num;
+
+    return HAL_OK;
+}
+
+// Start the recovery from bus off now, for the host
+HAL_StatusTypeDef can_recover_bus_off(void)
+{
+    if (can_bus_state != BUS_OPENED || can_error_state.bus_off == 0 || can_recovery_started)
+        return HAL_ERROR;
+
+    can_start_recovery();
+
+    return HAL_OK;
+}
+
+// Return the bus off counters
+struct can_bus_off_stat can_get_bus_off_stat(void)
+{
+    __disable_irq();
+    struct can_bus_off_stat stat = can_bus_off_stat;
+    __enable_irq();
+
+    return stat;
+}
+
+// Return the histogram of the time from queueing a frame to its transmission in micro seconds
+struct hist *can_get_tx_latency_hist(void)
+{
+    return &can_tx_latency_hist;
+}
+
+// Return the histogram of the time from frame reception to handing its report to USB in micro seconds
+struct hist *can_get_rx_latency_hist(void)
+{
+    return &can_rx_latency_hist;
+}
+
+// Return time since the last frame on the bus in ms
+uint32_t can_get_idle_time_ms(void)
+{
+    return (uint32_t)(HAL_GetTick() - can_last_frame_tick);
+}
+
+// Return time from boot to the first bus open in us (CAN_BOOT_TO_OPEN_NONE if not opened yet)
+uint32_t can_get_boot_to_open_time_us(void)
+{
+    return can_boot_to_open_time_us;
 }
 
 // Return reference to CAN handle
@@ -686,6 +1079,413 @@ FDCAN_HandleTypeDef *can_get_handle(void)
     return &hfdcan1;
 }
 
+// Start the controller with the timing of the current candidate and clear its counters
+static void can_detect_listen(void)
+{
+    if (can_detect.phase == CAN_DETECT_NOMINAL)
+        can_bit_cfg_nominal = bittime_nominal_cfg[can_detect.index];
+    else
+        can_bit_cfg_data = bittime_data_cfg[can_detect.index];
+
+    can_detect.count = (struct can_detect_count){0};
+    can_detect.nominal_err_cnt_start = can_protocol_err_cnt_nominal;
+    can_detect.data_err_cnt_start = can_protocol_err_cnt_data;
+    can_detect.start_tick = HAL_GetTick();
+
+    // Not an open by the host, so the boot to open time is not recorded
+    // All frames are counted regardless of the acceptance filter
+    can_detect.start_err = (can_start_controller(FDCAN_ACCEPT_IN_RX_FIFO1) != HAL_OK) ? 1 : 0;
+}
+
+// Count the frames received with the current candidate, they are not reported
+static void can_detect_drain(void)
+{
+    FDCAN_RxHeaderTypeDef rx_msg_header;
+    uint8_t rx_msg_data[CAN_MAX_DATALEN];
+
+    while (HAL_FDCAN_GetRxMessage(&hfdcan1, FDCAN_RX_FIFO0, &rx_msg_header, rx_msg_data) == HAL_OK ||
+           HAL_FDCAN_GetRxMessage(&hfdcan1, FDCAN_RX_FIFO1, &rx_msg_header, rx_msg_data) == HAL_OK)
+    {
+        can_detect.count.frames++;
+        if (rx_msg_header.BitRateSwitch == FDCAN_BRS_ON) can_detect.count.brs_frames++;
+    }
+}
+
+// Judge the current candidate once it has been listened to long enough, then go on to the next one
+static void can_process_detect(void)
+{
+    struct can_detect_count *count = &can_detect.count;
+
+    // Protocol errors are counted in interrupt
+    can_detect_drain();
+    count->nominal_errors = can_protocol_err_cnt_nominal - can_detect.nominal_err_cnt_start + can_detect.start_err;
+    count->data_errors = can_protocol_err_cnt_data - can_detect.data_err_cnt_start;
+
+    // Arbitration phase listens for the full time to catch bitrate switching frames
+    if (HAL_GetTick() - can_detect.start_tick < CAN_DETECT_DWELL_MS && count->nominal_errors == 0)
+    {
+        if (can_detect.phase == CAN_DETECT_NOMINAL) return;
+        if (count->data_errors == 0 && count->brs_frames < CAN_DETECT_MIN_FRAMES) return;
+    }
+
+    can_stop_controller();
+
+    if (can_detect.phase == CAN_DETECT_NOMINAL)
+    {
+        // A frame reaching the data phase also proves the nominal timing
+        if (count->nominal_errors == 0 && count->frames + count->data_errors > 0)
+        {
+            can_detect.nominal = can_detect.index;
+            can_detect.has_data_phase = (count->brs_frames + count->data_errors > 0);
+
+            // Data phase: only meaningful if bitrate switching traffic was seen
+            if (!can_detect.has_data_phase)
+            {
+                can_detect_finish(HAL_OK);
+                return;
+            }
+            can_detect.phase = CAN_DETECT_DATA;
+            can_detect.index = 0;
+        }
+        else if (CAN_BITRATE_INVALID <= ++can_detect.index)
+        {
+            can_detect_finish(HAL_ERROR);
+            return;
+        }
+    }
+    else
+    {
+        if ((count->nominal_errors == 0 && count->data_errors == 0 && count->brs_frames > 0) ||
+            CAN_DATA_BITRATE_INVALID <= ++can_detect.index)
+        {
+            can_detect_finish(HAL_OK);
+            return;
+        }
+    }
+
+    can_detect_listen();
+}
+
+// End the bitrate detection with the controller stopped and report the result
+static void can_detect_finish(HAL_StatusTypeDef status)
+{
+    enum can_bitrate_nominal nominal = CAN_BITRATE_INVALID;
+    enum can_bitrate_data data = CAN_DATA_BITRATE_INVALID;
+
+    can_mode = can_detect.prev_mode;
+
+    if (status == HAL_OK)
+    {
+        nominal = can_detect.nominal;
+        if (can_detect.phase == CAN_DETECT_DATA && can_detect.index < CAN_DATA_BITRATE_INVALID)
+            data = can_detect.index;
+        else
+            can_bit_cfg_data = can_detect.prev_cfg_data;
+    }
+    else
+    {
+        can_bit_cfg_nominal = can_detect.prev_cfg_nominal;
+        can_bit_cfg_data = can_detect.prev_cfg_data;
+    }
+
+    can_bus_state = BUS_CLOSED;
+    can_detect.done(status, nominal, data);
+}
+
+// Read the bus state and error counters, raise the flag if they increased (call in interrupt or with it disabled)
+static void can_update_error_state(void)
+{
+    FDCAN_ProtocolStatusTypeDef sts;
+    FDCAN_ErrorCountersTypeDef cnt;
+
+    HAL_FDCAN_GetProtocolStatus(&hfdcan1, &sts);
+    HAL_FDCAN_GetErrorCounters(&hfdcan1, &cnt);
+
+    uint8_t rx_err_cnt = (uint8_t)(cnt.RxErrorPassive ? 128 : cnt.RxErrorCnt);
+    if (rx_err_cnt > can_error_state.rec || cnt.TxErrorCnt > can_error_state.tec)
+        slcan_raise_error(SLCAN_STS_BUS_ERROR);
+    // A transmit error adds 8 to the counter and a success subtracts 1
+    if (cnt.TxErrorCnt > can_error_state.tec)
+        can_tx_err_cnt += (cnt.TxErrorCnt - can_error_state.tec + 7) / 8;
+    if (sts.BusOff && !can_error_state.bus_off)
+    {
+        slcan_raise_error(SLCAN_STS_BUS_ERROR);  // Capture counter increase that caused bus off
+        can_bus_off_tick = HAL_GetTick();
+        can_bus_off_stat.bus_off_cnt++;
+        can_recovery_started = 0;
+    }
+    if (!sts.BusOff && can_error_state.bus_off)
+    {
+        uint32_t bus_off_ms = HAL_GetTick() - can_bus_off_tick;
+        can_bus_off_stat.last_ms = bus_off_ms;
+        if (can_bus_off_stat.max_ms < bus_off_ms) can_bus_off_stat.max_ms = bus_off_ms;
+        can_bus_off_stat.total_ms += bus_off_ms;
+        can_recovery_started = 0;
+    }
+
+    can_error_state.bus_off = (uint8_t)sts.BusOff;
+    can_error_state.err_pssv = (uint8_t)sts.ErrorPassive;
+    can_error_state.tec = (uint8_t)cnt.TxErrorCnt;
+    can_error_state.rec = (uint8_t)rx_err_cnt;
+    if (sts.DataLastErrorCode != FDCAN_PROTOCOL_ERROR_NONE && sts.DataLastErrorCode != FDCAN_PROTOCOL_ERROR_NO_CHANGE)
+        can_error_state.last_err_code = sts.DataLastErrorCode;
+    if (sts.LastErrorCode != FDCAN_PROTOCOL_ERROR_NONE && sts.LastErrorCode != FDCAN_PROTOCOL_ERROR_NO_CHANGE)
+        can_error_state.last_err_code = sts.LastErrorCode;
+}
+
+// Read the error counters again on frame events while they are not zero, at most every CAN_ERROR_FOLLOW_MS
+static void can_follow_error_count(void)
+{
+    if (can_error_state.tec == 0 && can_error_state.rec == 0) return;
+    if ((uint32_t)(HAL_GetTick() - can_error_follow_tick) < CAN_ERROR_FOLLOW_MS) return;
+    can_error_follow_tick = HAL_GetTick();
+
+    __disable_irq();
+    can_update_error_state();
+    __enable_irq();
+}
+
+// Select the transmitter delay compensation offset for the data phase (0: not used)
+static uint32_t can_get_tdc_offset(void)
+{
+    uint32_t tq_nbr = 1 + can_bit_cfg_data.time_seg1 + can_bit_cfg_data.time_seg2;
+    uint32_t offset = can_bit_cfg_data.prescaler * can_bit_cfg_data.time_seg1;
+
+    if (BITTIME_CLOCK_HZ / (can_bit_cfg_data.prescaler * tq_nbr) <= CAN_TDC_MIN_BITRATE) return 0;
+    if (CAN_TDC_MAX_PRESCALER < can_bit_cfg_data.prescaler) return 0;
+    if (CAN_TDC_MAX_OFFSET < offset) return 0;
+
+    return offset;
+}
+
+// Return time since HAL initialization in us, interpolated with the SysTick counter
+__RAM_FUNC uint32_t can_get_uptime_us(void)
+{
+    uint32_t tick, val;
+
+    // Retry if the tick was incremented while reading the counter
+    do
+    {
+        tick = HAL_GetTick();
+        val = SysTick->VAL;
+    } while (tick != HAL_GetTick());
+
+    return tick * 1000 + ((SysTick->LOAD - val) * 1000) / (SysTick->LOAD + 1);
+}
+
+// Sum the cycles to handle an accepted frame, so that the average covers every frame of a measurement
+__RAM_FUNC static void can_update_rx_cycle(uint32_t cycle)
+{
+    if (CAN_RX_CYCLE_CNT_MAX <= can_rx_cycle_cnt) return;
+
+    can_rx_cycle_sum += cycle;
+    can_rx_cycle_cnt++;
+}
+
+// Track the maximum time from frame reception to report (us timer, 16bit)
+__RAM_FUNC static void can_update_rx_latency(uint16_t rx_timestamp)
+{
+    uint32_t latency_us = (uint16_t)((uint16_t)TIM3->CNT - rx_timestamp);
+    if (can_rx_latency_max_us < latency_us)
+        can_rx_latency_max_us = latency_us;
+}
+
+// Count a frame on the bus for the bus load
+__RAM_FUNC static void can_count_frame(uint16_t timestamp, uint16_t bits)
+{
+    can_bit_cnt_message += bits;
+    can_last_frame_time_cnt = timestamp;
+    load_count_frame(timestamp, bits, can_bit_time_ns);
+}
+
+// Count the time from queueing a frame to the start of its transmission (us timer, 16bit)
+__RAM_FUNC static uint32_t can_update_tx_latency(FDCAN_TxEventFifoTypeDef *tx_event)
+{
+    uint32_t since_tx_us = (uint16_t)((uint16_t)TIM3->CNT - tx_event->TxTimestamp);
+    uint32_t since_queue_us = can_get_uptime_us() - buf_get_can_tx_stamp_us(tx_event->MessageMarker);
+
+    // The two clocks are not in phase, a frame sent at once may look sent before queued
+    uint32_t latency_us = (since_tx_us < since_queue_us) ? since_queue_us - since_tx_us : 0;
+    hist_add(&can_tx_latency_hist, latency_us);
+
+    return latency_us;
+}
+
+// A frame starting on the bus while ours is waiting has won the arbitration (us timer, 16bit)
+__RAM_FUNC static void can_count_arbitration_lost(uint16_t rx_timestamp)
+{
+    if (can_tx_attempt.contender < 0) return;
+
+    // A frame already on the bus when ours was submitted is not an arbitration
+    if (0 < (int16_t)(rx_timestamp - can_tx_attempt.contend_us))
+        can_tx_attempt.arb_lost++;
+}
+
+// The oldest frame in the tx FIFO contends from its submission or the given time, whichever is later
+__RAM_FUNC static void can_select_tx_contender(uint16_t from_us)
+{
+    can_tx_attempt.contender = -1;
+    for (int8_t i = 0; i < CAN_TX_FIFO_SIZE; i++)
+    {
+        if (can_tx_attempt.slot[i].used == 0) continue;
+        if (can_tx_attempt.contender < 0 ||
+            (int32_t)(can_tx_attempt.slot[i].order - can_tx_attempt.slot[can_tx_attempt.contender].order) < 0)
+            can_tx_attempt.contender = i;
+    }
+    if (can_tx_attempt.contender < 0) return;
+
+    uint16_t submit_us = can_tx_attempt.slot[can_tx_attempt.contender].submit_us;
+    can_tx_attempt.contend_us = (0 < (int16_t)(submit_us - from_us)) ? submit_us : from_us;
+    can_tx_attempt.arb_lost = 0;
+    can_tx_attempt.err_cnt_start = can_tx_err_cnt;
+}
+
+// Count the attempts of a transmitted frame and move on to the next one in the tx FIFO
+__RAM_FUNC static uint32_t can_update_tx_attempt(FDCAN_TxEventFifoTypeDef *tx_event)
+{
+    int8_t sent = -1;
+    for (int8_t i = 0; i < CAN_TX_FIFO_SIZE; i++)
+        if (can_tx_attempt.slot[i].used && can_tx_attempt.slot[i].marker == (uint8_t)tx_event->MessageMarker)
+            sent = i;
+    if (sent < 0) return 1;
+
+    // Frames older than this one were sent too, their tx events were lost in the full tx event FIFO
+    for (int8_t i = 0; i < CAN_TX_FIFO_SIZE; i++)
+        if (can_tx_attempt.slot[i].used && (int32_t)(can_tx_attempt.slot[i].order - can_tx_attempt.slot[sent].order) < 0)
+            can_tx_attempt.slot[i].used = 0;
+
+    uint32_t attempts = 1;
+    if (can_tx_attempt.tracked == ENABLE && sent == can_tx_attempt.contender)
+    {
+        // The tx event is handled first, so the winners before it may still wait in the rx FIFOs
+        uint32_t arb_lost = can_tx_attempt.arb_lost;
+        arb_lost += msgram_count_rx_between(FDCAN_RX_FIFO0, can_tx_attempt.contend_us, tx_event->TxTimestamp);
+        arb_lost += msgram_count_rx_between(FDCAN_RX_FIFO1, can_tx_attempt.contend_us, tx_event->TxTimestamp);
+        uint32_t err_retry = can_tx_err_cnt - can_tx_attempt.err_cnt_start;
+        attempts = 1 + arb_lost + err_retry;
+
+        can_tx_attempt_stat.frames++;
+        can_tx_attempt_stat.arb_lost += arb_lost;
+        can_tx_attempt_stat.err_retry += err_retry;
+        if (can_tx_attempt_stat.attempts_max < attempts) can_tx_attempt_stat.attempts_max = attempts;
+        if (0 < arb_lost) slcan_raise_error(SLCAN_STS_ARBITRATION_LOST);
+    }
+
+    // The next frame contends from its submission or from this frame, whichever is later
+    can_tx_attempt.slot[sent].used = 0;
+    can_select_tx_contender(tx_event->TxTimestamp);
+
+    return attempts;
+}
+
+// Rewrite a filter element in the message RAM, also while the controller is running
+// The element is disabled first so that no frame is matched against a half written extended element,
+// a frame completed in the meantime is handled as not accepted
+static HAL_StatusTypeDef can_update_filter(const FDCAN_FilterTypeDef *filter)
+{
+    FDCAN_FilterTypeDef disabled = *filter;
+    disabled.FilterConfig = FDCAN_FILTER_DISABLE;
+
+    if (HAL_FDCAN_ConfigFilter(&hfdcan1, &disabled) != HAL_OK) return HAL_ERROR;
+    return HAL_FDCAN_ConfigFilter(&hfdcan1, filter);
+}
+
+// Write the filter elements of the selected filter mode and the remote frame reply, unused ones disabled
+static HAL_StatusTypeDef can_load_filter(void)
+{
+    FDCAN_FilterTypeDef unused;
+    FDCAN_FilterTypeDef *filter;
+
+    unused = can_std_filter;
+    unused.FilterConfig = FDCAN_FILTER_DISABLE;
+    for (uint8_t i = 0; i < IDSET_STD_FILTER_MAX; i++)
+    {
+        filter = (idset_is_enabled() == ENABLE) ? idset_get_filter(FDCAN_STANDARD_ID, i) : ((i == 0) ? &can_std_filter : NULL);
+        if (filter == NULL)
+        {
+            unused.FilterIndex = i;
+            filter = &unused;
+        }
+        if (can_update_filter(filter) != HAL_OK) return HAL_ERROR;
+    }
+
+    unused = can_ext_filter;
+    unused.FilterConfig = FDCAN_FILTER_DISABLE;
+    for (uint8_t i = 0; i < IDSET_EXT_FILTER_MAX; i++)
+    {
+        filter = (idset_is_enabled() == ENABLE) ? idset_get_filter(FDCAN_EXTENDED_ID, i) : ((i == 0) ? &can_ext_filter : NULL);
+        if (filter == NULL)
+        {
+            unused.FilterIndex = i;
+            filter = &unused;
+        }
+        if (can_update_filter(filter) != HAL_OK) return HAL_ERROR;
+    }
+
+    return HAL_FDCAN_ConfigFilter(&hfdcan1, &can_reply_filter);
+}
+
+// Start the automatic recovery once the delay has passed after bus off
+static void can_process_bus_off(void)
+{
+    if (can_error_state.bus_off == 0 || can_recovery_started) return;
+    if (can_recovery_cfg.auto_recover == DISABLE) return;
+    if (can_recovery_cfg.max_num != 0 && can_recovery_cfg.max_num <= can_recovery_num) return;
+    if ((uint32_t)(HAL_GetTick() - can_bus_off_tick) < can_recovery_cfg.delay_ms) return;
+
+    can_recovery_num++;
+    can_start_recovery();
+}
+
+// Leave the init state set by bus off, the controller joins the bus after 129 times 11 recessive bits
+// The configuration, the filters and the message RAM are kept, so the frames in the tx FIFO are sent after that
+static void can_start_recovery(void)
+{
+    __disable_irq();
+    can_recovery_started = 1;
+    can_bus_off_stat.recovery_cnt++;
+    __enable_irq();
+
+    CLEAR_BIT(hfdcan1.Instance->CCCR, FDCAN_CCCR_INIT);
+}
+
+// Cancel the frames in the tx FIFO over the retry limit or the expiry time, and report them once cancelled
+static void can_process_tx_limit(void)
+{
+    uint32_t pending = hfdcan1.Instance->TXBRP;
+    uint32_t cancelled = hfdcan1.Instance->TXBCF;
+    uint32_t sent = hfdcan1.Instance->TXBTO;
+
+    for (int8_t i = 0; i < CAN_TX_FIFO_SIZE; i++)
+    {
+        struct can_tx_slot *slot = &can_tx_attempt.slot[i];
+        if (slot->used == 0) continue;
+
+        if (slot->cancel == CAN_TX_CANCEL_NONE)
+        {
+            // Retries are known only for the frame on the bus
+            if (can_is_tx_expired(buf_get_can_tx_stamp_us(slot->marker)) == ENABLE)
+                slot->cancel = CAN_TX_CANCEL_EXPIRY;
+            else if (i == can_tx_attempt.contender && can_tx_attempt.tracked == ENABLE && can_tx_retry_limit != 0 &&
+                     can_tx_retry_limit < can_tx_attempt.arb_lost + can_tx_err_cnt - can_tx_attempt.err_cnt_start)
+                slot->cancel = CAN_TX_CANCEL_RETRY;
+
+            if (slot->cancel != CAN_TX_CANCEL_NONE)
+                HAL_FDCAN_AbortTxRequest(&hfdcan1, 1UL << i);
+        }
+        // A frame sent before the cancel is reported by its tx event
+        else if ((pending & (1UL << i)) == 0 && (cancelled & (1UL << i)) != 0 && (sent & (1UL << i)) == 0)
+        {
+            can_report_tx_cancel(buf_get_can_tx_header(slot->marker), slot->cancel);
+            buf_release_can_tx(slot->marker);
+            slot->used = 0;
+            if (i == can_tx_attempt.contender)
+                can_select_tx_contender((uint16_t)TIM3->CNT);
+            event_post(EVENT_CAN_TX);
+        }
+    }
+}
+
 // Get the nominal one bit time in nanoseconds
 void can_update_bit_time_ns(void)
 {
@@ -698,7 +1498,7 @@ void can_update_bit_time_ns(void)
 }
 
 // Return the duration of the rx frame in the nominal bit number
-uint16_t can_get_bit_number_in_rx_frame(FDCAN_RxHeaderTypeDef *pRxHeader)
+__RAM_FUNC uint16_t can_get_bit_number_in_rx_frame(FDCAN_RxHeaderTypeDef *pRxHeader)
 {
     uint16_t time_msg, time_data;
     uint8_t data_bytes = can_dlc_to_bytes[CAN_HAL_DLC_TO_STD_DLC(pRxHeader->DataLength)];
@@ -753,7 +1553,7 @@ uint16_t can_get_bit_number_in_rx_frame(FDCAN_RxHeaderTypeDef *pRxHeader)
 }
 
 // Return the duration of the tx event in the nominal bit number
-uint16_t can_get_bit_number_in_tx_event(FDCAN_TxEventFifoTypeDef *pTxEvent)
+__RAM_FUNC uint16_t can_get_bit_number_in_tx_event(FDCAN_TxEventFifoTypeDef *pTxEvent)
 {
     FDCAN_RxHeaderTypeDef frame_header;
     //frame_header.Identifier = pTxEvent->Identifier;
@@ -781,9 +1581,9 @@ static void can_reply_to_remote_frame(FDCAN_RxHeaderTypeDef *rx_frame_header, ui
     }
     else
     {
-        if (rx_frame_header->Identifier == 0x19050630)  // The can id to reply to
+        if (rx_frame_header->Identifier == CAN_REPLY_ID)  // The can id to reply to
         {
-            if (CAN_HAL_DLC_TO_STD_DLC(rx_frame_header->DataLength) == 0xE) // The dlc to reply
+            if (CAN_HAL_DLC_TO_STD_DLC(rx_frame_header->DataLength) == CAN_REPLY_DLC) // The dlc to reply
             {
                 // remote frame with specific ID and specific DLC
             }
@@ -825,7 +1625,7 @@ static void can_reply_to_remote_frame(FDCAN_RxHeaderTypeDef *rx_frame_header, ui
     tx_frame_header->BitRateSwitch = FDCAN_BRS_ON;                  // with bitrate switch
     tx_frame_header->ErrorStateIndicator = FDCAN_ESI_ACTIVE;        // error active
     tx_frame_header->TxEventFifoControl = FDCAN_STORE_TX_EVENTS;    // record tx events
-    tx_frame_header->MessageMarker = 0;                             // not used
+    tx_frame_header->MessageMarker = 0;                             // set when queued
 
     // Copy id type, can id and dlc from the remote frame
     tx_frame_header->IdType = rx_frame_header->IdType;
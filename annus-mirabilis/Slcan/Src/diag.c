@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+// Count data loss per cause and track high-water marks of the buffers
+
+#include "stm32g0xx_hal.h"
+#include "diag.h"
+
+// Private variables
+static volatile uint32_t diag_loss_cnt[DIAG_LOSS_NUM] = {0};
+static volatile uint32_t diag_peak_level[DIAG_PEAK_NUM] = {0};
+
+// Count one loss (callable from both interrupt and main loop)
+void diag_count_loss(enum diag_loss cause)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (diag_loss_cnt[cause] < UINT32_MAX) diag_loss_cnt[cause]++;
+    __set_PRIMASK(primask);
+}
+
+// Record the level of a buffer stage if it is the highest so far (callable from both interrupt and main loop)
+void diag_update_peak(enum diag_peak stage, uint32_t level)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (diag_peak_level[stage] < level) diag_peak_level[stage] = level;
+    __set_PRIMASK(primask);
+}
+
+// Return the number of losses of a cause
+uint32_t diag_get_loss(enum diag_loss cause)
+{
+    return diag_loss_cnt[cause];
+}
+
+// Return the high-water mark of a buffer stage
+uint32_t diag_get_peak(enum diag_peak stage)
+{
+    return diag_peak_level[stage];
+}
+
+// Clear all loss counters and high-water marks
+void diag_clear(void)
+{
+    __disable_irq();
+    for (uint8_t i = 0; i < DIAG_LOSS_NUM; i++) diag_loss_cnt[i] = 0;
+    for (uint8_t i = 0; i < DIAG_PEAK_NUM; i++) diag_peak_level[i] = 0;
+    __enable_irq();
+}
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+// Collects events posted by interrupts and dispatches them to the main loop in priority order
+
+#include "stm32g0xx_hal.h"
+#include "event.h"
+
+#define EVENT_BIT(id)           (1UL << (id))
+
+// Private variables
+static volatile uint32_t event_pending = 0;
+static volatile uint16_t event_post_time_cnt[EVENT_NUM];   /* TIM3 count on the first post */
+static uint32_t event_cycle_max_time_ns = 0;
+static uint32_t event_cycle_ave_time_ns = 0;
+
+// Post an event (callable from both interrupt and main loop)
+__RAM_FUNC void event_post(enum event_id id)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!(event_pending & EVENT_BIT(id)))
+    {
+        event_pending |= EVENT_BIT(id);
+        event_post_time_cnt[id] = (uint16_t)TIM3->CNT;
+    }
+    __set_PRIMASK(primask);
+}
+
+// Take the pending event with the highest priority, sleep until any event if none
+__RAM_FUNC enum event_id event_wait(void)
+{
+    enum event_id id;
+
+    __disable_irq();
+    while (event_pending == 0)
+    {
+        // Interrupt wakes up the core even if masked, then it is served after enabling
+        __WFI();
+        __enable_irq();
+        __disable_irq();
+    }
+
+    for (id = 0; id < EVENT_NUM; id++)
+    {
+        if (event_pending & EVENT_BIT(id)) break;
+    }
+    event_pending &= ~EVENT_BIT(id);
+
+    // Measure time from post to dispatch as the cycle time of the main loop (us timer, 16bit)
+    uint32_t cycle_time_ns = (uint32_t)(uint16_t)((uint16_t)TIM3->CNT - event_post_time_cnt[id]) * 1000;
+    __enable_irq();
+
+    // Tick is periodic anyway, so only measure events triggered by work
+    if (id != EVENT_TICK)
+    {
+        if (event_cycle_max_time_ns < cycle_time_ns)
+            event_cycle_max_time_ns = cycle_time_ns;
+        event_cycle_ave_time_ns = ((uint32_t)event_cycle_ave_time_ns * 15 + cycle_time_ns) >> 4;
+    }
+
+    return id;
+}
+
+// Clear cycle time statistics
+void event_clear_cycle_time(void)
+{
+    event_cycle_max_time_ns = 0;
+    event_cycle_ave_time_ns = 0;
+}
+
+// Get average time from post to dispatch of an event
+uint32_t event_get_cycle_ave_time_ns(void)
+{
+    return event_cycle_ave_time_ns;
+}
+
+// Get max time from post to dispatch of an event
+uint32_t event_get_cycle_max_time_ns(void)
+{
+    return event_cycle_max_time_ns;
+}
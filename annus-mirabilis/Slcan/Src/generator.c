@@ -31,11 +31,73 @@ uint8_t slcan_nibble_to_ascii[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8',
 enum slcan_timestamp_mode slcan_timestamp_mode = 0;
 uint16_t slcan_report_reg = 1;   // Default: no timestamp, no ESI, no Tx, but with Rx
 
+// Frame formatter bound to the report settings
+typedef int32_t (*slcan_formatter_t)(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data, uint16_t sequence);
+typedef int32_t (*slcan_rx_generator_t)(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data);
+typedef int32_t (*slcan_tx_generator_t)(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data, uint32_t latency_us, uint32_t attempts);
+
+// Private variables
+static uint16_t slcan_sequence_rx = 0;
+static uint16_t slcan_sequence_tx = 0;
+static uint32_t slcan_dropped_nbr = 0;     // Reports lost since the last drop marker
+
 // Private methods
-static int32_t slcan_generate_frame(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data);
+static inline __attribute__((always_inline)) int32_t slcan_format_frame(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data, uint16_t sequence,
+                                                                        const enum slcan_timestamp_mode timestamp, const uint8_t esi, const uint8_t seq, const uint8_t ext);
+static int32_t slcan_generate_drop_marker(uint8_t *buf);
+static int32_t slcan_generate_rx_report(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data);
+static int32_t slcan_generate_rx_none(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data);
+static inline __attribute__((always_inline)) int32_t slcan_format_tx_event(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data,
+                                                                           uint32_t latency_us, uint32_t attempts, const uint8_t latency, const uint8_t attempt);
+static int32_t slcan_generate_tx_report(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data, uint32_t latency_us, uint32_t attempts);
+static int32_t slcan_generate_tx_report_latency(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data, uint32_t latency_us, uint32_t attempts);
+static int32_t slcan_generate_tx_report_attempt(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data, uint32_t latency_us, uint32_t attempts);
+static int32_t slcan_generate_tx_report_latency_attempt(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data, uint32_t latency_us, uint32_t attempts);
+static int32_t slcan_generate_tx_none(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data, uint32_t latency_us, uint32_t attempts);
+
+// One formatter for each combination of timestamp mode, ESI report, sequence report and ID type
+// The settings are constants in each, so the compiler removes the branches on them
+#define SLCAN_FORMATTER_NAME(ts, esi, seq, ext)     slcan_format_##ts##esi##seq##ext
+#define SLCAN_DEFINE_FORMATTER(ts, esi, seq, ext)                                                                                   \
+    __RAM_FUNC static int32_t SLCAN_FORMATTER_NAME(ts, esi, seq, ext)(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header,             \
+                                                                      uint8_t *frame_data, uint16_t sequence)                       \
+    {                                                                                                                               \
+        return slcan_format_frame(buf, frame_header, frame_data, sequence, ts, esi, seq, ext);                                      \
+    }
+#define SLCAN_DEFINE_FORMATTER_ID(ts, esi, seq)     SLCAN_DEFINE_FORMATTER(ts, esi, seq, 0) SLCAN_DEFINE_FORMATTER(ts, esi, seq, 1)
+#define SLCAN_DEFINE_FORMATTER_SEQ(ts, esi)         SLCAN_DEFINE_FORMATTER_ID(ts, esi, 0) SLCAN_DEFINE_FORMATTER_ID(ts, esi, 1)
+#define SLCAN_DEFINE_FORMATTER_ESI(ts)              SLCAN_DEFINE_FORMATTER_SEQ(ts, 0) SLCAN_DEFINE_FORMATTER_SEQ(ts, 1)
+#define SLCAN_FORMATTER_ID(ts, esi, seq)            {SLCAN_FORMATTER_NAME(ts, esi, seq, 0), SLCAN_FORMATTER_NAME(ts, esi, seq, 1)}
+#define SLCAN_FORMATTER_SEQ(ts, esi)                {SLCAN_FORMATTER_ID(ts, esi, 0), SLCAN_FORMATTER_ID(ts, esi, 1)}
+#define SLCAN_FORMATTER_ESI(ts)                     {SLCAN_FORMATTER_SEQ(ts, 0), SLCAN_FORMATTER_SEQ(ts, 1)}
+
+SLCAN_DEFINE_FORMATTER_ESI(0)   // SLCAN_TIMESTAMP_OFF
+SLCAN_DEFINE_FORMATTER_ESI(1)   // SLCAN_TIMESTAMP_MILLI
+SLCAN_DEFINE_FORMATTER_ESI(2)   // SLCAN_TIMESTAMP_MICRO
+
+static const slcan_formatter_t slcan_formatter_table[SLCAN_TIMESTAMP_INVALID][2][2][2] =
+{
+    SLCAN_FORMATTER_ESI(0),
+    SLCAN_FORMATTER_ESI(1),
+    SLCAN_FORMATTER_ESI(2),
+};
+
+// Tx event reports by latency and attempt report
+static const slcan_tx_generator_t slcan_tx_generator_table[2][2] =
+{
+    {slcan_generate_tx_report, slcan_generate_tx_report_attempt},
+    {slcan_generate_tx_report_latency, slcan_generate_tx_report_latency_attempt},
+};
+
+// Bound in slcan_bind_generator, defaults match the default report settings
+static slcan_formatter_t slcan_formatter[2] = {SLCAN_FORMATTER_NAME(0, 0, 0, 0), SLCAN_FORMATTER_NAME(0, 0, 0, 1)};
+static slcan_rx_generator_t slcan_rx_generator = slcan_generate_rx_report;
+static slcan_tx_generator_t slcan_tx_generator = slcan_generate_tx_none;
+static uint8_t slcan_dropped_step = 0;      // Count lost reports only with sequence numbers
 
 // Generate a slcan message from a CAN frame
-int32_t slcan_generate_frame(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data)
+static inline __attribute__((always_inline)) int32_t slcan_format_frame(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data, uint16_t sequence,
+                                                                        const enum slcan_timestamp_mode timestamp, const uint8_t esi, const uint8_t seq, const uint8_t ext)
 {
     // Start building the slcan message string at idx 0 in buf
     uint8_t msg_idx = 0;
@@ -67,7 +129,7 @@ int32_t slcan_generate_frame(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header,
     }
 
     // Check id type
-    if (frame_header->IdType == FDCAN_STANDARD_ID)
+    if (!ext)
     {
         msg_idx = 1 + SLCAN_STD_ID_LEN;     // Type & ID
     }
@@ -103,7 +165,7 @@ int32_t slcan_generate_frame(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header,
     }
 
     // Add time stamp
-    if (slcan_timestamp_mode == SLCAN_TIMESTAMP_MILLI)
+    if (timestamp == SLCAN_TIMESTAMP_MILLI)
     {
         uint16_t timestamp_ms = slcan_get_timestamp_ms();
 
@@ -112,7 +174,7 @@ int32_t slcan_generate_frame(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header,
         buf[msg_idx++] = slcan_nibble_to_ascii[(timestamp_ms >> 4) & 0xF];
         buf[msg_idx++] = slcan_nibble_to_ascii[timestamp_ms & 0xF];
     }
-    else if (slcan_timestamp_mode == SLCAN_TIMESTAMP_MICRO)
+    else if (timestamp == SLCAN_TIMESTAMP_MICRO)
     {
         uint32_t timestamp_us = slcan_get_timestamp_us_from_tim3(frame_header->RxTimestamp);
 
@@ -128,7 +190,7 @@ int32_t slcan_generate_frame(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header,
     
     // Add error state indicator
     // FD frame only. No ESI for a classical frame.
-    if ((slcan_report_reg >> SLCAN_REPORT_ESI) & 1)
+    if (esi)
     {
         if (frame_header->FDFormat == FDCAN_FD_CAN)
         {
@@ -139,6 +201,15 @@ int32_t slcan_generate_frame(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header,
         }
     }
 
+    // Add sequence number
+    if (seq)
+    {
+        buf[msg_idx++] = slcan_nibble_to_ascii[(sequence >> 12) & 0xF];
+        buf[msg_idx++] = slcan_nibble_to_ascii[(sequence >> 8) & 0xF];
+        buf[msg_idx++] = slcan_nibble_to_ascii[(sequence >> 4) & 0xF];
+        buf[msg_idx++] = slcan_nibble_to_ascii[sequence & 0xF];
+    }
+
     // Add CR for slcan EOL
     buf[msg_idx++] = '\r';
 
@@ -146,31 +217,146 @@ int32_t slcan_generate_frame(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header,
     return msg_idx;
 }
 
-// Parse an incoming CAN frame into an outgoing slcan message
-int32_t slcan_generate_rx_frame(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data)
+// Generate a marker with the number of reports lost while the buffer to host was full
+__RAM_FUNC static int32_t slcan_generate_drop_marker(uint8_t *buf)
 {
-    // Rx reporting not required
-    if (((slcan_report_reg >> SLCAN_REPORT_RX) & 1) == 0)
+    if (slcan_dropped_nbr == 0)
         return 0;
 
+    buf[0] = 'x';
+    for (uint8_t j = 0; j < 8; j++)
+    {
+        buf[8 - j] = slcan_nibble_to_ascii[(slcan_dropped_nbr >> (j * 4)) & 0xF];
+    }
+    buf[9] = '\r';
+    slcan_dropped_nbr = 0;
+
+    return SLCAN_DROP_LEN;
+}
+
+// Parse an incoming CAN frame into an outgoing slcan message
+__RAM_FUNC int32_t slcan_generate_rx_frame(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data)
+{
+    return slcan_rx_generator(buf, frame_header, frame_data);
+}
+
+// Parse an incoming Tx event into an outgoing slcan message
+__RAM_FUNC int32_t slcan_generate_tx_event(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data, uint32_t latency_us, uint32_t attempts)
+{
+    return slcan_tx_generator(buf, tx_event, frame_data, latency_us, attempts);
+}
+
+// Report a frame removed without transmission with the reason and its ID
+int32_t slcan_generate_tx_cancel(uint8_t *buf, FDCAN_TxHeaderTypeDef *frame_header, uint8_t reason)
+{
+    if (buf == NULL) return 0;
+
+    uint8_t msg_idx = 0;
+    uint8_t id_len;
+
+    if (frame_header->IdType == FDCAN_STANDARD_ID)
+    {
+        buf[msg_idx++] = 'c';
+        id_len = SLCAN_STD_ID_LEN;
+    }
+    else
+    {
+        buf[msg_idx++] = 'C';
+        id_len = SLCAN_EXT_ID_LEN;
+    }
+    buf[msg_idx++] = slcan_nibble_to_ascii[reason & 0xF];
+
+    for (uint8_t j = 0; j < id_len; j++)
+        buf[msg_idx + id_len - 1 - j] = slcan_nibble_to_ascii[(frame_header->Identifier >> (j * 4)) & 0xF];
+    msg_idx += id_len;
+
+    buf[msg_idx++] = '\r';
+
+    return msg_idx;
+}
+
+// Bind the generators to the report settings, call when the settings are changed
+void slcan_bind_generator(void)
+{
+    uint8_t esi = (slcan_report_reg >> SLCAN_REPORT_ESI) & 1;
+    uint8_t seq = (slcan_report_reg >> SLCAN_REPORT_SEQ) & 1;
+
+    slcan_formatter[0] = slcan_formatter_table[slcan_timestamp_mode][esi][seq][0];
+    slcan_formatter[1] = slcan_formatter_table[slcan_timestamp_mode][esi][seq][1];
+    slcan_rx_generator = ((slcan_report_reg >> SLCAN_REPORT_RX) & 1) ? slcan_generate_rx_report : slcan_generate_rx_none;
+    if (((slcan_report_reg >> SLCAN_REPORT_TX) & 1) == 0)
+        slcan_tx_generator = slcan_generate_tx_none;
+    else
+        slcan_tx_generator = slcan_tx_generator_table[(slcan_report_reg >> SLCAN_REPORT_TX_LATENCY) & 1]
+                                                     [(slcan_report_reg >> SLCAN_REPORT_TX_ATTEMPT) & 1];
+    slcan_dropped_step = seq;
+}
+
+// Report a rx frame
+__RAM_FUNC static int32_t slcan_generate_rx_report(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data)
+{
+    uint16_t sequence = slcan_sequence_rx++;
+
     if (buf == NULL)
+    {
+        slcan_dropped_nbr += slcan_dropped_step;
         return 0;
+    }
 
-    int32_t msg_idx = slcan_generate_frame(buf, frame_header, frame_data);
+    int32_t msg_idx = slcan_generate_drop_marker(buf);
+    msg_idx += slcan_formatter[frame_header->IdType == FDCAN_EXTENDED_ID](&buf[msg_idx], frame_header, frame_data, sequence);
 
     // Return string length
     return msg_idx;
 }
 
-// Parse an incoming Tx event into an outgoing slcan message
-int32_t slcan_generate_tx_event(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data)
+// Rx reporting not required
+static int32_t slcan_generate_rx_none(uint8_t *buf, FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data)
 {
-    // Tx reporting not required
-    if (((slcan_report_reg >> SLCAN_REPORT_TX) & 1) == 0)
-        return 0;
+    (void)buf;
+    (void)frame_header;
+    (void)frame_data;
+    return 0;
+}
+
+// Report a tx event
+__RAM_FUNC static int32_t slcan_generate_tx_report(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data, uint32_t latency_us, uint32_t attempts)
+{
+    return slcan_format_tx_event(buf, tx_event, frame_data, latency_us, attempts, 0, 0);
+}
+
+// Report a tx event with the time it waited in the queue
+__RAM_FUNC static int32_t slcan_generate_tx_report_latency(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data, uint32_t latency_us, uint32_t attempts)
+{
+    return slcan_format_tx_event(buf, tx_event, frame_data, latency_us, attempts, 1, 0);
+}
+
+// Report a tx event with the number of transmission attempts
+__RAM_FUNC static int32_t slcan_generate_tx_report_attempt(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data, uint32_t latency_us, uint32_t attempts)
+{
+    return slcan_format_tx_event(buf, tx_event, frame_data, latency_us, attempts, 0, 1);
+}
+
+// Report a tx event with the queueing latency and the number of transmission attempts
+__RAM_FUNC static int32_t slcan_generate_tx_report_latency_attempt(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data, uint32_t latency_us, uint32_t attempts)
+{
+    return slcan_format_tx_event(buf, tx_event, frame_data, latency_us, attempts, 1, 1);
+}
+
+// Generate a slcan message from a tx event
+static inline __attribute__((always_inline)) int32_t slcan_format_tx_event(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data,
+                                                                           uint32_t latency_us, uint32_t attempts, const uint8_t latency, const uint8_t attempt)
+{
+    uint16_t sequence = slcan_sequence_tx++;
 
     if (buf == NULL)
+    {
+        slcan_dropped_nbr += slcan_dropped_step;
         return 0;
+    }
+
+    int32_t msg_idx = slcan_generate_drop_marker(buf);
+    buf = &buf[msg_idx];
 
     if (tx_event->IdType == FDCAN_STANDARD_ID)
         buf[0] = 'z';
@@ -186,15 +372,50 @@ int32_t slcan_generate_tx_event(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event
     frame_header.BitRateSwitch = tx_event->BitRateSwitch;
     frame_header.FDFormat = tx_event->FDFormat;
     frame_header.RxTimestamp = tx_event->TxTimestamp;
-    int32_t msg_idx = slcan_generate_frame(&buf[1], &frame_header, frame_data);
+    int32_t frame_len = slcan_formatter[tx_event->IdType == FDCAN_EXTENDED_ID](&buf[1], &frame_header, frame_data, sequence);
+
+    // Add queueing latency in place of CR, saturated to 4 digits
+    if (latency)
+    {
+        uint16_t latency_sat = (latency_us < UINT16_MAX) ? latency_us : UINT16_MAX;
+        uint8_t *tail = &buf[frame_len];    // CR of the frame
+        tail[0] = slcan_nibble_to_ascii[(latency_sat >> 12) & 0xF];
+        tail[1] = slcan_nibble_to_ascii[(latency_sat >> 8) & 0xF];
+        tail[2] = slcan_nibble_to_ascii[(latency_sat >> 4) & 0xF];
+        tail[3] = slcan_nibble_to_ascii[latency_sat & 0xF];
+        tail[4] = '\r';
+        frame_len += 4;
+    }
+
+    // Add transmission attempts in place of CR, saturated to 2 digits
+    if (attempt)
+    {
+        uint8_t attempts_sat = (attempts < UINT8_MAX) ? attempts : UINT8_MAX;
+        uint8_t *tail = &buf[frame_len];    // CR of the frame
+        tail[0] = slcan_nibble_to_ascii[(attempts_sat >> 4) & 0xF];
+        tail[1] = slcan_nibble_to_ascii[attempts_sat & 0xF];
+        tail[2] = '\r';
+        frame_len += 2;
+    }
 
     // Return string length
-    return msg_idx + 1;
+    return msg_idx + frame_len + 1;
+}
+
+// Tx reporting not required
+static int32_t slcan_generate_tx_none(uint8_t *buf, FDCAN_TxEventFifoTypeDef *tx_event, uint8_t *frame_data, uint32_t latency_us, uint32_t attempts)
+{
+    (void)buf;
+    (void)tx_event;
+    (void)frame_data;
+    (void)latency_us;
+    (void)attempts;
+    return 0;
 }
 
 
 // Gets milli second timestamp (2bytes, MAX 60,000ms)
-uint16_t slcan_get_timestamp_ms(void)
+__RAM_FUNC uint16_t slcan_get_timestamp_ms(void)
 {
     static uint16_t slcan_last_timestamp_ms = 0;
     static uint32_t slcan_last_time_ms = 0;
@@ -211,7 +432,7 @@ uint16_t slcan_get_timestamp_ms(void)
 }
 
 // Gets micro second timestamp (4bytes, MAX 3600,000,000us)
-uint32_t slcan_get_timestamp_us_from_tim3(uint16_t tim3_us)
+__RAM_FUNC uint32_t slcan_get_timestamp_us_from_tim3(uint16_t tim3_us)
 {
     static uint32_t slcan_last_timestamp_us = 0;
     static uint32_t slcan_last_time_ms = 0;
@@ -262,6 +483,14 @@ void slcan_set_report_mode(uint16_t reg)
     return;
 }
 
+// Restart the sequence numbers of both directions from zero
+void slcan_clear_sequence(void)
+{
+    slcan_sequence_rx = 0;
+    slcan_sequence_tx = 0;
+    slcan_dropped_nbr = 0;
+}
+
 // Report the current timestamp mode
 enum slcan_timestamp_mode slcan_get_timestamp_mode(void)
 {
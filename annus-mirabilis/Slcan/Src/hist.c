@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+// Fixed size histograms for the latency statistics, percentiles with a bucket resolution
+
+#include <string.h>
+#include "stm32g0xx_hal.h"
+#include "hist.h"
+
+// Private methods
+static uint32_t hist_get_bucket(uint32_t value);
+static uint32_t hist_get_bucket_max(uint32_t bucket);
+
+// Clear all counts
+void hist_clear(struct hist *hist)
+{
+    memset(hist, 0, sizeof(struct hist));
+}
+
+// Count one value
+__RAM_FUNC void hist_add(struct hist *hist, uint32_t value)
+{
+    hist->count[hist_get_bucket(value)]++;
+    hist->total++;
+    if (hist->max < value)
+        hist->max = value;
+}
+
+// Get the value not exceeded by the given part of the counts (upper end of the bucket, at most the maximum)
+uint32_t hist_get_percentile(struct hist *hist, uint16_t permille)
+{
+    if (hist->total == 0) return 0;
+
+    // Number of counts to reach, rounded up
+    uint64_t target = ((uint64_t)hist->total * permille + 999) / 1000;
+    if (target == 0) target = 1;
+
+    uint64_t sum = 0;
+    for (uint32_t bucket = 0; bucket < HIST_BUCKET_NUM; bucket++)
+    {
+        sum += hist->count[bucket];
+        if (target <= sum)
+        {
+            uint32_t value = hist_get_bucket_max(bucket);
+            return (value < hist->max) ? value : hist->max;
+        }
+    }
+
+    return hist->max;
+}
+
+// Get the largest value counted
+uint32_t hist_get_max(struct hist *hist)
+{
+    return hist->max;
+}
+
+// Get the number of values counted
+uint32_t hist_get_total(struct hist *hist)
+{
+    return hist->total;
+}
+
+// Get the bucket of a value, the top bucket also takes all larger values
+__RAM_FUNC static uint32_t hist_get_bucket(uint32_t value)
+{
+    if (value < (2UL << HIST_SUB_BITS))
+        return value;
+
+    uint32_t msb = 31 - __CLZ(value);
+    uint32_t bucket = ((msb - HIST_SUB_BITS) << HIST_SUB_BITS) + (value >> (msb - HIST_SUB_BITS));
+
+    return (bucket < HIST_BUCKET_NUM) ? bucket : HIST_BUCKET_NUM - 1;
+}
+
+// Get the largest value in a bucket
+static uint32_t hist_get_bucket_max(uint32_t bucket)
+{
+    if (bucket < (2UL << HIST_SUB_BITS))
+        return bucket;
+    if (HIST_BUCKET_NUM - 1 <= bucket)
+        return UINT32_MAX;
+
+    uint32_t shift = (bucket >> HIST_SUB_BITS) - 1;
+    uint32_t base = bucket - (shift << HIST_SUB_BITS);     // (1 << HIST_SUB_BITS) .. (2 << HIST_SUB_BITS) - 1
+
+    return ((base + 1) << shift) - 1;
+}
@@ -0,0 +1,307 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+// ID set filter. The uploaded ID lists are compiled into range and dual ID
+// filter elements of the FDCAN, joining the IDs across the smallest gaps until
+// the elements fit in the hardware. The IDs let through by the joined gaps are
+// rejected by the second stage with a bitmap (standard) or a binary search
+// in the sorted list (extended).
+
+#include "stm32g0xx_hal.h"
+#include "idset.h"
+
+// Compiled filter elements of an ID type
+struct idset_filter
+{
+    FDCAN_FilterTypeDef element[IDSET_STD_FILTER_MAX];
+    uint8_t nbr;
+    uint32_t false_accept_nbr;
+};
+
+// Private variables
+static FunctionalState idset_state = DISABLE;
+static FunctionalState idset_is_dirty = DISABLE;
+static uint32_t idset_std_bitmap[2048 / 32] = {0};
+static uint16_t idset_std_nbr = 0;
+static uint32_t idset_ext_list[IDSET_EXT_ID_MAX];       // Sorted without duplicate
+static uint16_t idset_ext_nbr = 0;
+static uint32_t idset_work_list[IDSET_STD_ID_MAX];      // Sorted standard IDs while compiling
+static struct idset_filter idset_std_filter = {0};
+static struct idset_filter idset_ext_filter = {0};
+
+// Private methods
+static uint8_t idset_count_filter(const uint32_t *list, uint16_t nbr, uint32_t gap_max, uint16_t tie_nbr, uint32_t *false_nbr);
+static FunctionalState idset_is_joined(const uint32_t *list, uint16_t nbr, uint16_t index, uint32_t gap_max, uint16_t tie_nbr, uint16_t *tie_cnt);
+static void idset_build_filter(const uint32_t *list, uint16_t nbr, uint8_t filter_max, uint32_t id_type, struct idset_filter *filter);
+static void idset_set_element(FDCAN_FilterTypeDef *element, uint8_t index, uint32_t id_type, uint32_t type, uint32_t id1, uint32_t id2);
+
+// Enable / disable the ID set filter, effective at the next open
+void idset_set_state(FunctionalState state)
+{
+    idset_state = state;
+}
+
+// Return ENABLE if the ID set filter is selected
+FunctionalState idset_is_enabled(void)
+{
+    return idset_state;
+}
+
+// Add an ID to the list, an ID already in the list is ignored
+HAL_StatusTypeDef idset_add_id(uint32_t id_type, uint32_t id)
+{
+    if (id_type == FDCAN_STANDARD_ID)
+    {
+        if (0x7FF < id) return HAL_ERROR;
+        if ((idset_std_bitmap[id >> 5] >> (id & 0x1F)) & 1) return HAL_OK;
+        if (IDSET_STD_ID_MAX <= idset_std_nbr) return HAL_ERROR;
+
+        idset_std_bitmap[id >> 5] |= (1UL << (id & 0x1F));
+        idset_std_nbr++;
+    }
+    else
+    {
+        if (0x1FFFFFFF < id) return HAL_ERROR;
+
+        // Find the insert position
+        uint16_t low = 0;
+        uint16_t high = idset_ext_nbr;
+        while (low < high)
+        {
+            uint16_t mid = (low + high) / 2;
+            if (idset_ext_list[mid] < id) low = mid + 1;
+            else high = mid;
+        }
+        if (low < idset_ext_nbr && idset_ext_list[low] == id) return HAL_OK;
+        if (IDSET_EXT_ID_MAX <= idset_ext_nbr) return HAL_ERROR;
+
+        for (uint16_t i = idset_ext_nbr; low < i; i--)
+            idset_ext_list[i] = idset_ext_list[i - 1];
+        idset_ext_list[low] = id;
+        idset_ext_nbr++;
+    }
+
+    idset_is_dirty = ENABLE;
+    return HAL_OK;
+}
+
+// Remove all IDs from the lists
+void idset_clear(void)
+{
+    for (uint8_t i = 0; i < 2048 / 32; i++)
+        idset_std_bitmap[i] = 0;
+    idset_std_nbr = 0;
+    idset_ext_nbr = 0;
+    idset_is_dirty = ENABLE;
+}
+
+// Compile the lists into the filter elements if they are changed
+void idset_compile(void)
+{
+    if (idset_is_dirty == DISABLE) return;
+
+    uint16_t nbr = 0;
+    for (uint32_t id = 0; id <= 0x7FF; id++)
+    {
+        if ((idset_std_bitmap[id >> 5] >> (id & 0x1F)) & 1)
+            idset_work_list[nbr++] = id;
+    }
+
+    idset_build_filter(idset_work_list, nbr, IDSET_STD_FILTER_MAX, FDCAN_STANDARD_ID, &idset_std_filter);
+    idset_build_filter(idset_ext_list, idset_ext_nbr, IDSET_EXT_FILTER_MAX, FDCAN_EXTENDED_ID, &idset_ext_filter);
+
+    idset_is_dirty = DISABLE;
+}
+
+// Get the number of IDs in the list
+uint16_t idset_get_id_nbr(uint32_t id_type)
+{
+    return (id_type == FDCAN_STANDARD_ID) ? idset_std_nbr : idset_ext_nbr;
+}
+
+// Get the number of compiled filter elements
+uint8_t idset_get_filter_nbr(uint32_t id_type)
+{
+    return (id_type == FDCAN_STANDARD_ID) ? idset_std_filter.nbr : idset_ext_filter.nbr;
+}
+
+// Get a compiled filter element
+FDCAN_FilterTypeDef *idset_get_filter(uint32_t id_type, uint8_t index)
+{
+    struct idset_filter *filter = (id_type == FDCAN_STANDARD_ID) ? &idset_std_filter : &idset_ext_filter;
+    if (filter->nbr <= index) return NULL;
+    return &filter->element[index];
+}
+
+// Get the number of IDs accepted by the filter elements but not in the list
+uint32_t idset_get_false_accept_nbr(uint32_t id_type)
+{
+    return (id_type == FDCAN_STANDARD_ID) ? idset_std_filter.false_accept_nbr : idset_ext_filter.false_accept_nbr;
+}
+
+// Get the ratio of the false accepted IDs to all IDs accepted by the filter elements
+uint32_t idset_get_false_accept_ppm(void)
+{
+    uint64_t false_nbr = (uint64_t)idset_std_filter.false_accept_nbr + idset_ext_filter.false_accept_nbr;
+    uint64_t total_nbr = false_nbr + idset_std_nbr + idset_ext_nbr;
+    if (total_nbr == 0) return 0;
+    return (uint32_t)(false_nbr * 1000000 / total_nbr);
+}
+
+// Return ENABLE if the frame ID is in the list or the ID set filter is not selected
+__RAM_FUNC FunctionalState idset_is_accepted(FDCAN_RxHeaderTypeDef *frame_header)
+{
+    if (idset_state == DISABLE) return ENABLE;
+
+    uint32_t id = frame_header->Identifier;
+    if (frame_header->IdType == FDCAN_STANDARD_ID)
+        return ((idset_std_bitmap[(id >> 5) & 0x3F] >> (id & 0x1F)) & 1) ? ENABLE : DISABLE;
+
+    uint16_t low = 0;
+    uint16_t high = idset_ext_nbr;
+    while (low < high)
+    {
+        uint16_t mid = (low + high) / 2;
+        if (idset_ext_list[mid] == id) return ENABLE;
+        if (idset_ext_list[mid] < id) low = mid + 1;
+        else high = mid;
+    }
+    return DISABLE;
+}
+
+// Count the filter elements when the gaps larger than gap_max and the first
+// tie_nbr gaps equal to gap_max are split
+static uint8_t idset_count_filter(const uint32_t *list, uint16_t nbr, uint32_t gap_max, uint16_t tie_nbr, uint32_t *false_nbr)
+{
+    uint16_t range_nbr = 0;
+    uint16_t single_nbr = 0;
+    uint16_t start = 0;
+    uint16_t tie_cnt = 0;
+
+    *false_nbr = 0;
+    for (uint16_t i = 0; i < nbr; i++)
+    {
+        if (idset_is_joined(list, nbr, i, gap_max, tie_nbr, &tie_cnt) == ENABLE) continue;
+
+        if (i == start)
+        {
+            single_nbr++;
+        }
+        else
+        {
+            range_nbr++;
+            *false_nbr += (list[i] - list[start] + 1) - (i - start + 1);
+        }
+        start = i + 1;
+    }
+
+    // Two single IDs share a dual ID element
+    uint16_t filter_nbr = range_nbr + (single_nbr + 1) / 2;
+    return (UINT8_MAX < filter_nbr) ? UINT8_MAX : (uint8_t)filter_nbr;
+}
+
+// Return ENABLE if the ID at index is joined with the next ID
+static FunctionalState idset_is_joined(const uint32_t *list, uint16_t nbr, uint16_t index, uint32_t gap_max, uint16_t tie_nbr, uint16_t *tie_cnt)
+{
+    if (nbr <= index + 1) return DISABLE;
+
+    uint32_t gap = list[index + 1] - list[index] - 1;
+    if (gap < gap_max) return ENABLE;
+    if (gap > gap_max) return DISABLE;
+    return ((*tie_cnt)++ < tie_nbr) ? DISABLE : ENABLE;
+}
+
+// Build the filter elements splitting the largest gaps as many as the elements fit
+static void idset_build_filter(const uint32_t *list, uint16_t nbr, uint8_t filter_max, uint32_t id_type, struct idset_filter *filter)
+{
+    // Splitting a gap never reduces the elements, so binary search on the smallest
+    // gap threshold with all equal gaps joined, then on the equal gaps to split
+    uint32_t gap_low = 0;
+    uint32_t gap_high = 0;
+    for (uint16_t i = 0; i + 1 < nbr; i++)
+    {
+        if (gap_high < list[i + 1] - list[i] - 1) gap_high = list[i + 1] - list[i] - 1;
+    }
+    while (gap_low < gap_high)
+    {
+        uint32_t mid = gap_low + (gap_high - gap_low) / 2;
+        if (idset_count_filter(list, nbr, mid, 0, &filter->false_accept_nbr) <= filter_max) gap_high = mid;
+        else gap_low = mid + 1;
+    }
+
+    uint16_t tie_low = 0;
+    uint16_t tie_high = nbr;
+    while (tie_low < tie_high)
+    {
+        uint16_t mid = tie_high - (tie_high - tie_low) / 2;
+        if (idset_count_filter(list, nbr, gap_low, mid, &filter->false_accept_nbr) <= filter_max) tie_low = mid;
+        else tie_high = mid - 1;
+    }
+    idset_count_filter(list, nbr, gap_low, tie_low, &filter->false_accept_nbr);
+
+    uint8_t index = 0;
+    uint16_t start = 0;
+    uint16_t tie_cnt = 0;
+    int32_t single_id = -1;
+    for (uint16_t i = 0; i < nbr; i++)
+    {
+        if (idset_is_joined(list, nbr, i, gap_low, tie_low, &tie_cnt) == ENABLE) continue;
+
+        if (i != start)
+        {
+            uint32_t type = (id_type == FDCAN_STANDARD_ID) ? FDCAN_FILTER_RANGE : FDCAN_FILTER_RANGE_NO_EIDM;
+            idset_set_element(&filter->element[index], index, id_type, type, list[start], list[i]);
+            index++;
+        }
+        else if (single_id < 0)
+        {
+            single_id = (int32_t)list[i];
+        }
+        else
+        {
+            idset_set_element(&filter->element[index], index, id_type, FDCAN_FILTER_DUAL, (uint32_t)single_id, list[i]);
+            index++;
+            single_id = -1;
+        }
+        start = i + 1;
+    }
+
+    // Last single ID in both slots of a dual ID element
+    if (0 <= single_id)
+    {
+        idset_set_element(&filter->element[index], index, id_type, FDCAN_FILTER_DUAL, (uint32_t)single_id, (uint32_t)single_id);
+        index++;
+    }
+
+    filter->nbr = index;
+}
+
+// Fill a filter element to FIFO0
+static void idset_set_element(FDCAN_FilterTypeDef *element, uint8_t index, uint32_t id_type, uint32_t type, uint32_t id1, uint32_t id2)
+{
+    element->IdType = id_type;
+    element->FilterIndex = index;
+    element->FilterType = type;
+    element->FilterConfig = FDCAN_FILTER_TO_RXFIFO0;
+    element->FilterID1 = id1;
+    element->FilterID2 = id2;
+}
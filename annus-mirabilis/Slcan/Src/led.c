@@ -24,10 +24,12 @@
 
 #include "stm32g0xx_hal.h"
 #include "led.h"
+#include "can.h"
 #include "slcan.h"
 
 // Duration in ms
 #define LED_BLINK_DURATION    (25)
+#define LED_SEQUENCE_DURATION (100)
 
 // Private variables
 static uint32_t led_rxd_last_time = 0;
@@ -35,6 +37,8 @@ static uint32_t led_txd_last_time = 0;
 static enum led_state led_rxd_last_state = LED_OFF;
 static enum led_state led_txd_last_state = LED_OFF;
 static uint8_t led_error_was_indicating = 0;
+static uint32_t led_sequence_last_time = 0;
+static uint8_t led_sequence_steps = 0;
 
 // Initialize LED GPIOs
 void led_init()
@@ -49,19 +53,13 @@ void led_turn_txd(enum led_state state)
     HAL_GPIO_WritePin(LED_TXD, state);
 }
 
-// Blink two LEDs (blocking)
+// Blink two LEDs alternately (non-blocking, processed in led_process)
 void led_blink_sequence(uint8_t numblinks)
 {
-    uint8_t i;
-    for (i = 0; i < numblinks; i++)
-    {
-        HAL_GPIO_WritePin(LED_RXD, LED_ON);
-        HAL_GPIO_WritePin(LED_TXD, LED_OFF);
-        HAL_Delay(100);
-        HAL_GPIO_WritePin(LED_RXD, LED_OFF);
-        HAL_GPIO_WritePin(LED_TXD, LED_ON);
-        HAL_Delay(100);
-    }
+    HAL_GPIO_WritePin(LED_RXD, LED_ON);
+    HAL_GPIO_WritePin(LED_TXD, LED_OFF);
+    led_sequence_last_time = HAL_GetTick();
+    led_sequence_steps = numblinks * 2;
 }
 
 // Turn green LED on for a short duration
@@ -69,7 +67,7 @@ void led_blink_txd(void)
 {
     // Make sure the LED has been off for at least LED_BLINK_DURATION before turning on again
     // This prevents a solid status LED on a busy can bus
-    if (led_txd_last_state == LED_OFF && (uint32_t)(HAL_GetTick() - led_txd_last_time) > LED_BLINK_DURATION)
+    if (led_sequence_steps == 0 && led_txd_last_state == LED_OFF && (uint32_t)(HAL_GetTick() - led_txd_last_time) > LED_BLINK_DURATION)
     {
         HAL_GPIO_WritePin(LED_TXD, LED_ON);
         led_txd_last_time = HAL_GetTick();
@@ -82,7 +80,7 @@ void led_blink_rxd(void)
 {
     // Make sure the LED has been off for at least LED_BLINK_DURATION before turning on again
     // This prevents a solid status LED on a busy canbus
-    if (led_rxd_last_state == LED_OFF && (uint32_t)(HAL_GetTick() - led_rxd_last_time) > LED_BLINK_DURATION)
+    if (led_sequence_steps == 0 && led_rxd_last_state == LED_OFF && (uint32_t)(HAL_GetTick() - led_rxd_last_time) > LED_BLINK_DURATION)
     {
         HAL_GPIO_WritePin(LED_RXD, LED_ON);
         led_rxd_last_time = HAL_GetTick();
@@ -93,6 +91,33 @@ void led_blink_rxd(void)
 // Process time-based LED events
 void led_process(void)
 {
+    // Blink sequence has priority over the status indication
+    if (led_sequence_steps > 0)
+    {
+        if ((uint32_t)(HAL_GetTick() - led_sequence_last_time) >= LED_SEQUENCE_DURATION)
+        {
+            led_sequence_last_time = HAL_GetTick();
+            led_sequence_steps--;
+            if (led_sequence_steps == 0)
+            {
+                // Back to the state of the channel: green on while closed
+                HAL_GPIO_WritePin(LED_RXD, LED_OFF);
+                HAL_GPIO_WritePin(LED_TXD, (can_get_bus_state() == BUS_OPENED) ? LED_OFF : LED_ON);
+            }
+            else if (led_sequence_steps % 2)
+            {
+                HAL_GPIO_WritePin(LED_RXD, LED_OFF);
+                HAL_GPIO_WritePin(LED_TXD, LED_ON);
+            }
+            else
+            {
+                HAL_GPIO_WritePin(LED_RXD, LED_ON);
+                HAL_GPIO_WritePin(LED_TXD, LED_OFF);
+            }
+        }
+        return;
+    }
+
     // If error occurred in the last LED_ERROR_DURATION, override LEDs with constant on
     if (slcan_get_status_flags())
     {
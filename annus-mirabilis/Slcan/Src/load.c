@@ -0,0 +1,171 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+// Bus load telemetry: frame bits, frames, errors and the longest burst per
+// sample interval, kept in a ring and optionally streamed to the host.
+
+#include "stm32g0xx_hal.h"
+#include "buffer.h"
+#include "can.h"
+#include "load.h"
+#include "slcan.h"
+
+#define LOAD_BURST_GAP_BITS     11      // Longer idle between frames ends a burst (bus idle)
+
+// Private variables
+static struct load_sample load_ring[LOAD_SAMPLE_NUM];
+static uint16_t load_head = 0;                  // Next sample to write
+static uint16_t load_tail = 0;                  // Next sample to read
+static struct load_sample load_now = {0};       // Sample being counted
+static uint16_t load_interval_ms = 0;           // 0: off
+static FunctionalState load_stream = DISABLE;
+static uint32_t load_start_tick = 0;
+static uint32_t load_err_cnt_start = 0;
+static uint16_t load_burst_len = 0;
+static uint16_t load_last_end_us = 0;           // End of the last frame (us timer, 16bit)
+
+// Private methods
+static void load_close_sample(void);
+
+// Set the sample interval (0 for off) and whether each sample is sent to the host
+HAL_StatusTypeDef load_set_config(uint16_t interval_ms, FunctionalState stream)
+{
+    if (stream != ENABLE && stream != DISABLE) return HAL_ERROR;
+
+    load_interval_ms = interval_ms;
+    load_stream = stream;
+    load_clear();
+
+    return HAL_OK;
+}
+
+// Get the sample interval in ms (0 for off)
+uint16_t load_get_interval_ms(void)
+{
+    return load_interval_ms;
+}
+
+// Drop the samples and restart the interval
+void load_clear(void)
+{
+    load_head = 0;
+    load_tail = 0;
+    load_now = (struct load_sample){0};
+    load_burst_len = 0;
+    load_start_tick = HAL_GetTick();
+    load_err_cnt_start = can_get_protocol_err_cnt();
+}
+
+// Count a frame on the bus from its start of frame time and length
+__RAM_FUNC void load_count_frame(uint16_t sof_us, uint16_t bits, uint32_t bit_time_ns)
+{
+    if (load_interval_ms == 0) return;
+
+    // Frames are handled by FIFO, so a frame may start before the end of the last one handled
+    int16_t gap_us = (int16_t)(sof_us - load_last_end_us);
+    if (0 < load_burst_len && gap_us <= (int16_t)(LOAD_BURST_GAP_BITS * bit_time_ns / 1000 + 1))
+    {
+        if (load_burst_len < UINT16_MAX) load_burst_len++;
+    }
+    else
+    {
+        load_burst_len = 1;
+    }
+    load_last_end_us = sof_us + (uint16_t)((uint32_t)bits * bit_time_ns / 1000);
+
+    load_now.bits += bits;
+    if (load_now.frames < UINT16_MAX) load_now.frames++;
+    if (load_now.burst_max < load_burst_len) load_now.burst_max = load_burst_len;
+}
+
+// Close the sample at the end of each interval, call every tick while the channel is open
+void load_process(void)
+{
+    if (load_interval_ms == 0) return;
+
+    uint32_t tick_now = HAL_GetTick();
+    if ((uint32_t)(tick_now - load_start_tick) < load_interval_ms) return;
+
+    load_close_sample();
+
+    // Keep the cadence, restart if the main loop fell behind by more than one interval
+    load_start_tick += load_interval_ms;
+    if (load_interval_ms <= (uint32_t)(tick_now - load_start_tick))
+        load_start_tick = tick_now;
+}
+
+// Move up to num oldest samples out of the ring, return the number moved
+uint32_t load_read(struct load_sample *sample, uint32_t num)
+{
+    uint32_t i;
+
+    for (i = 0; i < num && load_tail != load_head; i++)
+    {
+        sample[i] = load_ring[load_tail];
+        load_tail = (load_tail + 1) % LOAD_SAMPLE_NUM;
+    }
+
+    return i;
+}
+
+// Write a sample in hex: bits 8 digits, frames, errors and burst 4 digits each
+int32_t load_generate_sample(uint8_t *buf, struct load_sample *sample)
+{
+    uint8_t idx = 0;
+
+    for (int8_t j = 28; j >= 0; j -= 4)
+        buf[idx++] = slcan_nibble_to_ascii[(sample->bits >> j) & 0xF];
+    for (int8_t j = 12; j >= 0; j -= 4)
+        buf[idx++] = slcan_nibble_to_ascii[(sample->frames >> j) & 0xF];
+    for (int8_t j = 12; j >= 0; j -= 4)
+        buf[idx++] = slcan_nibble_to_ascii[(sample->errors >> j) & 0xF];
+    for (int8_t j = 12; j >= 0; j -= 4)
+        buf[idx++] = slcan_nibble_to_ascii[(sample->burst_max >> j) & 0xF];
+
+    return idx;
+}
+
+// Store the sample of the interval and send it if streaming
+static void load_close_sample(void)
+{
+    uint32_t err_cnt = can_get_protocol_err_cnt();
+    uint32_t errors = err_cnt - load_err_cnt_start;
+    load_now.errors = (errors < UINT16_MAX) ? errors : UINT16_MAX;
+    load_err_cnt_start = err_cnt;
+
+    // Overwrite the oldest when full
+    load_ring[load_head] = load_now;
+    load_head = (load_head + 1) % LOAD_SAMPLE_NUM;
+    if (load_head == load_tail) load_tail = (load_tail + 1) % LOAD_SAMPLE_NUM;
+
+    // Streamed to the control port, the data port carries frames only
+    if (load_stream == ENABLE)
+    {
+        uint8_t buf[1 + LOAD_SAMPLE_LEN + 1];
+        buf[0] = 'l';
+        int32_t len = 1 + load_generate_sample(&buf[1], &load_now);
+        buf[len++] = '\r';
+        buf_enqueue_cdc_port(BUF_CDC_PORT_CTRL, buf, len);
+    }
+
+    load_now = (struct load_sample){0};
+}
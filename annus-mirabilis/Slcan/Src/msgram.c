@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+// Direct access to the FDCAN message RAM. Elements are read and written with
+// word accesses and the data of a received frame is used in place, so the
+// frame is formatted straight from the message RAM without a copy.
+
+#include "stm32g0xx_hal.h"
+#include "can.h"
+#include "msgram.h"
+
+// Elements in the message RAM, see RM0444
+#define MSGRAM_RX_ELEMENT_SIZE      (18 * 4)    // Header 2 words + data 16 words
+#define MSGRAM_TX_ELEMENT_SIZE      (18 * 4)
+#define MSGRAM_TX_EVENT_SIZE        (2 * 4)
+#define MSGRAM_HEADER_SIZE          (2 * 4)
+#define MSGRAM_RX_FIFO_SIZE         3           // Elements in a rx FIFO (fixed on STM32G0)
+
+// Header word 0
+#define MSGRAM_ESI                  0x80000000
+#define MSGRAM_XTD                  0x40000000
+#define MSGRAM_RTR                  0x20000000
+#define MSGRAM_EXTID                0x1FFFFFFF
+#define MSGRAM_STDID                0x1FFC0000
+#define MSGRAM_STDID_POS            18
+
+// Header word 1
+#define MSGRAM_MM                   0xFF000000
+#define MSGRAM_MM_POS               24
+#define MSGRAM_ET                   0x00C00000
+#define MSGRAM_FDF                  0x00200000
+#define MSGRAM_BRS                  0x00100000
+#define MSGRAM_DLC                  0x000F0000
+#define MSGRAM_DLC_POS              16
+#define MSGRAM_TS                   0x0000FFFF
+
+#ifdef MSGRAM_USE_HAL
+static uint8_t msgram_rx_data[CAN_MAX_DATALEN];
+#endif
+
+// Decode the header of the oldest frame in a rx FIFO and point to its data in the message RAM
+// The frame stays in the FIFO until released, so the data is valid until then
+__RAM_FUNC HAL_StatusTypeDef msgram_peek_rx(uint32_t fifo, FDCAN_RxHeaderTypeDef *header, uint8_t **data)
+{
+#ifdef MSGRAM_USE_HAL
+    *data = msgram_rx_data;
+    return HAL_FDCAN_GetRxMessage(can_get_handle(), fifo, header, msgram_rx_data);
+#else
+    FDCAN_HandleTypeDef *hfdcan = can_get_handle();
+    uint32_t status;
+    uint32_t index;
+    uint32_t base;
+
+    if (fifo == FDCAN_RX_FIFO0)
+    {
+        status = hfdcan->Instance->RXF0S;
+        if ((status & FDCAN_RXF0S_F0FL) == 0) return HAL_ERROR;
+        index = (status & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos;
+        base = hfdcan->msgRam.RxFIFO0SA;
+    }
+    else
+    {
+        status = hfdcan->Instance->RXF1S;
+        if ((status & FDCAN_RXF1S_F1FL) == 0) return HAL_ERROR;
+        index = (status & FDCAN_RXF1S_F1GI) >> FDCAN_RXF1S_F1GI_Pos;
+        base = hfdcan->msgRam.RxFIFO1SA;
+    }
+
+    const uint32_t *element = (const uint32_t *)(base + index * MSGRAM_RX_ELEMENT_SIZE);
+    uint32_t word0 = element[0];
+    uint32_t word1 = element[1];
+
+    header->IdType = word0 & MSGRAM_XTD;
+    if (header->IdType == FDCAN_STANDARD_ID)
+        header->Identifier = (word0 & MSGRAM_STDID) >> MSGRAM_STDID_POS;
+    else
+        header->Identifier = word0 & MSGRAM_EXTID;
+    header->RxFrameType = word0 & MSGRAM_RTR;
+    header->ErrorStateIndicator = word0 & MSGRAM_ESI;
+    header->RxTimestamp = word1 & MSGRAM_TS;
+    header->DataLength = (word1 & MSGRAM_DLC) >> MSGRAM_DLC_POS;
+    header->BitRateSwitch = word1 & MSGRAM_BRS;
+    header->FDFormat = word1 & MSGRAM_FDF;
+
+    *data = (uint8_t *)element + MSGRAM_HEADER_SIZE;
+    return HAL_OK;
+#endif
+}
+
+// Remove the oldest frame from a rx FIFO
+__RAM_FUNC void msgram_release_rx(uint32_t fifo)
+{
+#ifndef MSGRAM_USE_HAL
+    FDCAN_HandleTypeDef *hfdcan = can_get_handle();
+
+    if (fifo == FDCAN_RX_FIFO0)
+        hfdcan->Instance->RXF0A = (hfdcan->Instance->RXF0S & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos;
+    else
+        hfdcan->Instance->RXF1A = (hfdcan->Instance->RXF1S & FDCAN_RXF1S_F1GI) >> FDCAN_RXF1S_F1GI_Pos;
+#endif
+}
+
+// Count the frames waiting in a rx FIFO that started after and before the given times (us timer, 16bit)
+__RAM_FUNC uint32_t msgram_count_rx_between(uint32_t fifo, uint16_t after_us, uint16_t before_us)
+{
+#ifdef MSGRAM_USE_HAL
+    return 0;   // The HAL driver only reads the oldest frame
+#else
+    FDCAN_HandleTypeDef *hfdcan = can_get_handle();
+    uint32_t status;
+    uint32_t level;
+    uint32_t index;
+    uint32_t base;
+    uint32_t count = 0;
+
+    if (fifo == FDCAN_RX_FIFO0)
+    {
+        status = hfdcan->Instance->RXF0S;
+        level = (status & FDCAN_RXF0S_F0FL) >> FDCAN_RXF0S_F0FL_Pos;
+        index = (status & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos;
+        base = hfdcan->msgRam.RxFIFO0SA;
+    }
+    else
+    {
+        status = hfdcan->Instance->RXF1S;
+        level = (status & FDCAN_RXF1S_F1FL) >> FDCAN_RXF1S_F1FL_Pos;
+        index = (status & FDCAN_RXF1S_F1GI) >> FDCAN_RXF1S_F1GI_Pos;
+        base = hfdcan->msgRam.RxFIFO1SA;
+    }
+
+    for (uint32_t i = 0; i < level; i++)
+    {
+        const uint32_t *element = (const uint32_t *)(base + ((index + i) % MSGRAM_RX_FIFO_SIZE) * MSGRAM_RX_ELEMENT_SIZE);
+        uint16_t timestamp = element[1] & MSGRAM_TS;
+        if (0 < (int16_t)(timestamp - after_us) && 0 < (int16_t)(before_us - timestamp))
+            count++;
+    }
+
+    return count;
+#endif
+}
+
+// Pull the oldest element from the tx event FIFO
+__RAM_FUNC HAL_StatusTypeDef msgram_get_tx_event(FDCAN_TxEventFifoTypeDef *event)
+{
+#ifdef MSGRAM_USE_HAL
+    return HAL_FDCAN_GetTxEvent(can_get_handle(), event);
+#else
+    FDCAN_HandleTypeDef *hfdcan = can_get_handle();
+    uint32_t status = hfdcan->Instance->TXEFS;
+    if ((status & FDCAN_TXEFS_EFFL) == 0) return HAL_ERROR;
+
+    uint32_t index = (status & FDCAN_TXEFS_EFGI) >> FDCAN_TXEFS_EFGI_Pos;
+    const uint32_t *element = (const uint32_t *)(hfdcan->msgRam.TxEventFIFOSA + index * MSGRAM_TX_EVENT_SIZE);
+    uint32_t word0 = element[0];
+    uint32_t word1 = element[1];
+    hfdcan->Instance->TXEFA = index;
+
+    event->IdType = word0 & MSGRAM_XTD;
+    if (event->IdType == FDCAN_STANDARD_ID)
+        event->Identifier = (word0 & MSGRAM_STDID) >> MSGRAM_STDID_POS;
+    else
+        event->Identifier = word0 & MSGRAM_EXTID;
+    event->TxFrameType = word0 & MSGRAM_RTR;
+    event->ErrorStateIndicator = word0 & MSGRAM_ESI;
+    event->TxTimestamp = word1 & MSGRAM_TS;
+    event->DataLength = (word1 & MSGRAM_DLC) >> MSGRAM_DLC_POS;
+    event->BitRateSwitch = word1 & MSGRAM_BRS;
+    event->FDFormat = word1 & MSGRAM_FDF;
+    event->EventType = word1 & MSGRAM_ET;
+    event->MessageMarker = (word1 & MSGRAM_MM) >> MSGRAM_MM_POS;
+
+    return HAL_OK;
+#endif
+}
+
+// Put a frame to the tx FIFO and request the transmission
+// The data must be word aligned and readable up to the next word boundary
+__RAM_FUNC HAL_StatusTypeDef msgram_add_tx(FDCAN_TxHeaderTypeDef *header, uint8_t *data)
+{
+#ifdef MSGRAM_USE_HAL
+    return HAL_FDCAN_AddMessageToTxFifoQ(can_get_handle(), header, data);
+#else
+    FDCAN_HandleTypeDef *hfdcan = can_get_handle();
+    uint32_t status = hfdcan->Instance->TXFQS;
+    if ((status & FDCAN_TXFQS_TFQF) != 0) return HAL_ERROR;
+
+    uint32_t index = (status & FDCAN_TXFQS_TFQPI) >> FDCAN_TXFQS_TFQPI_Pos;
+    uint32_t *element = (uint32_t *)(hfdcan->msgRam.TxFIFOQSA + index * MSGRAM_TX_ELEMENT_SIZE);
+
+    if (header->IdType == FDCAN_STANDARD_ID)
+        element[0] = header->ErrorStateIndicator | header->TxFrameType | (header->Identifier << MSGRAM_STDID_POS);
+    else
+        element[0] = header->ErrorStateIndicator | MSGRAM_XTD | header->TxFrameType | header->Identifier;
+    element[1] = (header->MessageMarker << MSGRAM_MM_POS) | header->TxEventFifoControl |
+                 header->FDFormat | header->BitRateSwitch | (header->DataLength << MSGRAM_DLC_POS);
+
+    // Little endian words, same layout as the message RAM
+    const uint32_t *word = (const uint32_t *)data;
+    uint8_t word_nbr = (can_dlc_to_bytes[header->DataLength & 0xF] + 3) / 4;
+    for (uint8_t i = 0; i < word_nbr; i++)
+        element[2 + i] = word[i];
+
+    hfdcan->Instance->TXBAR = 1UL << index;
+    hfdcan->LatestTxFifoQRequest = 1UL << index;
+
+    return HAL_OK;
+#endif
+}
@@ -24,8 +24,11 @@
 
 #include "stm32g0xx_hal.h"
 #include "can.h"
+#include "idset.h"
 #include "led.h"
 #include "nvm.h"
+#include "nvm_flash.h"
+#include "nvm_log.h"
 #include "slcan.h"
 
 // Memory status
@@ -35,15 +38,31 @@ enum nvm_memory_status
     NVM_MEMORY_CLEARED = 0xF    /* Flash memory store 0xFF when cleared */
 };
 
-#define NVM_PAGE_NUMBER_DATA      (62)                          /* Page number of data area (see RM0444-3.3.1) */
-#define NVM_ERASE_OK              (0xFFFFFFFF)
-#define NVM_ADDR_ORIGIN           (0x0801F000)                  /* Start address of data area in flash */
-#define NVM_ADDR_SERIAL_NUMBER    (NVM_ADDR_ORIGIN + 0x000UL)
-#define NVM_ADDR_STP_CONFIG       (NVM_ADDR_ORIGIN + 0x008UL)   /* Auto startup configuration */
-#define NVM_ADDR_STP_NOM_BITRATE  (NVM_ADDR_ORIGIN + 0x010UL)
-#define NVM_ADDR_STP_DATA_BITRATE (NVM_ADDR_ORIGIN + 0x018UL)
-#define NVM_ADDR_STP_FILTER_STD   (NVM_ADDR_ORIGIN + 0x020UL)
-#define NVM_ADDR_STP_FILTER_EXT   (NVM_ADDR_ORIGIN + 0x028UL)
+// Keys of a configuration profile
+enum nvm_profile_key
+{
+    NVM_PROFILE_KEY_CONFIG = 0, /* Nominal bitrate, open mode, timestamp mode and report register */
+    NVM_PROFILE_KEY_DATA,       /* Data bitrate and standard filter */
+    NVM_PROFILE_KEY_FILTER_EXT,
+
+    NVM_PROFILE_KEY_NBR
+};
+
+// Keys of the log store (also the double word index in the former fixed layout)
+enum nvm_key
+{
+    NVM_KEY_SERIAL_NUMBER = 0,
+    NVM_KEY_STP_CONFIG,         /* Auto startup configuration */
+    NVM_KEY_STP_NOM_BITRATE,
+    NVM_KEY_STP_DATA_BITRATE,
+    NVM_KEY_STP_FILTER_STD,
+    NVM_KEY_STP_FILTER_EXT,
+    NVM_KEY_PROFILE,            /* Configuration profiles, NVM_PROFILE_KEY_NBR keys each from profile 1 */
+
+    NVM_KEY_NBR = NVM_KEY_PROFILE + NVM_PROFILE_NBR * NVM_PROFILE_KEY_NBR
+};
+
+#define NVM_IDLE_TIME_MS          (100)                         /* Bus idle time to allow page erase */
 
 #define NVM_EXTRACT_MEM_STS(val)  ((uint8_t)(((val) >> 60) & 0x0F))
 #define NVM_IS_WRITTEN(val)       (NVM_EXTRACT_MEM_STS(val) == NVM_MEMORY_WRITTEN)
@@ -56,24 +75,53 @@ static uint64_t nvm_stp_nom_bitrate_raw;
 static uint64_t nvm_stp_data_bitrate_raw;
 static uint64_t nvm_stp_filter_std_raw;
 static uint64_t nvm_stp_filter_ext_raw;
+static uint64_t nvm_profile_raw[NVM_PROFILE_NBR][NVM_PROFILE_KEY_NBR];
 
 // Private methods
-static HAL_StatusTypeDef nvm_write_to_flash(void);
+static uint64_t nvm_read_raw(enum nvm_key key);
+static uint64_t nvm_make_bitrate_raw(struct can_bitrate_cfg bitrate);
+static struct can_bitrate_cfg nvm_read_bitrate_raw(uint64_t raw);
+static uint64_t nvm_make_filter_std_raw(void);
+static uint64_t nvm_make_filter_ext_raw(void);
+static void nvm_apply_filter_std_raw(uint64_t raw);
+static void nvm_apply_filter_ext_raw(uint64_t raw);
 
 // Read data from non-volatile memory and store it in RAM
 void nvm_init(void)
 {
-    // Read data form flash and store it in private variable (RAM)
-    nvm_serial_number_raw =     *(uint64_t *)NVM_ADDR_SERIAL_NUMBER;
-    nvm_stp_config_raw =        *(uint64_t *)NVM_ADDR_STP_CONFIG;
-    nvm_stp_nom_bitrate_raw =   *(uint64_t *)NVM_ADDR_STP_NOM_BITRATE;
-    nvm_stp_data_bitrate_raw =  *(uint64_t *)NVM_ADDR_STP_DATA_BITRATE;
-    nvm_stp_filter_std_raw =    *(uint64_t *)NVM_ADDR_STP_FILTER_STD;
-    nvm_stp_filter_ext_raw =    *(uint64_t *)NVM_ADDR_STP_FILTER_EXT;
+    // Import data of the former fixed layout in the first page, stored on the next compaction
+    if (nvm_log_init() != HAL_OK)
+    {
+        for (uint8_t key = 0; key < NVM_KEY_PROFILE; key++)
+        {
+            uint64_t raw = nvm_flash_read(0, key * sizeof(uint64_t));
+            if (NVM_IS_WRITTEN(raw)) nvm_log_write(key, raw);
+        }
+    }
+
+    // Read data and store it in private variable (RAM)
+    nvm_serial_number_raw =     nvm_read_raw(NVM_KEY_SERIAL_NUMBER);
+    nvm_stp_config_raw =        nvm_read_raw(NVM_KEY_STP_CONFIG);
+    nvm_stp_nom_bitrate_raw =   nvm_read_raw(NVM_KEY_STP_NOM_BITRATE);
+    nvm_stp_data_bitrate_raw =  nvm_read_raw(NVM_KEY_STP_DATA_BITRATE);
+    nvm_stp_filter_std_raw =    nvm_read_raw(NVM_KEY_STP_FILTER_STD);
+    nvm_stp_filter_ext_raw =    nvm_read_raw(NVM_KEY_STP_FILTER_EXT);
+    for (uint8_t i = 0; i < NVM_PROFILE_NBR; i++)
+        for (uint8_t j = 0; j < NVM_PROFILE_KEY_NBR; j++)
+            nvm_profile_raw[i][j] = nvm_read_raw(NVM_KEY_PROFILE + i * NVM_PROFILE_KEY_NBR + j);
 
     return;
 }
 
+// Run deferred flash tasks. Page erase stalls the CPU, so it waits for the bus to be closed or idle.
+void nvm_process(void)
+{
+    if (can_get_bus_state() == BUS_CLOSED || NVM_IDLE_TIME_MS <= can_get_idle_time_ms())
+        nvm_log_process(ENABLE);
+    else
+        nvm_log_process(DISABLE);
+}
+
 // Get serial number
 HAL_StatusTypeDef nvm_get_serial_number(uint16_t *num)
 {
@@ -96,7 +144,7 @@ HAL_StatusTypeDef nvm_update_serial_number(uint16_t num)
 
     // Write to the flash
     nvm_serial_number_raw = NVM_WRITE_MEM_STS(num);
-    if (nvm_write_to_flash() != HAL_OK)
+    if (nvm_log_write(NVM_KEY_SERIAL_NUMBER, nvm_serial_number_raw) != HAL_OK)
     {
         return HAL_ERROR;
     }
@@ -134,31 +182,12 @@ HAL_StatusTypeDef nvm_apply_startup_cfg(void)
     slcan_set_report_mode(report_reg);
 
     // Read and apply bitrate
-    struct can_bitrate_cfg bitrate;
-    bitrate.prescaler = (uint16_t)((nvm_stp_nom_bitrate_raw) & 0xFF);
-    bitrate.time_seg1 = (uint8_t)((nvm_stp_nom_bitrate_raw >> 8) & 0xFF);
-    bitrate.time_seg2 = (uint8_t)((nvm_stp_nom_bitrate_raw >> 16) & 0xFF);
-    bitrate.sjw = (uint8_t)((nvm_stp_nom_bitrate_raw >> 24) & 0xFF);
-    can_set_nominal_bitrate_cfg(bitrate);
-
-    bitrate.prescaler = (uint16_t)((nvm_stp_data_bitrate_raw) & 0xFF);
-    bitrate.time_seg1 = (uint8_t)((nvm_stp_data_bitrate_raw >> 8) & 0xFF);
-    bitrate.time_seg2 = (uint8_t)((nvm_stp_data_bitrate_raw >> 16) & 0xFF);
-    bitrate.sjw = (uint8_t)((nvm_stp_data_bitrate_raw >> 24) & 0xFF);
-    can_set_data_bitrate_cfg(bitrate);
+    can_set_nominal_bitrate_cfg(nvm_read_bitrate_raw(nvm_stp_nom_bitrate_raw));
+    can_set_data_bitrate_cfg(nvm_read_bitrate_raw(nvm_stp_data_bitrate_raw));
 
     // Read and apply filter
-    FunctionalState state;
-    uint32_t code, mask;
-    state = ((nvm_stp_filter_std_raw >> 22) & 0x1) ? ENABLE : DISABLE;
-    code = (nvm_stp_filter_std_raw & 0x7FF);
-    mask = ((nvm_stp_filter_std_raw >> 11) & 0x7FF);
-    can_set_filter_std(state, code, mask);
-
-    state = ((nvm_stp_filter_ext_raw >> 58) & 0x1) ? ENABLE : DISABLE;
-    code = (nvm_stp_filter_ext_raw & 0x1FFFFFFF);
-    mask = ((nvm_stp_filter_ext_raw >> 29) & 0x1FFFFFFF);
-    can_set_filter_ext(state, code, mask);
+    nvm_apply_filter_std_raw(nvm_stp_filter_std_raw);
+    nvm_apply_filter_ext_raw(nvm_stp_filter_ext_raw);
 
     // Start the CAN peripheral
     if (startup_mode == SLCAN_AUTO_STARTUP_NORMAL)
@@ -205,39 +234,15 @@ HAL_StatusTypeDef nvm_update_startup_cfg(uint8_t mode)
     startup_cfg = (startup_cfg | ((uint64_t)slcan_get_report_mode() << 16));
     startup_cfg = NVM_WRITE_MEM_STS(startup_cfg);
 
-    // Make raw data for nominal bitrate
-    uint64_t nom_bitrate = 0;
-
+    // Make raw data for bitrate
     if (0xFF < can_get_bitrate_cfg().prescaler) return HAL_ERROR;
-    nom_bitrate = (nom_bitrate | (uint64_t)can_get_bitrate_cfg().prescaler);
-    nom_bitrate = (nom_bitrate | ((uint64_t)can_get_bitrate_cfg().time_seg1 << 8));
-    nom_bitrate = (nom_bitrate | ((uint64_t)can_get_bitrate_cfg().time_seg2 << 16));
-    nom_bitrate = (nom_bitrate | ((uint64_t)can_get_bitrate_cfg().sjw << 24));
-    nom_bitrate = NVM_WRITE_MEM_STS(nom_bitrate);
-
-    // Make raw data for data bitrate
-    uint64_t data_bitrate = 0;
-
     if (0xFF < can_get_data_bitrate_cfg().prescaler) return HAL_ERROR;
-    data_bitrate = (data_bitrate | (uint64_t)can_get_data_bitrate_cfg().prescaler);
-    data_bitrate = (data_bitrate | ((uint64_t)can_get_data_bitrate_cfg().time_seg1 << 8));
-    data_bitrate = (data_bitrate | ((uint64_t)can_get_data_bitrate_cfg().time_seg2 << 16));
-    data_bitrate = (data_bitrate | ((uint64_t)can_get_data_bitrate_cfg().sjw << 24));
-    data_bitrate = NVM_WRITE_MEM_STS(data_bitrate);
-
-    // Make raw data for standard filter
-    uint64_t filter_std = 0;
-    filter_std = (filter_std | ((uint64_t)can_get_filter_std_code() & 0x7FF));
-    filter_std = (filter_std | (((uint64_t)can_get_filter_std_mask() & 0x7FF) << 11));
-    filter_std = (filter_std | ((uint64_t)(can_is_filter_std_enabled() == ENABLE) << 22));
-    filter_std = NVM_WRITE_MEM_STS(filter_std);
-
-    // Make raw data for extended filter
-    uint64_t filter_ext = 0;
-    filter_ext = (filter_ext | ((uint64_t)can_get_filter_ext_code() & 0x1FFFFFFF));
-    filter_ext = (filter_ext | (((uint64_t)can_get_filter_ext_mask() & 0x1FFFFFFF) << 29));
-    filter_ext = (filter_ext | ((uint64_t)(can_is_filter_ext_enabled() == ENABLE) << 58));
-    filter_ext = NVM_WRITE_MEM_STS(filter_ext);
+    uint64_t nom_bitrate = NVM_WRITE_MEM_STS(nvm_make_bitrate_raw(can_get_bitrate_cfg()));
+    uint64_t data_bitrate = NVM_WRITE_MEM_STS(nvm_make_bitrate_raw(can_get_data_bitrate_cfg()));
+
+    // Make raw data for filter
+    uint64_t filter_std = NVM_WRITE_MEM_STS(nvm_make_filter_std_raw());
+    uint64_t filter_ext = NVM_WRITE_MEM_STS(nvm_make_filter_ext_raw());
 
     // Check if the configuration is the same
     if (startup_cfg == nvm_stp_config_raw)
@@ -253,78 +258,157 @@ HAL_StatusTypeDef nvm_update_startup_cfg(uint8_t mode)
     nvm_stp_filter_ext_raw = filter_ext;
 
     // Write to the flash
-    if (nvm_write_to_flash() != HAL_OK)
-    {
-        return HAL_ERROR;
-    }
-    
+    if (nvm_log_write(NVM_KEY_STP_CONFIG, nvm_stp_config_raw) != HAL_OK) return HAL_ERROR;
+    if (nvm_log_write(NVM_KEY_STP_NOM_BITRATE, nvm_stp_nom_bitrate_raw) != HAL_OK) return HAL_ERROR;
+    if (nvm_log_write(NVM_KEY_STP_DATA_BITRATE, nvm_stp_data_bitrate_raw) != HAL_OK) return HAL_ERROR;
+    if (nvm_log_write(NVM_KEY_STP_FILTER_STD, nvm_stp_filter_std_raw) != HAL_OK) return HAL_ERROR;
+    if (nvm_log_write(NVM_KEY_STP_FILTER_EXT, nvm_stp_filter_ext_raw) != HAL_OK) return HAL_ERROR;
+
     return HAL_OK;
 }
 
-// Write the RAM data to the data area in the flash memory
-HAL_StatusTypeDef nvm_write_to_flash(void)
+// Apply a configuration profile, 0 for the default at power on, and return the mode to open the channel
+// The profile is checked before the channel is closed, so a bad profile leaves the settings as they are
+HAL_StatusTypeDef nvm_apply_profile(uint8_t idx, uint8_t *mode)
 {
-    // Unlock the flash
-    HAL_FLASH_Unlock();
-    
-    // Erase the page
-    FLASH_EraseInitTypeDef erase;
-    erase.TypeErase = FLASH_TYPEERASE_PAGES;
-    erase.Banks = FLASH_BANK_1;
-    erase.Page = NVM_PAGE_NUMBER_DATA;
-    erase.NbPages = 1;
-
-    uint32_t error = 0;
-    HAL_FLASHEx_Erase(&erase, &error);
-    if (error != NVM_ERASE_OK)
-    {
-        HAL_FLASH_Lock();
-        return HAL_ERROR;
-    }
+    if (NVM_PROFILE_NBR < idx) return HAL_ERROR;
 
-    // Write serial number to flash
-    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, NVM_ADDR_SERIAL_NUMBER, nvm_serial_number_raw) != HAL_OK)
+    // Same as the settings at power on except the channel is kept closed
+    if (idx == 0)
     {
-        HAL_FLASH_Lock();
-        return HAL_ERROR;
+        can_disable();
+        can_set_nominal_bitrate(CAN_BITRATE_125K);
+        can_set_data_bitrate(CAN_DATA_BITRATE_2M);
+        slcan_set_timestamp_mode(SLCAN_TIMESTAMP_OFF);
+        slcan_set_report_mode(1);   // Default: no timestamp, no ESI, no Tx, but with Rx
+        idset_set_state(DISABLE);
+        can_set_filter_std(ENABLE, 0, 0);
+        can_set_filter_ext(ENABLE, 0, 0);
+        *mode = SLCAN_AUTO_STARTUP_OFF;
+        return HAL_OK;
     }
 
-    // Write startup config to flash
-    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, NVM_ADDR_STP_CONFIG, nvm_stp_config_raw) != HAL_OK)
-    {
-        HAL_FLASH_Lock();
-        return HAL_ERROR;
-    }
+    uint64_t *raw = nvm_profile_raw[idx - 1];
+    for (uint8_t i = 0; i < NVM_PROFILE_KEY_NBR; i++)
+        if (!NVM_IS_WRITTEN(raw[i])) return HAL_ERROR;
 
-    // Write nominal bitrate to flash
-    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, NVM_ADDR_STP_NOM_BITRATE, nvm_stp_nom_bitrate_raw) != HAL_OK)
-    {
-        HAL_FLASH_Lock();
-        return HAL_ERROR;
-    }
+    uint8_t open_mode = (uint8_t)((raw[NVM_PROFILE_KEY_CONFIG] >> 32) & 0xFF);
+    uint8_t timestamp_mode = (uint8_t)((raw[NVM_PROFILE_KEY_CONFIG] >> 40) & 0x0F);
+    if (SLCAN_AUTO_STARTUP_INVALID <= open_mode || SLCAN_TIMESTAMP_INVALID <= timestamp_mode) return HAL_ERROR;
 
-    // Write data bitrate to flash
-    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, NVM_ADDR_STP_DATA_BITRATE, nvm_stp_data_bitrate_raw) != HAL_OK)
-    {
-        HAL_FLASH_Lock();
-        return HAL_ERROR;
-    }
+    struct can_bitrate_cfg nominal = nvm_read_bitrate_raw(raw[NVM_PROFILE_KEY_CONFIG]);
+    struct can_bitrate_cfg data = nvm_read_bitrate_raw(raw[NVM_PROFILE_KEY_DATA]);
+    if (can_check_nominal_bitrate_cfg(nominal) != HAL_OK) return HAL_ERROR;
+    if (can_check_data_bitrate_cfg(data) != HAL_OK) return HAL_ERROR;
 
-    // Write standard filter to flash
-    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, NVM_ADDR_STP_FILTER_STD, nvm_stp_filter_std_raw) != HAL_OK)
-    {
-        HAL_FLASH_Lock();
-        return HAL_ERROR;
-    }
+    // Nothing fails from here, the bitrate setting needs the channel closed
+    // The W mode is not stored, the profile always uses the simple filter
+    can_disable();
+    can_set_nominal_bitrate_cfg(nominal);
+    can_set_data_bitrate_cfg(data);
+    slcan_set_timestamp_mode(timestamp_mode);
+    slcan_set_report_mode((uint16_t)((raw[NVM_PROFILE_KEY_CONFIG] >> 44) & 0xFFFF));
+    idset_set_state(DISABLE);
+    nvm_apply_filter_std_raw(raw[NVM_PROFILE_KEY_DATA] >> 32);
+    nvm_apply_filter_ext_raw(raw[NVM_PROFILE_KEY_FILTER_EXT]);
+
+    *mode = open_mode;
+    return HAL_OK;
+}
+
+// Store the current settings as a configuration profile from 1, with the mode to open the channel
+HAL_StatusTypeDef nvm_update_profile(uint8_t idx, uint8_t mode)
+{
+    if (idx == 0 || NVM_PROFILE_NBR < idx) return HAL_ERROR;
+    if (SLCAN_AUTO_STARTUP_INVALID <= mode) return HAL_ERROR;
+    if (0xFF < can_get_bitrate_cfg().prescaler) return HAL_ERROR;
+    if (0xFF < can_get_data_bitrate_cfg().prescaler) return HAL_ERROR;
 
-    // Write extended filter to flash
-    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, NVM_ADDR_STP_FILTER_EXT, nvm_stp_filter_ext_raw) != HAL_OK)
+    // Pack into three keys, each with 60 bits of data
+    uint64_t raw[NVM_PROFILE_KEY_NBR];
+    raw[NVM_PROFILE_KEY_CONFIG] = nvm_make_bitrate_raw(can_get_bitrate_cfg());
+    raw[NVM_PROFILE_KEY_CONFIG] |= ((uint64_t)mode << 32);
+    raw[NVM_PROFILE_KEY_CONFIG] |= ((uint64_t)(slcan_get_timestamp_mode() & 0x0F) << 40);
+    raw[NVM_PROFILE_KEY_CONFIG] |= ((uint64_t)slcan_get_report_mode() << 44);
+    raw[NVM_PROFILE_KEY_DATA] = nvm_make_bitrate_raw(can_get_data_bitrate_cfg());
+    raw[NVM_PROFILE_KEY_DATA] |= (nvm_make_filter_std_raw() << 32);
+    raw[NVM_PROFILE_KEY_FILTER_EXT] = nvm_make_filter_ext_raw();
+
+    // Write only the keys changed
+    for (uint8_t i = 0; i < NVM_PROFILE_KEY_NBR; i++)
     {
-        HAL_FLASH_Lock();
-        return HAL_ERROR;
+        raw[i] = NVM_WRITE_MEM_STS(raw[i]);
+        if (raw[i] == nvm_profile_raw[idx - 1][i]) continue;
+
+        nvm_profile_raw[idx - 1][i] = raw[i];
+        if (nvm_log_write(NVM_KEY_PROFILE + (idx - 1) * NVM_PROFILE_KEY_NBR + i, raw[i]) != HAL_OK) return HAL_ERROR;
     }
 
-    // Lock the flash
-    HAL_FLASH_Lock();
     return HAL_OK;
 }
+
+// Make raw data of bitrate in 32 bits, the prescaler should be within 8 bits
+static uint64_t nvm_make_bitrate_raw(struct can_bitrate_cfg bitrate)
+{
+    uint64_t raw = 0;
+    raw = (raw | (uint64_t)(bitrate.prescaler & 0xFF));
+    raw = (raw | ((uint64_t)bitrate.time_seg1 << 8));
+    raw = (raw | ((uint64_t)bitrate.time_seg2 << 16));
+    raw = (raw | ((uint64_t)bitrate.sjw << 24));
+    return raw;
+}
+
+// Read bitrate from the lower 32 bits of raw data
+static struct can_bitrate_cfg nvm_read_bitrate_raw(uint64_t raw)
+{
+    struct can_bitrate_cfg bitrate;
+    bitrate.prescaler = (uint16_t)((raw) & 0xFF);
+    bitrate.time_seg1 = (uint8_t)((raw >> 8) & 0xFF);
+    bitrate.time_seg2 = (uint8_t)((raw >> 16) & 0xFF);
+    bitrate.sjw = (uint8_t)((raw >> 24) & 0xFF);
+    return bitrate;
+}
+
+// Make raw data of standard filter in 23 bits
+static uint64_t nvm_make_filter_std_raw(void)
+{
+    uint64_t raw = 0;
+    raw = (raw | ((uint64_t)can_get_filter_std_code() & 0x7FF));
+    raw = (raw | (((uint64_t)can_get_filter_std_mask() & 0x7FF) << 11));
+    raw = (raw | ((uint64_t)(can_is_filter_std_enabled() == ENABLE) << 22));
+    return raw;
+}
+
+// Make raw data of extended filter in 59 bits
+static uint64_t nvm_make_filter_ext_raw(void)
+{
+    uint64_t raw = 0;
+    raw = (raw | ((uint64_t)can_get_filter_ext_code() & 0x1FFFFFFF));
+    raw = (raw | (((uint64_t)can_get_filter_ext_mask() & 0x1FFFFFFF) << 29));
+    raw = (raw | ((uint64_t)(can_is_filter_ext_enabled() == ENABLE) << 58));
+    return raw;
+}
+
+// Apply standard filter from the lower 23 bits of raw data
+static void nvm_apply_filter_std_raw(uint64_t raw)
+{
+    FunctionalState state = ((raw >> 22) & 0x1) ? ENABLE : DISABLE;
+    can_set_filter_std(state, raw & 0x7FF, (raw >> 11) & 0x7FF);
+}
+
+// Apply extended filter from the lower 59 bits of raw data
+static void nvm_apply_filter_ext_raw(uint64_t raw)
+{
+    FunctionalState state = ((raw >> 58) & 0x1) ? ENABLE : DISABLE;
+    can_set_filter_ext(state, raw & 0x1FFFFFFF, (raw >> 29) & 0x1FFFFFFF);
+}
+
+// Read the raw data of the key, or cleared value if not written
+static uint64_t nvm_read_raw(enum nvm_key key)
+{
+    uint64_t raw;
+
+    if (nvm_log_read(key, &raw) != HAL_OK) return NVM_FLASH_ERASED;
+
+    return raw;
+}
@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+// Access the flash pages of the non-volatile memory on the device.
+// Replaced by a simulated backend for host tests.
+
+#include "stm32g0xx_hal.h"
+#include "nvm_flash.h"
+#include "trace.h"
+
+#define NVM_FLASH_PAGE_FIRST      (62)                          /* Page number of data area */
+#define NVM_FLASH_ADDR_ORIGIN     (0x0801F000)                  /* Start address of data area in flash */
+#define NVM_FLASH_ERASE_OK        (0xFFFFFFFF)
+
+// Read a double word
+uint64_t nvm_flash_read(uint8_t page, uint16_t offset)
+{
+    return *(uint64_t *)(NVM_FLASH_ADDR_ORIGIN + (uint32_t)page * NVM_FLASH_PAGE_SIZE + offset);
+}
+
+// Program a double word, which should be erased before
+HAL_StatusTypeDef nvm_flash_program(uint8_t page, uint16_t offset, uint64_t data)
+{
+    if (NVM_FLASH_PAGE_NBR <= page || NVM_FLASH_PAGE_SIZE <= offset) return HAL_ERROR;
+
+    TRACE(TRACE_FLASH_PROGRAM_START, (page << 16) | offset);
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef ret = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD,
+                                              NVM_FLASH_ADDR_ORIGIN + (uint32_t)page * NVM_FLASH_PAGE_SIZE + offset, data);
+    HAL_FLASH_Lock();
+    TRACE(TRACE_FLASH_PROGRAM_END, ret);
+
+    return ret;
+}
+
+// Erase a page (blocks the CPU for tens of milliseconds)
+HAL_StatusTypeDef nvm_flash_erase(uint8_t page)
+{
+    if (NVM_FLASH_PAGE_NBR <= page) return HAL_ERROR;
+
+    FLASH_EraseInitTypeDef erase;
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.Banks = FLASH_BANK_1;
+    erase.Page = NVM_FLASH_PAGE_FIRST + page;
+    erase.NbPages = 1;
+
+    uint32_t error = 0;
+    TRACE(TRACE_FLASH_ERASE_START, page);
+    HAL_FLASH_Unlock();
+    HAL_FLASHEx_Erase(&erase, &error);
+    HAL_FLASH_Lock();
+    TRACE(TRACE_FLASH_ERASE_END, error);
+
+    if (error != NVM_FLASH_ERASE_OK) return HAL_ERROR;
+
+    return HAL_OK;
+}
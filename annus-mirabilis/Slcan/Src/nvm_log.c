@@ -0,0 +1,299 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+// Log-structured store of 64-bit values over the flash pages of the non-volatile memory.
+// A write appends a record to the active page, so most writes need no erase.
+// When the active page runs out of slots, the latest values are copied to the next page
+// in slices (erase, one record per call, then the header) while the bus is idle.
+// A page becomes valid only when its header is written and a record only when its tag is written,
+// so a write interrupted by power loss falls back to the previous record or page.
+
+#include "stm32g0xx_hal.h"
+#include "nvm_flash.h"
+#include "nvm_log.h"
+
+// Page header: magic (upper 32bit) and generation (lower 32bit), written last on compaction
+#define NVM_LOG_HEADER_MAGIC      (0x4E564D4CUL)                /* "NVML" */
+#define NVM_LOG_HEADER_SIZE       (16)
+
+// Record: value followed by tag of magic (upper 16bit), key (next 8bit) and check code (lower 32bit)
+#define NVM_LOG_TAG_MAGIC         (0xA55AU)
+#define NVM_LOG_RECORD_SIZE       (16)
+#define NVM_LOG_SLOT_NBR          ((NVM_FLASH_PAGE_SIZE - NVM_LOG_HEADER_SIZE) / NVM_LOG_RECORD_SIZE)
+#define NVM_LOG_SLOT_RESERVE      (NVM_LOG_KEY_NBR)             /* Request compaction when free slots are fewer */
+#define NVM_LOG_SLOT_OFFSET(slot) ((uint16_t)(NVM_LOG_HEADER_SIZE + (slot) * NVM_LOG_RECORD_SIZE))
+
+#define NVM_LOG_PAGE_NONE         (0xFF)
+#define NVM_LOG_KEY_BIT(key)      (1UL << (key))
+
+// Compaction task
+enum nvm_log_task
+{
+    NVM_LOG_TASK_NONE,
+    NVM_LOG_TASK_ERASE,
+    NVM_LOG_TASK_COPY,
+    NVM_LOG_TASK_COMMIT
+};
+
+// Private variables
+static uint64_t nvm_log_value[NVM_LOG_KEY_NBR];
+static uint32_t nvm_log_valid;          /* Keys with a value */
+static uint32_t nvm_log_dirty;          /* Keys whose latest value is not in the active page */
+static uint8_t nvm_log_active_page;
+static uint32_t nvm_log_generation;
+static uint16_t nvm_log_next_slot;
+static uint8_t nvm_log_compact_request;
+static enum nvm_log_task nvm_log_task;
+static uint8_t nvm_log_target_page;
+static uint8_t nvm_log_copy_key;
+static uint16_t nvm_log_copy_slot;
+
+// Private methods
+static uint64_t nvm_log_make_tag(uint8_t key, uint64_t value);
+static uint8_t nvm_log_is_page_blank(uint8_t page);
+static HAL_StatusTypeDef nvm_log_append(uint8_t page, uint16_t slot, uint8_t key);
+static void nvm_log_process_compaction(void);
+
+// Find the latest valid page and replay its records
+HAL_StatusTypeDef nvm_log_init(void)
+{
+    nvm_log_valid = 0;
+    nvm_log_dirty = 0;
+    nvm_log_active_page = NVM_LOG_PAGE_NONE;
+    nvm_log_generation = 0;
+    nvm_log_next_slot = 0;
+    nvm_log_compact_request = 0;
+    nvm_log_task = NVM_LOG_TASK_NONE;
+
+    // Both pages are valid if the power was lost before erasing the old one
+    for (uint8_t page = 0; page < NVM_FLASH_PAGE_NBR; page++)
+    {
+        uint64_t header = nvm_flash_read(page, 0);
+        if ((uint32_t)(header >> 32) != NVM_LOG_HEADER_MAGIC) continue;
+
+        uint32_t generation = (uint32_t)header;
+        if (nvm_log_active_page == NVM_LOG_PAGE_NONE || 0 < (int32_t)(generation - nvm_log_generation))
+        {
+            nvm_log_active_page = page;
+            nvm_log_generation = generation;
+        }
+    }
+    if (nvm_log_active_page == NVM_LOG_PAGE_NONE) return HAL_ERROR;
+
+    // The last record of each key is the latest value
+    uint16_t slot;
+    for (slot = 0; slot < NVM_LOG_SLOT_NBR; slot++)
+    {
+        uint64_t value = nvm_flash_read(nvm_log_active_page, NVM_LOG_SLOT_OFFSET(slot));
+        uint64_t tag = nvm_flash_read(nvm_log_active_page, NVM_LOG_SLOT_OFFSET(slot) + 8);
+        if (value == NVM_FLASH_ERASED && tag == NVM_FLASH_ERASED) break;
+
+        // Skip a record interrupted by power loss
+        uint8_t key = (uint8_t)((tag >> 40) & 0xFF);
+        if (key < NVM_LOG_KEY_NBR && tag == nvm_log_make_tag(key, value))
+        {
+            nvm_log_value[key] = value;
+            nvm_log_valid |= NVM_LOG_KEY_BIT(key);
+        }
+    }
+    nvm_log_next_slot = slot;
+
+    if (NVM_LOG_SLOT_NBR - nvm_log_next_slot < NVM_LOG_SLOT_RESERVE) nvm_log_compact_request = 1;
+
+    return HAL_OK;
+}
+
+// Read the latest value of the key
+HAL_StatusTypeDef nvm_log_read(uint8_t key, uint64_t *value)
+{
+    if (NVM_LOG_KEY_NBR <= key) return HAL_ERROR;
+    if (!(nvm_log_valid & NVM_LOG_KEY_BIT(key))) return HAL_ERROR;
+
+    *value = nvm_log_value[key];
+    return HAL_OK;
+}
+
+// Write the value of the key
+// The value is appended to the active page right away, or kept in RAM until compaction if no slot is left.
+HAL_StatusTypeDef nvm_log_write(uint8_t key, uint64_t value)
+{
+    if (NVM_LOG_KEY_NBR <= key) return HAL_ERROR;
+
+    nvm_log_value[key] = value;
+    nvm_log_valid |= NVM_LOG_KEY_BIT(key);
+    nvm_log_dirty |= NVM_LOG_KEY_BIT(key);
+
+    if (nvm_log_active_page == NVM_LOG_PAGE_NONE || NVM_LOG_SLOT_NBR <= nvm_log_next_slot)
+    {
+        nvm_log_compact_request = 1;
+        return HAL_OK;
+    }
+
+    // A failed slot is skipped and the value is retried from nvm_log_process
+    HAL_StatusTypeDef ret = nvm_log_append(nvm_log_active_page, nvm_log_next_slot, key);
+    nvm_log_next_slot++;
+    if (NVM_LOG_SLOT_NBR - nvm_log_next_slot < NVM_LOG_SLOT_RESERVE) nvm_log_compact_request = 1;
+    if (ret != HAL_OK) return HAL_ERROR;
+
+    // During compaction, the key stays dirty to be written to the new page as well
+    if (nvm_log_task == NVM_LOG_TASK_NONE) nvm_log_dirty &= ~NVM_LOG_KEY_BIT(key);
+
+    return HAL_OK;
+}
+
+// Run deferred writes and compaction, one flash operation per call
+// Compaction erases a page, so it runs only while is_idle is ENABLE.
+void nvm_log_process(FunctionalState is_idle)
+{
+    if (nvm_log_task != NVM_LOG_TASK_NONE || nvm_log_compact_request)
+    {
+        if (is_idle == ENABLE) nvm_log_process_compaction();
+        return;
+    }
+
+    // Append a value left dirty by compaction or a failed write
+    if (nvm_log_dirty != 0)
+    {
+        if (nvm_log_active_page == NVM_LOG_PAGE_NONE || NVM_LOG_SLOT_NBR <= nvm_log_next_slot)
+        {
+            nvm_log_compact_request = 1;
+            return;
+        }
+
+        uint8_t key = 0;
+        while (!(nvm_log_dirty & NVM_LOG_KEY_BIT(key))) key++;
+
+        if (nvm_log_append(nvm_log_active_page, nvm_log_next_slot, key) == HAL_OK)
+            nvm_log_dirty &= ~NVM_LOG_KEY_BIT(key);
+        nvm_log_next_slot++;
+        if (NVM_LOG_SLOT_NBR - nvm_log_next_slot < NVM_LOG_SLOT_RESERVE) nvm_log_compact_request = 1;
+    }
+}
+
+// Return 1 if any value or compaction is waiting for nvm_log_process
+uint8_t nvm_log_is_pending(void)
+{
+    return (nvm_log_dirty != 0 || nvm_log_compact_request || nvm_log_task != NVM_LOG_TASK_NONE);
+}
+
+// Make the tag of a record to detect an incomplete write
+static uint64_t nvm_log_make_tag(uint8_t key, uint64_t value)
+{
+    // FNV-1a hash of the key and the value
+    uint32_t check = 2166136261UL;
+    check = (check ^ key) * 16777619UL;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        check = (check ^ (uint8_t)(value >> (8 * i))) * 16777619UL;
+    }
+
+    return ((uint64_t)NVM_LOG_TAG_MAGIC << 48) | ((uint64_t)key << 40) | check;
+}
+
+// Return 1 if the whole page is erased
+static uint8_t nvm_log_is_page_blank(uint8_t page)
+{
+    for (uint16_t offset = 0; offset < NVM_FLASH_PAGE_SIZE; offset += 8)
+    {
+        if (nvm_flash_read(page, offset) != NVM_FLASH_ERASED) return 0;
+    }
+    return 1;
+}
+
+// Write a record of the key, value first and tag last
+static HAL_StatusTypeDef nvm_log_append(uint8_t page, uint16_t slot, uint8_t key)
+{
+    uint64_t value = nvm_log_value[key];
+
+    if (nvm_flash_program(page, NVM_LOG_SLOT_OFFSET(slot), value) != HAL_OK) return HAL_ERROR;
+    if (nvm_flash_program(page, NVM_LOG_SLOT_OFFSET(slot) + 8, nvm_log_make_tag(key, value)) != HAL_OK) return HAL_ERROR;
+
+    return HAL_OK;
+}
+
+// Copy the latest values to the next page, one step per call
+// The old page stays valid until the header of the new page is written.
+static void nvm_log_process_compaction(void)
+{
+    switch (nvm_log_task)
+    {
+    case NVM_LOG_TASK_NONE:
+        // Without a valid page, keep the first page which may hold data of the former layout
+        if (nvm_log_active_page == NVM_LOG_PAGE_NONE)
+            nvm_log_target_page = NVM_FLASH_PAGE_NBR - 1;
+        else
+            nvm_log_target_page = (nvm_log_active_page + 1) % NVM_FLASH_PAGE_NBR;
+        nvm_log_task = NVM_LOG_TASK_ERASE;
+        break;
+
+    case NVM_LOG_TASK_ERASE:
+        // Retried on the next call if failed
+        if (!nvm_log_is_page_blank(nvm_log_target_page))
+        {
+            if (nvm_flash_erase(nvm_log_target_page) != HAL_OK)
+            {
+                nvm_log_task = NVM_LOG_TASK_NONE;
+                break;
+            }
+        }
+        nvm_log_copy_key = 0;
+        nvm_log_copy_slot = 0;
+        nvm_log_task = NVM_LOG_TASK_COPY;
+        break;
+
+    case NVM_LOG_TASK_COPY:
+        while (nvm_log_copy_key < NVM_LOG_KEY_NBR && !(nvm_log_valid & NVM_LOG_KEY_BIT(nvm_log_copy_key)))
+            nvm_log_copy_key++;
+
+        if (nvm_log_copy_key < NVM_LOG_KEY_NBR)
+        {
+            // A key written after this point gets dirty again
+            nvm_log_dirty &= ~NVM_LOG_KEY_BIT(nvm_log_copy_key);
+            if (nvm_log_append(nvm_log_target_page, nvm_log_copy_slot, nvm_log_copy_key) != HAL_OK)
+            {
+                nvm_log_dirty |= NVM_LOG_KEY_BIT(nvm_log_copy_key);
+                nvm_log_task = NVM_LOG_TASK_NONE;
+                break;
+            }
+            nvm_log_copy_key++;
+            nvm_log_copy_slot++;
+        }
+        else
+        {
+            nvm_log_task = NVM_LOG_TASK_COMMIT;
+        }
+        break;
+
+    case NVM_LOG_TASK_COMMIT:
+        if (nvm_flash_program(nvm_log_target_page, 0, ((uint64_t)NVM_LOG_HEADER_MAGIC << 32) | (nvm_log_generation + 1)) != HAL_OK)
+        {
+            nvm_log_task = NVM_LOG_TASK_NONE;
+            break;
+        }
+        nvm_log_active_page = nvm_log_target_page;
+        nvm_log_generation++;
+        nvm_log_next_slot = nvm_log_copy_slot;
+        nvm_log_compact_request = 0;
+        nvm_log_task = NVM_LOG_TASK_NONE;
+        break;
+    }
+}
@@ -27,9 +27,17 @@
 #include "bootloader.h"
 #include "buffer.h"
 #include "can.h"
+#include "diag.h"
+#include "event.h"
+#include "hist.h"
+#include "idset.h"
 #include "led.h"
+#include "load.h"
 #include "nvm.h"
+#include "payload.h"
+#include "qos.h"
 #include "slcan.h"
+#include "trace.h"
 
 // Filter mode
 enum slcan_filter_mode
@@ -37,6 +45,7 @@ enum slcan_filter_mode
     // SLCAN_FILTER_DUAL_MODE = 0,     // Not supported
     // SLCAN_FILTER_SINGLE_MODE,       // Not supported
     SLCAN_FILTER_SIMPLE_ID_MODE = 2,
+    SLCAN_FILTER_ID_SET_MODE,
 
     SLCAN_FILTER_INVALID
 };
@@ -52,7 +61,8 @@ static char *can_info = "I303C\r";
 static char *can_info_detail = "i: protocol=\"ISO-CANFD\", clock_mhz=60, controller=\"STM32G0B1CB\"\r";
 static uint32_t slcan_filter_code = 0x00000000;
 static uint32_t slcan_filter_mask = 0xFFFFFFFF;
-static uint8_t slcan_status_flags = 0;
+static volatile uint8_t slcan_status_flags = 0;   // Raised in interrupt too
+static enum buf_cdc_port slcan_detect_port = BUF_CDC_PORT_DATA;   // Port to reply the bitrate detection to
 
 // Private methods
 static HAL_StatusTypeDef slcan_convert_str_to_number(uint8_t *buf, uint8_t len);
@@ -60,6 +70,8 @@ static void slcan_parse_str_open(uint8_t *buf, uint8_t len);
 static void slcan_parse_str_loop(uint8_t *buf, uint8_t len);
 static void slcan_parse_str_close(uint8_t *buf, uint8_t len);
 static void slcan_parse_str_set_bitrate(uint8_t *buf, uint8_t len);
+static void slcan_parse_str_detect_bitrate(uint8_t *buf, uint8_t len);
+static void slcan_reply_detect_bitrate(HAL_StatusTypeDef status, enum can_bitrate_nominal nominal, enum can_bitrate_data data);
 static void slcan_parse_str_report_mode(uint8_t *buf, uint8_t len);
 static void slcan_parse_str_filter_mode(uint8_t *buf, uint8_t len);
 static void slcan_parse_str_filter_code(uint8_t *buf, uint8_t len);
@@ -70,9 +82,19 @@ static void slcan_parse_str_can_info(uint8_t *buf, uint8_t len);
 static void slcan_parse_str_number(uint8_t *buf, uint8_t len);
 static void slcan_parse_str_status(uint8_t *buf, uint8_t len);
 static void slcan_parse_str_auto_startup(uint8_t *buf, uint8_t len);
+static void slcan_parse_str_diag(uint8_t *buf, uint8_t len);
+static void slcan_parse_str_qos_rule(uint8_t *buf, uint8_t len);
+static void slcan_parse_str_payload_rule(uint8_t *buf, uint8_t len);
+static void slcan_parse_str_id_set(uint8_t *buf, uint8_t len);
+static void slcan_parse_str_latency(uint8_t *buf, uint8_t len);
+static void slcan_parse_str_trace(uint8_t *buf, uint8_t len);
+static void slcan_parse_str_load(uint8_t *buf, uint8_t len);
+static void slcan_parse_str_recovery(uint8_t *buf, uint8_t len);
+static void slcan_parse_str_recover(uint8_t *buf, uint8_t len);
+static void slcan_parse_str_profile(uint8_t *buf, uint8_t len);
 
 // Parse an incoming slcan command from the USB CDC port
-void slcan_parse_str(uint8_t *buf, uint8_t len)
+__RAM_FUNC void slcan_parse_str(uint8_t *buf, uint8_t len)
 {
     // Reply OK to a blank command
     if (len == 0)
@@ -112,6 +134,10 @@ void slcan_parse_str(uint8_t *buf, uint8_t len)
     case 'y':
         slcan_parse_str_set_bitrate(buf, len);
         return;
+    // Detect bitrate
+    case 'a':
+        slcan_parse_str_detect_bitrate(buf, len);
+        return;
     // Get version number in standard + detailed style
     case 'V':
     case 'v':
@@ -152,10 +178,54 @@ void slcan_parse_str(uint8_t *buf, uint8_t len)
     case '-':
         slcan_parse_str_set_auto_retransmit(buf, len);
         return;
-    // Set auto startup mode
+    // Set auto startup mode / get boot time
     case 'Q':
+    case 'q':
         slcan_parse_str_auto_startup(buf, len);
         return;
+    // Get / clear loss counters and buffer high-water marks
+    case 'J':
+    case 'j':
+        slcan_parse_str_diag(buf, len);
+        return;
+    // Set priority class rule
+    case 'K':
+        slcan_parse_str_qos_rule(buf, len);
+        return;
+    // Set payload filter rule
+    case 'G':
+        slcan_parse_str_payload_rule(buf, len);
+        return;
+    // Set / report ID set filter
+    case 'H':
+    case 'h':
+        slcan_parse_str_id_set(buf, len);
+        return;
+    // Clear / report latency histograms
+    case 'E':
+    case 'e':
+        slcan_parse_str_latency(buf, len);
+        return;
+    // Dump / restart event trace
+    case '#':
+        slcan_parse_str_trace(buf, len);
+        return;
+    // Set / read bus load telemetry
+    case 'l':
+        slcan_parse_str_load(buf, len);
+        return;
+    // Set bus off recovery / read bus off counters
+    case 'o':
+        slcan_parse_str_recovery(buf, len);
+        return;
+    // Recover from bus off
+    case 'u':
+        slcan_parse_str_recover(buf, len);
+        return;
+    // Apply / store configuration profile
+    case 'p':
+        slcan_parse_str_profile(buf, len);
+        return;
     // Enter firmware upgrade mode
     case 'X':
     	bootloader_enter_update_mode();
@@ -163,19 +233,32 @@ void slcan_parse_str(uint8_t *buf, uint8_t len)
     // Debug function
     case '?':
     {
-        uint8_t cycle_ave = (uint8_t)(can_get_cycle_ave_time_ns() >= 255000 ? 255 : can_get_cycle_ave_time_ns() / 1000);
-        uint8_t cycle_max = (uint8_t)(can_get_cycle_max_time_ns() >= 255000 ? 255 : can_get_cycle_max_time_ns() / 1000);
-        // "?XX-XX\r"
-        uint8_t dbgstr[7];
+        uint8_t cycle_ave = (uint8_t)(event_get_cycle_ave_time_ns() >= 255000 ? 255 : event_get_cycle_ave_time_ns() / 1000);
+        uint8_t cycle_max = (uint8_t)(event_get_cycle_max_time_ns() >= 255000 ? 255 : event_get_cycle_max_time_ns() / 1000);
+        uint16_t rx_latency = (uint16_t)(can_get_rx_latency_max_us() >= UINT16_MAX ? UINT16_MAX : can_get_rx_latency_max_us());
+        uint16_t rx_cycle = (uint16_t)(can_get_rx_cycle_ave() >= UINT16_MAX ? UINT16_MAX : can_get_rx_cycle_ave());
+        // "?XX-XX-XXXX-XXXX\r"
+        uint8_t dbgstr[17];
         dbgstr[0] = '?';
         dbgstr[1] = slcan_nibble_to_ascii[cycle_ave >> 4];
         dbgstr[2] = slcan_nibble_to_ascii[cycle_ave & 0xF];
         dbgstr[3] = '-';
         dbgstr[4] = slcan_nibble_to_ascii[cycle_max >> 4];
         dbgstr[5] = slcan_nibble_to_ascii[cycle_max & 0xF];
-        dbgstr[6] = '\r';
-        buf_enqueue_cdc(dbgstr, strlen((char *)dbgstr));
-        can_clear_cycle_time();
+        dbgstr[6] = '-';
+        dbgstr[7] = slcan_nibble_to_ascii[(rx_latency >> 12) & 0xF];
+        dbgstr[8] = slcan_nibble_to_ascii[(rx_latency >> 8) & 0xF];
+        dbgstr[9] = slcan_nibble_to_ascii[(rx_latency >> 4) & 0xF];
+        dbgstr[10] = slcan_nibble_to_ascii[rx_latency & 0xF];
+        dbgstr[11] = '-';
+        dbgstr[12] = slcan_nibble_to_ascii[(rx_cycle >> 12) & 0xF];
+        dbgstr[13] = slcan_nibble_to_ascii[(rx_cycle >> 8) & 0xF];
+        dbgstr[14] = slcan_nibble_to_ascii[(rx_cycle >> 4) & 0xF];
+        dbgstr[15] = slcan_nibble_to_ascii[rx_cycle & 0xF];
+        dbgstr[16] = '\r';
+        buf_enqueue_cdc(dbgstr, sizeof(dbgstr));
+        event_clear_cycle_time();
+        can_clear_rx_latency();
         return;
     }
     default:
@@ -198,7 +281,7 @@ void slcan_parse_str(uint8_t *buf, uint8_t len)
     frame_header->BitRateSwitch = FDCAN_BRS_OFF;                 // no bitrate switch
     frame_header->ErrorStateIndicator = FDCAN_ESI_ACTIVE;        // error active
     frame_header->TxEventFifoControl = FDCAN_STORE_TX_EVENTS;    // record tx events
-    frame_header->MessageMarker = 0;                             // not used
+    frame_header->MessageMarker = 0;                             // set when queued
 
     // Handle each incoming command (transmit)
     switch (buf[0])
@@ -396,7 +479,8 @@ void slcan_parse_str_open(uint8_t *buf, uint8_t len)
     }
 
     slcan_status_flags = 0;
-    can_clear_cycle_time();
+    event_clear_cycle_time();
+    slcan_clear_sequence();
 
     if (buf[0] == 'O')
     {
@@ -436,7 +520,8 @@ void slcan_parse_str_loop(uint8_t *buf, uint8_t len)
     }
 
     slcan_status_flags = 0;
-    can_clear_cycle_time();
+    event_clear_cycle_time();
+    slcan_clear_sequence();
 
     // Mode loopback
     if (buf[0] == '+')
@@ -480,15 +565,37 @@ void slcan_parse_str_close(uint8_t *buf, uint8_t len)
         buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
 
     slcan_status_flags = 0;
-    can_clear_cycle_time();
+    event_clear_cycle_time();
 
     return;
 }
 
-// Set nominal bitrate
+// Set or get bitrate
 void slcan_parse_str_set_bitrate(uint8_t *buf, uint8_t len)
 {
-    if (buf[0] == 'S' || buf[0] == 'Y')
+    if ((buf[0] == 'S' || buf[0] == 'Y') && len == 12)
+    {
+        // Solve bit timing: Sxxxxxxyyyzz[CR], bitrate xxxxxx, sample point yyy permille, sjw zz
+        uint32_t bitrate = 0;
+        for (uint8_t i = 1; i <= 6; i++)
+        {
+            bitrate = (bitrate << 4) + buf[i];
+        }
+        uint16_t sample_point = ((uint16_t)buf[7] << 8) + ((uint16_t)buf[8] << 4) + buf[9];
+        uint8_t sjw = ((uint8_t)buf[10] << 4) + buf[11];
+
+        HAL_StatusTypeDef ret;
+        if (buf[0] == 'S')
+            ret = can_set_nominal_bitrate_target(bitrate, sample_point, sjw);
+        else
+            ret = can_set_data_bitrate_target(bitrate, sample_point, sjw);
+
+        if (ret == HAL_OK)
+            buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+        else
+            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+    }
+    else if (buf[0] == 'S' || buf[0] == 'Y')
     {
         // Check for valid length
         if (len != 2)
@@ -507,6 +614,29 @@ void slcan_parse_str_set_bitrate(uint8_t *buf, uint8_t len)
         else
             buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
     }
+    else if ((buf[0] == 's' || buf[0] == 'y') && len == 1)
+    {
+        // Report bit timing in the same format as the setting
+        struct can_bitrate_cfg bitrate_cfg;
+        if (buf[0] == 's')
+            bitrate_cfg = can_get_bitrate_cfg();
+        else
+            bitrate_cfg = can_get_data_bitrate_cfg();
+
+        uint8_t *cfgstr = buf_get_cdc_dest();
+        if (cfgstr == NULL) return;
+        cfgstr[0] = buf[0];
+        cfgstr[1] = slcan_nibble_to_ascii[(bitrate_cfg.prescaler >> 4) & 0xF];
+        cfgstr[2] = slcan_nibble_to_ascii[bitrate_cfg.prescaler & 0xF];
+        cfgstr[3] = slcan_nibble_to_ascii[bitrate_cfg.time_seg1 >> 4];
+        cfgstr[4] = slcan_nibble_to_ascii[bitrate_cfg.time_seg1 & 0xF];
+        cfgstr[5] = slcan_nibble_to_ascii[bitrate_cfg.time_seg2 >> 4];
+        cfgstr[6] = slcan_nibble_to_ascii[bitrate_cfg.time_seg2 & 0xF];
+        cfgstr[7] = slcan_nibble_to_ascii[bitrate_cfg.sjw >> 4];
+        cfgstr[8] = slcan_nibble_to_ascii[bitrate_cfg.sjw & 0xF];
+        cfgstr[9] = '\r';
+        buf_comit_cdc_dest(10);
+    }
     else if (buf[0] == 's' || buf[0] == 'y')
     {
         // Check for valid length
@@ -536,6 +666,42 @@ void slcan_parse_str_set_bitrate(uint8_t *buf, uint8_t len)
     return;
 }
 
+// Detect bitrate of the bus in bus monitoring mode
+static void slcan_parse_str_detect_bitrate(uint8_t *buf, uint8_t len)
+{
+    // Command can only be sent if the device is initiated but not open.
+    if (len != 1 || can_get_bus_state() != BUS_CLOSED)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
+
+    // The reply is sent when the detection ends, other commands are handled meanwhile
+    slcan_detect_port = buf_get_cdc_dest_port();
+    if (can_detect_bitrate(slcan_reply_detect_bitrate) != HAL_OK)
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+}
+
+// Reply the result of the bitrate detection to the port of the command
+static void slcan_reply_detect_bitrate(HAL_StatusTypeDef status, enum can_bitrate_nominal nominal, enum can_bitrate_data data)
+{
+    if (status != HAL_OK)
+    {
+        buf_enqueue_cdc_port(slcan_detect_port, SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
+
+    // Reply aN[CR] or aNM[CR] in the index of Sn and Yn
+    uint8_t detstr[4];
+    uint8_t idx = 0;
+    detstr[idx++] = 'a';
+    detstr[idx++] = slcan_nibble_to_ascii[nominal & 0xF];
+    if (data != CAN_DATA_BITRATE_INVALID)
+        detstr[idx++] = slcan_nibble_to_ascii[data & 0xF];
+    detstr[idx++] = '\r';
+    buf_enqueue_cdc_port(slcan_detect_port, detstr, idx);
+}
+
 // Set report mode
 void slcan_parse_str_report_mode(uint8_t *buf, uint8_t len)
 {
@@ -621,9 +787,9 @@ void slcan_parse_str_report_mode(uint8_t *buf, uint8_t len)
         }
         else
         {
-			uint8_t cycle_ave = (uint8_t)(can_get_cycle_ave_time_ns() >= 255000 ? 255 : can_get_cycle_ave_time_ns() / 1000);
-			uint8_t cycle_max = (uint8_t)(can_get_cycle_max_time_ns() >= 255000 ? 255 : can_get_cycle_max_time_ns() / 1000);
-			can_clear_cycle_time();
+			uint8_t cycle_ave = (uint8_t)(event_get_cycle_ave_time_ns() >= 255000 ? 255 : event_get_cycle_ave_time_ns() / 1000);
+			uint8_t cycle_max = (uint8_t)(event_get_cycle_max_time_ns() >= 255000 ? 255 : event_get_cycle_max_time_ns() / 1000);
+			event_clear_cycle_time();
 
 			timstr = buf_get_cdc_dest();
 	        timstr[0] = slcan_nibble_to_ascii[cycle_ave >> 4];
@@ -643,42 +809,35 @@ void slcan_parse_str_report_mode(uint8_t *buf, uint8_t len)
         return;
     }
 
-    // Set report mode
-    if (can_get_bus_state() == BUS_CLOSED)
+    // Set report mode, also while open as the frames are reported in the same loop as the commands are parsed
+    if (buf[0] == 'Z')
     {
-        if (buf[0] == 'Z')
+        // Check for valid command
+        if (len != 2 || SLCAN_TIMESTAMP_INVALID <= buf[1])
         {
-            // Check for valid command
-            if (len != 2 || SLCAN_TIMESTAMP_INVALID <= buf[1])
-            {
-                buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
-                return;
-            }
-
-            slcan_timestamp_mode = buf[1];
-            slcan_report_reg = 1;   // Default: no timestamp, no ESI, no Tx, but with Rx
-            buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
             return;
         }
-        else if (buf[0] == 'z')
+
+        slcan_timestamp_mode = buf[1];
+        slcan_report_reg = 1;   // Default: no timestamp, no ESI, no Tx, but with Rx
+        slcan_bind_generator();
+        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+        return;
+    }
+    else if (buf[0] == 'z')
+    {
+        // Check for valid command
+        if (len != 5 || SLCAN_TIMESTAMP_INVALID <= buf[1])
         {
-            // Check for valid command
-            if (len != 5 || SLCAN_TIMESTAMP_INVALID <= buf[1])
-            {
-                buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
-                return;
-            }
-
-            slcan_timestamp_mode = buf[1];
-            slcan_report_reg = (buf[3] << 4) + buf[4];
-            buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
             return;
         }
-    }
-    // This command is only active if the CAN channel is closed.
-    else
-    {
-        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+
+        slcan_timestamp_mode = buf[1];
+        slcan_report_reg = (buf[3] << 4) + buf[4];
+        slcan_bind_generator();
+        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
         return;
     }
 }
@@ -686,138 +845,116 @@ void slcan_parse_str_report_mode(uint8_t *buf, uint8_t len)
 // Set filter mode
 void slcan_parse_str_filter_mode(uint8_t *buf, uint8_t len)
 {
-    // Set filter mode
-    if (can_get_bus_state() == BUS_CLOSED)
+    // Check for valid command
+    if (len != 2 || SLCAN_FILTER_INVALID <= buf[1])
     {
-        // Check for valid command
-        if (len != 2 || SLCAN_FILTER_INVALID <= buf[1])
-        {
-            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
-            return;
-        }
-
-        // Check if the filter mode is supported
-        if (buf[1] != SLCAN_FILTER_SIMPLE_ID_MODE)
-        {
-            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
-            return;
-        }
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
 
-        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+    // Check if the filter mode is supported
+    if (buf[1] != SLCAN_FILTER_SIMPLE_ID_MODE && buf[1] != SLCAN_FILTER_ID_SET_MODE)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
         return;
     }
-    // Command can only be sent if CAN232 is initiated but not open.
-    else
+
+    // Applied to the running controller if the channel is open
+    idset_set_state(buf[1] == SLCAN_FILTER_ID_SET_MODE ? ENABLE : DISABLE);
+    if (can_reload_filter() != HAL_OK)
     {
         buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
         return;
     }
+    buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
 }
 
 
 // Set filter code
 void slcan_parse_str_filter_code(uint8_t *buf, uint8_t len)
 {
-    // Set filter code
-    if (can_get_bus_state() == BUS_CLOSED)
+    // Applied to the running controller if the channel is open
+
+    // Check for valid command
+    if (len != 9)
     {
-        // Check for valid command
-        if (len != 9)
-        {
-            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
-            return;
-        }
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
 
-        slcan_filter_code = 0;
-        for (uint8_t i = 0; i < 8; i++)
-        {
-            slcan_filter_code = (slcan_filter_code << 4) + buf[1 + i];
-        }
-        
-        FunctionalState state_std = ENABLE;
-        FunctionalState state_ext = ENABLE;
-        if ((slcan_filter_code >> 31) && !(slcan_filter_mask >> 31))
-        {
-            state_ext = DISABLE;
-        }
-        else if (!(slcan_filter_code >> 31) && !(slcan_filter_mask >> 31))
-        {
-            state_std = DISABLE;
-        }
+    slcan_filter_code = 0;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        slcan_filter_code = (slcan_filter_code << 4) + buf[1 + i];
+    }
+    
+    FunctionalState state_std = ENABLE;
+    FunctionalState state_ext = ENABLE;
+    if ((slcan_filter_code >> 31) && !(slcan_filter_mask >> 31))
+    {
+        state_ext = DISABLE;
+    }
+    else if (!(slcan_filter_code >> 31) && !(slcan_filter_mask >> 31))
+    {
+        state_std = DISABLE;
+    }
 
-        // Mask definition, SLCAN: 0 -> Enable, STM32: 1 -> Enable
-        if (can_set_filter_std(state_std, slcan_filter_code & 0x7FF, (~slcan_filter_mask) & 0x7FF) != HAL_OK)
-        {
-            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
-            return;
-        }
-        if (can_set_filter_ext(state_ext, slcan_filter_code & 0x1FFFFFFF, (~slcan_filter_mask) & 0x1FFFFFFF) != HAL_OK)
-        {
-            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
-            return;
-        }
-        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+    // Mask definition, SLCAN: 0 -> Enable, STM32: 1 -> Enable
+    if (can_set_filter_std(state_std, slcan_filter_code & 0x7FF, (~slcan_filter_mask) & 0x7FF) != HAL_OK)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
         return;
     }
-    // This command is only active if the CAN channel is initiated and not opened.
-    else
+    if (can_set_filter_ext(state_ext, slcan_filter_code & 0x1FFFFFFF, (~slcan_filter_mask) & 0x1FFFFFFF) != HAL_OK)
     {
         buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
         return;
     }
+    buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
 }
 
 
 // Set filter mask
 void slcan_parse_str_filter_mask(uint8_t *buf, uint8_t len)
 {
-    // Set filter code
-    if (can_get_bus_state() == BUS_CLOSED)
+    // Applied to the running controller if the channel is open
+
+    // Check for valid command
+    if (len != 9)
     {
-        // Check for valid command
-        if (len != 9)
-        {
-            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
-            return;
-        }
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
 
-        slcan_filter_mask = 0;
-        for (uint8_t i = 0; i < 8; i++)
-        {
-            slcan_filter_mask = (slcan_filter_mask << 4) + buf[1 + i];
-        }
+    slcan_filter_mask = 0;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        slcan_filter_mask = (slcan_filter_mask << 4) + buf[1 + i];
+    }
 
-        FunctionalState state_std = ENABLE;
-        FunctionalState state_ext = ENABLE;
-        if ((slcan_filter_code >> 31) && !(slcan_filter_mask >> 31))
-        {
-            state_ext = DISABLE;
-        }
-        else if (!(slcan_filter_code >> 31) && !(slcan_filter_mask >> 31))
-        {
-            state_std = DISABLE;
-        }
+    FunctionalState state_std = ENABLE;
+    FunctionalState state_ext = ENABLE;
+    if ((slcan_filter_code >> 31) && !(slcan_filter_mask >> 31))
+    {
+        state_ext = DISABLE;
+    }
+    else if (!(slcan_filter_code >> 31) && !(slcan_filter_mask >> 31))
+    {
+        state_std = DISABLE;
+    }
 
-        // Mask definition, SLCAN: 0 -> Enable, STM32: 1 -> Enable
-        if (can_set_filter_std(state_std, slcan_filter_code & 0x7FF, (~slcan_filter_mask) & 0x7FF) != HAL_OK)
-        {
-            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
-            return;
-        }
-        if (can_set_filter_ext(state_ext, slcan_filter_code & 0x1FFFFFFF, (~slcan_filter_mask) & 0x1FFFFFFF) != HAL_OK)
-        {
-            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
-            return;
-        }
-        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+    // Mask definition, SLCAN: 0 -> Enable, STM32: 1 -> Enable
+    if (can_set_filter_std(state_std, slcan_filter_code & 0x7FF, (~slcan_filter_mask) & 0x7FF) != HAL_OK)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
         return;
     }
-    // This command is only active if the CAN channel is initiated and not opened.
-    else
+    if (can_set_filter_ext(state_ext, slcan_filter_code & 0x1FFFFFFF, (~slcan_filter_mask) & 0x1FFFFFFF) != HAL_OK)
     {
         buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
         return;
     }
+    buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
 }
 
 // Set auto retransmit
@@ -826,15 +963,24 @@ static void slcan_parse_str_set_auto_retransmit(uint8_t *buf, uint8_t len)
     // Set auto retransmit
     if (can_get_bus_state() == BUS_CLOSED)
     {
-        // Check for valid command
-        if (len != 2 || 2 <= buf[1])
+        // Check for valid command, optionally with retry limit and expiry time
+        if ((len != 2 && len != 8) || 2 <= buf[1])
         {
             buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
             return;
         }
 
+        uint8_t retry_limit = 0;
+        uint16_t expiry_ms = 0;
+        if (len == 8)
+        {
+            retry_limit = (buf[2] << 4) + buf[3];
+            expiry_ms = (buf[4] << 12) + (buf[5] << 8) + (buf[6] << 4) + buf[7];
+        }
+
         // Apply the state
-        if (can_set_auto_retransmit((buf[1] == 0) ? DISABLE : ENABLE) != HAL_OK)
+        if (can_set_auto_retransmit((buf[1] == 0) ? DISABLE : ENABLE) != HAL_OK ||
+            can_set_tx_limit(retry_limit, expiry_ms) != HAL_OK)
         {
             buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
             return;
@@ -938,15 +1084,18 @@ void slcan_parse_str_status(uint8_t *buf, uint8_t len)
     {
         if (buf[0] == 'F')
         {
+            // This command also clear the RED Error LED.
+            __disable_irq();
+            uint8_t status_flags = slcan_status_flags;
+            slcan_status_flags = 0;
+            __enable_irq();
+
             uint8_t* stsstr = buf_get_cdc_dest();
             stsstr[0] = 'F';
-            stsstr[1] = slcan_nibble_to_ascii[slcan_status_flags >> 4];
-            stsstr[2] = slcan_nibble_to_ascii[slcan_status_flags & 0xF];
+            stsstr[1] = slcan_nibble_to_ascii[status_flags >> 4];
+            stsstr[2] = slcan_nibble_to_ascii[status_flags & 0xF];
             stsstr[3] = '\r';
             buf_comit_cdc_dest(4);
-
-            // This command also clear the RED Error LED.
-            slcan_status_flags = 0;
         }
         else if (buf[0] == 'f')
         {
@@ -981,6 +1130,28 @@ void slcan_parse_str_status(uint8_t *buf, uint8_t len)
 // Set auto startup mode
 void slcan_parse_str_auto_startup(uint8_t *buf, uint8_t len)
 {
+    // Report time from boot to the first bus open
+    if (buf[0] == 'q')
+    {
+        if (len != 1)
+        {
+            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+            return;
+        }
+
+        char *timestr = (char*)buf_get_cdc_dest();
+        if (timestr == NULL) return;
+
+        uint32_t time_us = can_get_boot_to_open_time_us();
+        int32_t ret;
+        if (time_us == CAN_BOOT_TO_OPEN_NONE)
+            ret = snprintf(timestr, SLCAN_MTU - 1, "q: boot_to_open_us=NONE\r");
+        else
+            ret = snprintf(timestr, SLCAN_MTU - 1, "q: boot_to_open_us=%lu\r", (unsigned long)time_us);
+        if (0 < ret) buf_comit_cdc_dest(ret);
+        return;
+    }
+
     // Set auto startup mode
     if (can_get_bus_state() == BUS_OPENED)
     {
@@ -1008,7 +1179,11 @@ void slcan_parse_str_auto_startup(uint8_t *buf, uint8_t len)
 
 void slcan_raise_error(enum slcan_status_flag err)
 {
+    // Callable from interrupt, keep the read-modify-write atomic
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
     slcan_status_flags |= (uint8_t)(1 << err);
+    __set_PRIMASK(primask);
 }
 
 void slcan_clear_error(void)
@@ -1020,3 +1195,452 @@ uint8_t slcan_get_status_flags(void)
 {
     return slcan_status_flags;
 }
+
+// Get / clear loss counters and buffer high-water marks
+static void slcan_parse_str_diag(uint8_t *buf, uint8_t len)
+{
+    // Check command length
+    if (len != 1)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
+
+    // Clear all
+    if (buf[0] == 'J')
+    {
+        diag_clear();
+        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+        return;
+    }
+
+    // Report in parts to fit in the MTU
+    char *diagstr;
+    int32_t ret;
+
+    diagstr = (char *)buf_get_cdc_dest();
+    if (diagstr == NULL) return;
+    ret = snprintf(diagstr, SLCAN_MTU - 1, "j: loss_can_rx0_rx1_txe=[0x%08lX, 0x%08lX, 0x%08lX], loss_can_tx_queue_add=[0x%08lX, 0x%08lX]",
+                   (unsigned long)diag_get_loss(DIAG_LOSS_CAN_RX_FIFO0),
+                   (unsigned long)diag_get_loss(DIAG_LOSS_CAN_RX_FIFO1),
+                   (unsigned long)diag_get_loss(DIAG_LOSS_CAN_TX_EVENT),
+                   (unsigned long)diag_get_loss(DIAG_LOSS_CAN_TX_QUEUE),
+                   (unsigned long)diag_get_loss(DIAG_LOSS_CAN_TX_ADD));
+    if (0 < ret) buf_comit_cdc_dest(ret);
+
+    diagstr = (char *)buf_get_cdc_dest();
+    if (diagstr == NULL) return;
+    ret = snprintf(diagstr, SLCAN_MTU - 1, ", loss_cdc_rx_data_ctrl=[0x%08lX, 0x%08lX], loss_cdc_tx_data_ctrl=[0x%08lX, 0x%08lX]",
+                   (unsigned long)diag_get_loss(DIAG_LOSS_CDC_RX_DATA),
+                   (unsigned long)diag_get_loss(DIAG_LOSS_CDC_RX_CTRL),
+                   (unsigned long)diag_get_loss(DIAG_LOSS_CDC_TX_DATA),
+                   (unsigned long)diag_get_loss(DIAG_LOSS_CDC_TX_CTRL));
+    if (0 < ret) buf_comit_cdc_dest(ret);
+
+    diagstr = (char *)buf_get_cdc_dest();
+    if (diagstr == NULL) return;
+    ret = snprintf(diagstr, SLCAN_MTU - 1, ", loss_shed_class0_3=[0x%08lX, 0x%08lX, 0x%08lX, 0x%08lX]",
+                   (unsigned long)diag_get_loss(DIAG_LOSS_SHED_CLASS0),
+                   (unsigned long)diag_get_loss(DIAG_LOSS_SHED_CLASS1),
+                   (unsigned long)diag_get_loss(DIAG_LOSS_SHED_CLASS2),
+                   (unsigned long)diag_get_loss(DIAG_LOSS_SHED_CLASS3));
+    if (0 < ret) buf_comit_cdc_dest(ret);
+
+    diagstr = (char *)buf_get_cdc_dest();
+    if (diagstr == NULL) return;
+    ret = snprintf(diagstr, SLCAN_MTU - 1, ", peak_can_rx0_rx1_txe_tx=[0x%04lX, 0x%04lX, 0x%04lX, 0x%04lX], peak_can_tx_queue=0x%04lX",
+                   (unsigned long)diag_get_peak(DIAG_PEAK_CAN_RX_FIFO0),
+                   (unsigned long)diag_get_peak(DIAG_PEAK_CAN_RX_FIFO1),
+                   (unsigned long)diag_get_peak(DIAG_PEAK_CAN_TX_EVENT),
+                   (unsigned long)diag_get_peak(DIAG_PEAK_CAN_TX_FIFO),
+                   (unsigned long)diag_get_peak(DIAG_PEAK_CAN_TX_QUEUE));
+    if (0 < ret) buf_comit_cdc_dest(ret);
+
+    diagstr = (char *)buf_get_cdc_dest();
+    if (diagstr == NULL) return;
+    ret = snprintf(diagstr, SLCAN_MTU - 1, ", peak_cdc_rx_data_ctrl=[0x%04lX, 0x%04lX], peak_cdc_tx_data_ctrl=[0x%04lX, 0x%04lX]\r",
+                   (unsigned long)diag_get_peak(DIAG_PEAK_CDC_RX_DATA),
+                   (unsigned long)diag_get_peak(DIAG_PEAK_CDC_RX_CTRL),
+                   (unsigned long)diag_get_peak(DIAG_PEAK_CDC_TX_DATA),
+                   (unsigned long)diag_get_peak(DIAG_PEAK_CDC_TX_CTRL));
+    if (0 < ret) buf_comit_cdc_dest(ret);
+}
+
+// Set priority class rule
+static void slcan_parse_str_qos_rule(uint8_t *buf, uint8_t len)
+{
+    // Clear the rule
+    if (len == 2)
+    {
+        if (qos_set_rule(buf[1], DISABLE, 0, 0) != HAL_OK)
+            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        else
+            buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+        return;
+    }
+
+    // Check command length
+    if (len != 18)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
+
+    // Code and mask in the format of the simple filter mode
+    uint32_t code = 0;
+    uint32_t mask = 0;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        code = (code << 4) + buf[2 + i];
+        mask = (mask << 4) + buf[10 + i];
+    }
+
+    if (qos_set_rule(buf[1], ENABLE, code, mask) != HAL_OK)
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+    else
+        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+}
+
+// Set payload filter rule
+static void slcan_parse_str_payload_rule(uint8_t *buf, uint8_t len)
+{
+    // Clear the rule
+    if (len == 2)
+    {
+        if (payload_clear_rule(buf[1]) != HAL_OK)
+            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        else
+            buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+        return;
+    }
+
+    // Check command length
+    if (len != 5 + PAYLOAD_BYTE_NUM * 4)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
+
+    // "Gntlhdd..mm..": index, type, DLC min, DLC max, data code and mask
+    struct payload_rule rule;
+    rule.type = buf[2];
+    rule.dlc_min = buf[3];
+    rule.dlc_max = buf[4];
+    for (uint8_t i = 0; i < PAYLOAD_BYTE_NUM; i++)
+    {
+        rule.code[i] = (buf[5 + i * 2] << 4) + buf[6 + i * 2];
+        rule.mask[i] = (buf[5 + PAYLOAD_BYTE_NUM * 2 + i * 2] << 4) + buf[6 + PAYLOAD_BYTE_NUM * 2 + i * 2];
+    }
+
+    if (payload_set_rule(buf[1], &rule) != HAL_OK)
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+    else
+        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+}
+
+// Set / report ID set filter
+static void slcan_parse_str_id_set(uint8_t *buf, uint8_t len)
+{
+    // Report the compiled filter
+    if (buf[0] == 'h' && len == 1)
+    {
+        idset_compile();
+
+        char *idstr = (char *)buf_get_cdc_dest();
+        if (idstr == NULL) return;
+        int32_t ret = snprintf(idstr, SLCAN_MTU - 1, "h: ids_std_ext=[%u, %u], filters_std_ext=[%u, %u], false_accept_std_ext=[%lu, %lu], false_accept_ppm=%lu\r",
+                               idset_get_id_nbr(FDCAN_STANDARD_ID),
+                               idset_get_id_nbr(FDCAN_EXTENDED_ID),
+                               idset_get_filter_nbr(FDCAN_STANDARD_ID),
+                               idset_get_filter_nbr(FDCAN_EXTENDED_ID),
+                               (unsigned long)idset_get_false_accept_nbr(FDCAN_STANDARD_ID),
+                               (unsigned long)idset_get_false_accept_nbr(FDCAN_EXTENDED_ID),
+                               (unsigned long)idset_get_false_accept_ppm());
+        if (0 < ret) buf_comit_cdc_dest(ret);
+        return;
+    }
+
+    // Clear the lists, applied to the running controller if the ID set filter is in use
+    if (buf[0] == 'H' && len == 1)
+    {
+        idset_clear();
+        if (idset_is_enabled() == ENABLE && can_reload_filter() != HAL_OK)
+        {
+            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+            return;
+        }
+        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+        return;
+    }
+
+    // "Hiii..." for standard IDs, "hiiiiiiii..." for extended IDs
+    uint32_t id_type = (buf[0] == 'H') ? FDCAN_STANDARD_ID : FDCAN_EXTENDED_ID;
+    uint8_t id_len = (buf[0] == 'H') ? SLCAN_STD_ID_LEN : SLCAN_EXT_ID_LEN;
+    if ((len - 1) % id_len != 0)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
+
+    for (uint8_t i = 1; i < len; i += id_len)
+    {
+        uint32_t id = 0;
+        for (uint8_t j = 0; j < id_len; j++)
+            id = (id << 4) + buf[i + j];
+
+        if (idset_add_id(id_type, id) != HAL_OK)
+        {
+            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+            return;
+        }
+    }
+
+    // Applied to the running controller if the ID set filter is in use
+    if (idset_is_enabled() == ENABLE && can_reload_filter() != HAL_OK)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
+    buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+}
+
+// Get / clear latency histograms
+static void slcan_parse_str_latency(uint8_t *buf, uint8_t len)
+{
+    // Check command length
+    if (len != 1)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
+
+    // Clear all
+    if (buf[0] == 'E')
+    {
+        can_clear_latency_hist();
+        can_clear_tx_attempt_stat();
+        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+        return;
+    }
+
+    // Report in parts to fit in the MTU
+    char *latstr;
+    int32_t ret;
+
+    latstr = (char *)buf_get_cdc_dest();
+    if (latstr == NULL) return;
+    struct hist *tx_hist = can_get_tx_latency_hist();
+    ret = snprintf(latstr, SLCAN_MTU - 1, "e: tx_latency_us_p50_p99_max=[%lu, %lu, %lu], tx_latency_cnt=%lu",
+                   (unsigned long)hist_get_percentile(tx_hist, 500),
+                   (unsigned long)hist_get_percentile(tx_hist, 990),
+                   (unsigned long)hist_get_max(tx_hist),
+                   (unsigned long)hist_get_total(tx_hist));
+    if (0 < ret) buf_comit_cdc_dest(ret);
+
+    latstr = (char *)buf_get_cdc_dest();
+    if (latstr == NULL) return;
+    struct hist *rx_hist = can_get_rx_latency_hist();
+    ret = snprintf(latstr, SLCAN_MTU - 1, ", rx_latency_us_p50_p99_max=[%lu, %lu, %lu], rx_latency_cnt=%lu",
+                   (unsigned long)hist_get_percentile(rx_hist, 500),
+                   (unsigned long)hist_get_percentile(rx_hist, 990),
+                   (unsigned long)hist_get_max(rx_hist),
+                   (unsigned long)hist_get_total(rx_hist));
+    if (0 < ret) buf_comit_cdc_dest(ret);
+
+    latstr = (char *)buf_get_cdc_dest();
+    if (latstr == NULL) return;
+    struct can_tx_attempt_stat attempt = can_get_tx_attempt_stat();
+    ret = snprintf(latstr, SLCAN_MTU - 1, ", tx_attempt_frame_cnt=%lu, tx_arb_lost_cnt=%lu, tx_err_retry_cnt=%lu, tx_attempt_max=%lu",
+                   (unsigned long)attempt.frames,
+                   (unsigned long)attempt.arb_lost,
+                   (unsigned long)attempt.err_retry,
+                   (unsigned long)attempt.attempts_max);
+    if (0 < ret) buf_comit_cdc_dest(ret);
+
+    latstr = (char *)buf_get_cdc_dest();
+    if (latstr == NULL) return;
+    ret = snprintf(latstr, SLCAN_MTU - 1, ", tx_cancel_retry_expiry=[%lu, %lu]\r",
+                   (unsigned long)attempt.cancel_retry,
+                   (unsigned long)attempt.cancel_expiry);
+    if (0 < ret) buf_comit_cdc_dest(ret);
+}
+
+// Set / read bus load telemetry
+static void slcan_parse_str_load(uint8_t *buf, uint8_t len)
+{
+    // Set interval in ms and streaming
+    if (len == 6)
+    {
+        uint16_t interval_ms = (buf[1] << 12) + (buf[2] << 8) + (buf[3] << 4) + buf[4];
+        if (1 < buf[5] || load_set_config(interval_ms, buf[5] ? ENABLE : DISABLE) != HAL_OK)
+            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        else
+            buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+        return;
+    }
+
+    if (len != 1)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
+
+    uint8_t *loadstr = buf_get_cdc_dest();
+    if (loadstr == NULL) return;
+
+    // Up to 8 oldest samples
+    struct load_sample sample[LOAD_READ_NUM];
+    uint32_t num = load_read(sample, LOAD_READ_NUM);
+    uint32_t idx = 0;
+    loadstr[idx++] = 'l';
+    for (uint32_t i = 0; i < num; i++)
+        idx += load_generate_sample(&loadstr[idx], &sample[i]);
+    loadstr[idx++] = '\r';
+    buf_comit_cdc_dest(idx);
+}
+
+// Set bus off recovery / read bus off counters
+static void slcan_parse_str_recovery(uint8_t *buf, uint8_t len)
+{
+    // Set policy, delay in ms and the number of automatic recoveries
+    if (len == 8)
+    {
+        uint16_t delay_ms = (buf[2] << 12) + (buf[3] << 8) + (buf[4] << 4) + buf[5];
+        uint8_t max_num = (buf[6] << 4) + buf[7];
+        if (1 < buf[1] || can_set_recovery(buf[1] ? ENABLE : DISABLE, delay_ms, max_num) != HAL_OK)
+            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        else
+            buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+        return;
+    }
+
+    if (len != 1)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
+
+    struct can_bus_off_stat stat = can_get_bus_off_stat();
+
+    char *bofstr = (char *)buf_get_cdc_dest();
+    if (bofstr == NULL) return;
+    int ret = snprintf(bofstr, SLCAN_MTU - 1, "o: bus_off_cnt=%lu, recovery_cnt=%lu",
+                       (unsigned long)stat.bus_off_cnt,
+                       (unsigned long)stat.recovery_cnt);
+    if (0 < ret) buf_comit_cdc_dest(ret);
+
+    bofstr = (char *)buf_get_cdc_dest();
+    if (bofstr == NULL) return;
+    ret = snprintf(bofstr, SLCAN_MTU - 1, ", bus_off_ms_last_max_total=[%lu, %lu, %lu]\r",
+                   (unsigned long)stat.last_ms,
+                   (unsigned long)stat.max_ms,
+                   (unsigned long)stat.total_ms);
+    if (0 < ret) buf_comit_cdc_dest(ret);
+}
+
+// Recover from bus off without closing the channel
+static void slcan_parse_str_recover(uint8_t *buf, uint8_t len)
+{
+    if (len != 1 || can_recover_bus_off() != HAL_OK)
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+    else
+        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+}
+
+// Apply / store configuration profile
+static void slcan_parse_str_profile(uint8_t *buf, uint8_t len)
+{
+    // Store the current settings with the mode to open the channel
+    if (len == 3)
+    {
+        if (nvm_update_profile(buf[1], buf[2]) != HAL_OK)
+            buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        else
+            buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+        return;
+    }
+
+    if (len != 2 || NVM_PROFILE_NBR < buf[1])
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
+
+    // Apply all settings at once, the channel is closed only if the profile is good
+    uint8_t mode;
+    if (nvm_apply_profile(buf[1], &mode) != HAL_OK)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
+    slcan_status_flags = 0;
+    event_clear_cycle_time();
+
+    // Rebuild the acceptance code and mask from the filters, as if set by M and m
+    slcan_filter_code = can_get_filter_ext_code();
+    slcan_filter_mask = (~can_get_filter_ext_mask()) & 0x1FFFFFFF;
+    if (can_is_filter_std_enabled() == ENABLE && can_is_filter_ext_enabled() == ENABLE)
+        slcan_filter_mask |= 0x80000000;
+    else if (can_is_filter_std_enabled() == ENABLE)
+        slcan_filter_code |= 0x80000000;
+
+    if (mode == SLCAN_AUTO_STARTUP_OFF)
+    {
+        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+        return;
+    }
+
+    // Open in one pass
+    slcan_clear_sequence();
+    if (can_set_mode(mode == SLCAN_AUTO_STARTUP_NORMAL ? FDCAN_MODE_NORMAL : FDCAN_MODE_BUS_MONITORING) != HAL_OK || can_enable() != HAL_OK)
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+    else
+        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+}
+
+// Dump / stop / restart the event trace
+static void slcan_parse_str_trace(uint8_t *buf, uint8_t len)
+{
+#ifdef TRACE_ENABLE
+    // Stop or clear and restart recording
+    if (len == 2 && buf[1] <= 1)
+    {
+        trace_set_state(buf[1]);
+        buf_enqueue_cdc(SLCAN_RET_OK, SLCAN_RET_LEN);
+        return;
+    }
+
+    if (len != 1)
+    {
+        buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+        return;
+    }
+
+    uint8_t *trcstr = buf_get_cdc_dest();
+    if (trcstr == NULL) return;
+
+    // Up to 8 oldest records, or the number of records lost when all are read
+    struct trace_record record[8];
+    uint32_t num = trace_read(record, 8);
+    uint32_t idx = 0;
+    trcstr[idx++] = '#';
+    if (num == 0)
+    {
+        uint32_t lost = trace_get_lost();
+        for (int8_t j = 28; j >= 0; j -= 4)
+            trcstr[idx++] = slcan_nibble_to_ascii[(lost >> j) & 0xF];
+    }
+    for (uint32_t i = 0; i < num; i++)
+    {
+        for (int8_t j = 28; j >= 0; j -= 4)
+            trcstr[idx++] = slcan_nibble_to_ascii[(record[i].event >> j) & 0xF];
+        for (int8_t j = 28; j >= 0; j -= 4)
+            trcstr[idx++] = slcan_nibble_to_ascii[(record[i].cycle >> j) & 0xF];
+    }
+    trcstr[idx++] = '\r';
+    buf_comit_cdc_dest(idx);
+#else
+    // Trace is compiled out
+    buf_enqueue_cdc(SLCAN_RET_ERR, SLCAN_RET_LEN);
+#endif
+}
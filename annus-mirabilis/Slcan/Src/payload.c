@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+// Second stage filter on frame type, DLC and leading data bytes of rx frames.
+// The rules are compiled into lookup tables of rule bits, so a frame is checked
+// with the same number of lookups regardless of the number of rules.
+
+#include "stm32g0xx_hal.h"
+#include "can.h"
+#include "payload.h"
+
+// Rule bits
+typedef uint16_t payload_bits_t;
+
+// Private variables
+static struct payload_rule payload_rule[PAYLOAD_RULE_NUM];
+static payload_bits_t payload_rule_enabled = 0;
+static payload_bits_t payload_type_dlc_table[PAYLOAD_TYPE_NUM][16];             // Rules accepting the type and DLC
+static payload_bits_t payload_byte_table[PAYLOAD_BYTE_NUM][256];                // Rules accepting the byte value
+static payload_bits_t payload_byte_absent[PAYLOAD_BYTE_NUM];                    // Rules not caring the byte
+
+// Private methods
+static void payload_compile(void);
+
+// Set a rule and rebuild the decision table
+HAL_StatusTypeDef payload_set_rule(uint8_t index, struct payload_rule *rule)
+{
+    if (PAYLOAD_RULE_NUM <= index) return HAL_ERROR;
+    if (rule->dlc_max < rule->dlc_min || 15 < rule->dlc_max) return HAL_ERROR;
+
+    payload_rule[index] = *rule;
+    payload_rule_enabled |= (payload_bits_t)(1U << index);
+    payload_compile();
+
+    return HAL_OK;
+}
+
+// Clear a rule and rebuild the decision table
+HAL_StatusTypeDef payload_clear_rule(uint8_t index)
+{
+    if (PAYLOAD_RULE_NUM <= index) return HAL_ERROR;
+
+    payload_rule_enabled &= (payload_bits_t)~(1U << index);
+    payload_compile();
+
+    return HAL_OK;
+}
+
+// Return ENABLE if any rule accepts the frame or no rule is set
+__RAM_FUNC FunctionalState payload_is_accepted(FDCAN_RxHeaderTypeDef *frame_header, uint8_t *frame_data)
+{
+    if (payload_rule_enabled == 0) return ENABLE;
+
+    enum payload_type type;
+    uint8_t bytes = 0;
+    if (frame_header->RxFrameType == FDCAN_REMOTE_FRAME)
+        type = PAYLOAD_TYPE_REMOTE;
+    else if (frame_header->FDFormat == FDCAN_CLASSIC_CAN)
+        type = PAYLOAD_TYPE_CLASSIC;
+    else if (frame_header->BitRateSwitch == FDCAN_BRS_OFF)
+        type = PAYLOAD_TYPE_FD;
+    else
+        type = PAYLOAD_TYPE_FD_BRS;
+
+    uint8_t dlc = CAN_HAL_DLC_TO_STD_DLC(frame_header->DataLength);
+    if (type != PAYLOAD_TYPE_REMOTE) bytes = can_dlc_to_bytes[dlc];
+
+    payload_bits_t bits = payload_type_dlc_table[type][dlc];
+    for (uint8_t i = 0; i < PAYLOAD_BYTE_NUM; i++)
+    {
+        bits &= (i < bytes) ? payload_byte_table[i][frame_data[i]] : payload_byte_absent[i];
+    }
+
+    return (bits != 0) ? ENABLE : DISABLE;
+}
+
+// Build the lookup tables from the enabled rules
+static void payload_compile(void)
+{
+    for (uint8_t type = 0; type < PAYLOAD_TYPE_NUM; type++)
+    {
+        for (uint8_t dlc = 0; dlc < 16; dlc++)
+        {
+            payload_bits_t bits = 0;
+            for (uint8_t r = 0; r < PAYLOAD_RULE_NUM; r++)
+            {
+                struct payload_rule *rule = &payload_rule[r];
+                if (((payload_rule_enabled >> r) & 1) && ((rule->type >> type) & 1) &&
+                    rule->dlc_min <= dlc && dlc <= rule->dlc_max)
+                    bits |= (payload_bits_t)(1U << r);
+            }
+            payload_type_dlc_table[type][dlc] = bits;
+        }
+    }
+
+    for (uint8_t i = 0; i < PAYLOAD_BYTE_NUM; i++)
+    {
+        payload_bits_t absent = 0;
+        for (uint8_t r = 0; r < PAYLOAD_RULE_NUM; r++)
+        {
+            if (((payload_rule_enabled >> r) & 1) && payload_rule[r].mask[i] == 0xFF)
+                absent |= (payload_bits_t)(1U << r);
+        }
+        payload_byte_absent[i] = absent;
+
+        for (uint16_t value = 0; value < 256; value++)
+        {
+            payload_bits_t bits = 0;
+            for (uint8_t r = 0; r < PAYLOAD_RULE_NUM; r++)
+            {
+                struct payload_rule *rule = &payload_rule[r];
+                if (((payload_rule_enabled >> r) & 1) && ((rule->code[i] ^ value) & ~rule->mask[i] & 0xFF) == 0)
+                    bits |= (payload_bits_t)(1U << r);
+            }
+            payload_byte_table[i][value] = bits;
+        }
+    }
+}
@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+// Shed low priority rx frames first when the buffer to host fills up
+
+#include "stm32g0xx_hal.h"
+#include "buffer.h"
+#include "diag.h"
+#include "qos.h"
+
+// Rule to assign CAN IDs to a class (same format as the simple filter)
+struct qos_rule
+{
+    FunctionalState state;
+    uint32_t code;      // Bit 31 set for base ID
+    uint32_t mask;      // Bit set for don't care
+};
+
+// Fill level of the buffer to host above which a class is shed
+static const uint32_t qos_shed_level[QOS_CLASS_NUM] = {
+    BUF_CDC_TX_BUF_SIZE,            // Class 0: only lost when the buffer is full
+    BUF_CDC_TX_BUF_SIZE * 7 / 8,
+    BUF_CDC_TX_BUF_SIZE * 3 / 4,
+    BUF_CDC_TX_BUF_SIZE * 5 / 8,    // No rule matched
+};
+
+// Private variables
+static struct qos_rule qos_rule[QOS_RULE_NUM] = {0};
+
+// Set or clear the rule of a class
+HAL_StatusTypeDef qos_set_rule(uint8_t class, FunctionalState state, uint32_t code, uint32_t mask)
+{
+    if (QOS_RULE_NUM <= class) return HAL_ERROR;
+
+    qos_rule[class].state = state;
+    qos_rule[class].code = code;
+    qos_rule[class].mask = mask;
+
+    return HAL_OK;
+}
+
+// Return the class of a frame, the first matching rule wins
+__RAM_FUNC uint8_t qos_get_class(FDCAN_RxHeaderTypeDef *frame_header)
+{
+    uint32_t id_word;
+    uint32_t used_bits;
+
+    if (frame_header->IdType == FDCAN_STANDARD_ID)
+    {
+        id_word = 0x80000000 | frame_header->Identifier;
+        used_bits = 0x800007FF;
+    }
+    else
+    {
+        id_word = frame_header->Identifier;
+        used_bits = 0x9FFFFFFF;
+    }
+
+    for (uint8_t class = 0; class < QOS_RULE_NUM; class++)
+    {
+        struct qos_rule *rule = &qos_rule[class];
+        if (rule->state == ENABLE && ((rule->code ^ id_word) & ~rule->mask & used_bits) == 0)
+            return class;
+    }
+
+    return QOS_CLASS_NUM - 1;
+}
+
+// Decide whether to report a rx frame at the current fill level of the buffer to host
+__RAM_FUNC FunctionalState qos_is_reported(FDCAN_RxHeaderTypeDef *frame_header)
+{
+    // No shedding without any rule, all frames have the same chance
+    uint8_t is_active = 0;
+    for (uint8_t class = 0; class < QOS_RULE_NUM; class++)
+    {
+        if (qos_rule[class].state == ENABLE) is_active = 1;
+    }
+    if (!is_active) return ENABLE;
+
+    uint8_t class = qos_get_class(frame_header);
+    if (qos_shed_level[class] <= buf_get_cdc_tx_level())
+    {
+        diag_count_loss(DIAG_LOSS_SHED_CLASS0 + class);
+        return DISABLE;
+    }
+
+    return ENABLE;
+}
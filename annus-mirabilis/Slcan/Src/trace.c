@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////////////////////
+// The MIT License (MIT)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+
+// Timestamped event records kept in RAM for timing analysis without a debugger.
+// The probes are compiled out unless TRACE_ENABLE is defined in trace.h.
+
+#include "stm32g0xx_hal.h"
+#include "perf_counter.h"
+#include "trace.h"
+
+// Ring of records, the oldest is overwritten when full
+static struct trace_record trace_ring[TRACE_RECORD_NUM];
+static volatile uint32_t trace_head = 0;        // Next record to write
+static volatile uint32_t trace_tail = 0;        // Next record to read
+static volatile uint32_t trace_lost = 0;        // Records overwritten before read
+static volatile uint8_t trace_is_running = 1;
+
+// Add a record, called from both the main loop and interrupts
+__RAM_FUNC void trace_add(enum trace_event event, uint32_t payload)
+{
+    if (trace_is_running == 0) return;
+
+    uint32_t cycle = (uint32_t)get_system_ticks();
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t head = trace_head;
+    trace_head = (head + 1) % TRACE_RECORD_NUM;
+    if (trace_head == trace_tail)
+    {
+        trace_tail = (trace_tail + 1) % TRACE_RECORD_NUM;
+        trace_lost++;
+    }
+    __set_PRIMASK(primask);
+
+    trace_ring[head].event = ((payload & TRACE_PAYLOAD_MASK) << 8) | (uint8_t)event;
+    trace_ring[head].cycle = cycle;
+}
+
+// Move up to num oldest records out of the ring, return the number moved
+uint32_t trace_read(struct trace_record *record, uint32_t num)
+{
+    uint32_t i;
+
+    __disable_irq();
+    for (i = 0; i < num && trace_tail != trace_head; i++)
+    {
+        record[i] = trace_ring[trace_tail];
+        trace_tail = (trace_tail + 1) % TRACE_RECORD_NUM;
+    }
+    __enable_irq();
+
+    return i;
+}
+
+// Stop recording to read a fixed window, or clear and restart
+void trace_set_state(uint8_t is_running)
+{
+    if (is_running)
+    {
+        __disable_irq();
+        trace_tail = trace_head;
+        trace_lost = 0;
+        __enable_irq();
+    }
+    trace_is_running = is_running;
+}
+
+// Get the number of records overwritten before read since the last restart
+uint32_t trace_get_lost(void)
+{
+    return trace_lost;
+}
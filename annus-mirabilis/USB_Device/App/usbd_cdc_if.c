@@ -23,7 +23,10 @@
 
 /* USER CODE BEGIN INCLUDE */
 #include "buffer.h"
+#include "diag.h"
+#include "event.h"
 #include "slcan.h"
+#include "trace.h"
 /* USER CODE END INCLUDE */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -129,7 +132,13 @@ static int8_t CDC_Receive_FS(uint8_t* pbuf, uint32_t *Len);
 static int8_t CDC_TransmitCplt_FS(uint8_t *pbuf, uint32_t *Len, uint8_t epnum);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
+static int8_t CDC_Init_Ctrl_FS(void);
+static int8_t CDC_Receive_Ctrl_FS(uint8_t* pbuf, uint32_t *Len);
+static int8_t CDC_TransmitCplt_Ctrl_FS(uint8_t *pbuf, uint32_t *Len, uint8_t epnum);
 
+static int8_t CDC_Init_Port(uint8_t port);
+static int8_t CDC_Receive_Port(uint8_t port, uint32_t *Len);
+static int8_t CDC_TransmitCplt_Port(uint8_t port);
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
 /**
@@ -145,6 +154,17 @@ USBD_CDC_ItfTypeDef USBD_Interface_fops_FS =
   CDC_TransmitCplt_FS
 };
 
+/* USER CODE BEGIN FOPS */
+USBD_CDC_ItfTypeDef USBD_Interface_fops_Ctrl_FS =
+{
+  CDC_Init_Ctrl_FS,
+  CDC_DeInit_FS,
+  CDC_Control_FS,
+  CDC_Receive_Ctrl_FS,
+  CDC_TransmitCplt_Ctrl_FS
+};
+/* USER CODE END FOPS */
+
 /* Private functions ---------------------------------------------------------*/
 /**
   * @brief  Initializes the CDC media low layer over the FS USB IP
@@ -153,10 +173,7 @@ USBD_CDC_ItfTypeDef USBD_Interface_fops_FS =
 static int8_t CDC_Init_FS(void)
 {
   /* USER CODE BEGIN 3 */
-  /* Set Application Buffers */
-  USBD_CDC_SetTxBuffer(&hUsbDeviceFS, (uint8_t *)buf_cdc_tx.data[buf_cdc_tx.tail], 0);
-  USBD_CDC_SetRxBuffer(&hUsbDeviceFS, (uint8_t *)buf_cdc_rx.data[buf_cdc_rx.head]);
-  return (USBD_OK);
+  return CDC_Init_Port(BUF_CDC_PORT_DATA);
   /* USER CODE END 3 */
 }
 
@@ -265,31 +282,11 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
   * @param  Len: Number of data received (in bytes)
   * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
   */
-static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
+__RAM_FUNC static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 {
   /* USER CODE BEGIN 6 */
-  uint32_t new_head = (buf_cdc_rx.head + 1) % BUF_CDC_RX_NUM_BUFS;
-  if (new_head == buf_cdc_rx.tail)
-  {
-    // Buffer overflow
-    slcan_raise_error(SLCAN_STS_CAN_TX_FIFO_FULL);
-
-    // Listen again on the same buffer. Old data will be overwritten.
-    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, (uint8_t *)buf_cdc_rx.data[buf_cdc_rx.head]);
-    USBD_CDC_ReceivePacket(&hUsbDeviceFS);
-    return (USBD_FAIL);
-  }
-  else
-  {
-    // Save length and move to next buffer
-    buf_cdc_rx.msglen[buf_cdc_rx.head] = *Len;
-    buf_cdc_rx.head = new_head;
-
-    // Start listening on next buffer. Previous buffer will be processed in main loop.
-    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, (uint8_t *)buf_cdc_rx.data[buf_cdc_rx.head]);
-    USBD_CDC_ReceivePacket(&hUsbDeviceFS);
-    return (USBD_OK);
-  }
+  UNUSED(Buf);
+  return CDC_Receive_Port(BUF_CDC_PORT_DATA, Len);
   /* USER CODE END 6 */
 }
 
@@ -308,12 +305,7 @@ uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
 {
   uint8_t result = USBD_OK;
   /* USER CODE BEGIN 7 */
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
-  if (hcdc->TxState != 0){
-    return USBD_BUSY;
-  }
-  USBD_CDC_SetTxBuffer(&hUsbDeviceFS, Buf, Len);
-  result = USBD_CDC_TransmitPacket(&hUsbDeviceFS);
+  result = CDC_Transmit_Port_FS(BUF_CDC_PORT_DATA, Buf, Len);
   /* USER CODE END 7 */
   return result;
 }
@@ -330,27 +322,124 @@ uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
   * @param  Len: Number of data received (in bytes)
   * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
   */
-static int8_t CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
+__RAM_FUNC static int8_t CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
 {
   uint8_t result = USBD_OK;
   /* USER CODE BEGIN 13 */
   UNUSED(Buf);
   UNUSED(Len);
   UNUSED(epnum);
-  uint32_t new_tail = (buf_cdc_tx.tail + 1UL) % BUF_CDC_TX_NUM_BUFS;
-  if (new_tail != buf_cdc_tx.head)
-  {
-      if (CDC_Transmit_FS((uint8_t *)buf_cdc_tx.data[new_tail], buf_cdc_tx.msglen[new_tail]) == USBD_OK)
-      {
-          buf_cdc_tx.tail = new_tail;
-      }
-  }
+  result = CDC_TransmitCplt_Port(BUF_CDC_PORT_DATA);
   /* USER CODE END 13 */
   return result;
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
+/**
+  * @brief  CDC_Transmit_Port_FS
+  *         Start the transfer of a buffer on the IN endpoint of a port.
+  * @param  port: CDC port index
+  * @param  Buf: Buffer of data to be sent
+  * @param  Len: Number of data to be sent (in bytes)
+  * @retval USBD_OK if all operations are OK else USBD_FAIL or USBD_BUSY
+  */
+__RAM_FUNC uint8_t CDC_Transmit_Port_FS(uint8_t port, uint8_t* Buf, uint16_t Len)
+{
+  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+  if (hcdc == NULL || port >= BUF_CDC_PORT_NUM)
+  {
+    return USBD_FAIL;
+  }
+  if (hcdc[port].TxState != 0)
+  {
+    return USBD_BUSY;
+  }
+  TRACE(TRACE_USB_TX_START, (port << 16) | Len);
+  USBD_CDC_SetTxBuffer(&hUsbDeviceFS, port, Buf, Len);
+  return USBD_CDC_TransmitPacket(&hUsbDeviceFS, port);
+}
+
+// Callbacks of the control port
+static int8_t CDC_Init_Ctrl_FS(void)
+{
+  return CDC_Init_Port(BUF_CDC_PORT_CTRL);
+}
+
+__RAM_FUNC static int8_t CDC_Receive_Ctrl_FS(uint8_t* Buf, uint32_t *Len)
+{
+  UNUSED(Buf);
+  return CDC_Receive_Port(BUF_CDC_PORT_CTRL, Len);
+}
+
+__RAM_FUNC static int8_t CDC_TransmitCplt_Ctrl_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
+{
+  UNUSED(Buf);
+  UNUSED(Len);
+  UNUSED(epnum);
+  return CDC_TransmitCplt_Port(BUF_CDC_PORT_CTRL);
+}
+
+// Set application buffers of a port
+static int8_t CDC_Init_Port(uint8_t port)
+{
+  USBD_CDC_SetTxBuffer(&hUsbDeviceFS, port, (uint8_t *)buf_cdc_tx[port].data[buf_cdc_tx[port].tail], 0);
+  USBD_CDC_SetRxBuffer(&hUsbDeviceFS, port, (uint8_t *)buf_cdc_rx[port].data[buf_cdc_rx[port].head]);
+  return (USBD_OK);
+}
+
+// Queue the received packet of a port and listen on the next buffer
+__RAM_FUNC static int8_t CDC_Receive_Port(uint8_t port, uint32_t *Len)
+{
+  volatile struct buf_cdc_rx *rx = &buf_cdc_rx[port];
+  uint32_t new_head = (rx->head + 1) % BUF_CDC_RX_NUM_BUFS;
+  TRACE(TRACE_USB_RX, (port << 16) | *Len);
+  if (new_head == rx->tail)
+  {
+    // Buffer overflow
+    diag_count_loss(DIAG_LOSS_CDC_RX_DATA + port);
+    slcan_raise_error(SLCAN_STS_CAN_TX_FIFO_FULL);
+
+    // Listen again on the same buffer. Old data will be overwritten.
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, port, (uint8_t *)rx->data[rx->head]);
+    USBD_CDC_ReceivePacket(&hUsbDeviceFS, port);
+    return (USBD_FAIL);
+  }
+  else
+  {
+    // Save length and move to next buffer
+    rx->msglen[rx->head] = *Len;
+    rx->head = new_head;
+    diag_update_peak(DIAG_PEAK_CDC_RX_DATA + port, (new_head + BUF_CDC_RX_NUM_BUFS - rx->tail) % BUF_CDC_RX_NUM_BUFS);
+
+    // Start listening on next buffer. Previous buffer will be processed in main loop.
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, port, (uint8_t *)rx->data[rx->head]);
+    USBD_CDC_ReceivePacket(&hUsbDeviceFS, port);
+    event_post(EVENT_CDC_RX);
+    return (USBD_OK);
+  }
+}
+
+// Chain the next filled buffer of a port
+__RAM_FUNC static int8_t CDC_TransmitCplt_Port(uint8_t port)
+{
+  volatile struct buf_cdc_tx *tx = &buf_cdc_tx[port];
+  uint32_t new_tail = (tx->tail + 1UL) % BUF_CDC_TX_NUM_BUFS;
+  TRACE(TRACE_USB_TX_CPLT, port);
+  if (new_tail != tx->head)
+  {
+      if (CDC_Transmit_Port_FS(port, (uint8_t *)tx->data[new_tail], tx->msglen[new_tail]) == USBD_OK)
+      {
+          buf_mark_cdc_tx_handoff(port, new_tail);
+          tx->tail = new_tail;
+      }
+  }
+
+  // Let the main loop rotate the buffer being filled
+  event_post(EVENT_CDC_TX);
+  return (USBD_OK);
+}
+
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
 /**
@@ -94,7 +94,8 @@
 extern USBD_CDC_ItfTypeDef USBD_Interface_fops_FS;
 
 /* USER CODE BEGIN EXPORTED_VARIABLES */
-
+/** CDC Interface callback of the control port. */
+extern USBD_CDC_ItfTypeDef USBD_Interface_fops_Ctrl_FS;
 /* USER CODE END EXPORTED_VARIABLES */
 
 /**
@@ -109,7 +110,7 @@ extern USBD_CDC_ItfTypeDef USBD_Interface_fops_FS;
 uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
 
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
-
+uint8_t CDC_Transmit_Port_FS(uint8_t port, uint8_t* Buf, uint16_t Len);
 /* USER CODE END EXPORTED_FUNCTIONS */
 
 /**
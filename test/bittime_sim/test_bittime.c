@@ -0,0 +1,125 @@
+// Host test of the bit timing solver against the fixed timings of the S and Y commands
+//
+// Build and run from the root directory:
+//   gcc -Wall -Werror -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -DUSE_HAL_DRIVER -DSTM32G0B1xx
+//       -Iannus-mirabilis/Core/Inc -Iannus-mirabilis/Slcan/Inc -Iannus-mirabilis/Drivers/STM32G0xx_HAL_Driver/Inc
+//       -Iannus-mirabilis/Drivers/CMSIS/Device/ST/STM32G0xx/Include -Iannus-mirabilis/Drivers/CMSIS/Include
+//       -o test/bittime_sim/test_bittime annus-mirabilis/Slcan/Src/bittime.c test/bittime_sim/test_bittime.c
+//   ./test/bittime_sim/test_bittime
+
+#include <stdio.h>
+#include "stm32g0xx_hal.h"
+#include "can.h"
+#include "bittime.h"
+
+static uint32_t test_fail_cnt = 0;
+
+#define TEST_ASSERT(cond) \
+    do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __func__, __LINE__, #cond); test_fail_cnt++; } } while (0)
+
+static uint32_t test_tq_nbr(const struct can_bitrate_cfg *cfg)
+{
+    return 1 + cfg->time_seg1 + cfg->time_seg2;
+}
+
+static uint32_t test_bitrate(const struct can_bitrate_cfg *cfg)
+{
+    return BITTIME_CLOCK_HZ / (cfg->prescaler * test_tq_nbr(cfg));
+}
+
+// Sample point in ppm of one bit
+static uint32_t test_sample_point_ppm(const struct can_bitrate_cfg *cfg)
+{
+    return (1 + cfg->time_seg1) * 1000000 / test_tq_nbr(cfg);
+}
+
+static uint32_t test_abs_diff(uint32_t a, uint32_t b)
+{
+    return (a < b) ? (b - a) : (a - b);
+}
+
+// Timing fits in the registers and SJW does not exceed the phase segment 2
+static void test_within_limit(const struct can_bitrate_cfg *cfg, const struct bittime_limit *limit, int idx)
+{
+    if (!(1 <= cfg->prescaler && cfg->prescaler <= limit->prescaler_max)
+        || !(1 <= cfg->time_seg1 && cfg->time_seg1 <= limit->time_seg1_max)
+        || !(1 <= cfg->time_seg2 && cfg->time_seg2 <= limit->time_seg2_max)
+        || !(1 <= cfg->sjw && cfg->sjw <= limit->sjw_max && cfg->sjw <= cfg->time_seg2))
+    {
+        printf("FAIL %s: entry %d {%u, %u, %u, %u} out of limit\n", __func__, idx,
+               cfg->prescaler, cfg->time_seg1, cfg->time_seg2, cfg->sjw);
+        test_fail_cnt++;
+    }
+}
+
+// Solve each fixed timing from its bitrate, sample point and SJW
+static void test_table(const uint32_t *bitrate, const struct can_bitrate_cfg *table, int nbr,
+                       const struct bittime_limit *limit)
+{
+    for (int i = 0; i < nbr; i++)
+    {
+        struct can_bitrate_cfg cfg = {0};
+        uint16_t sample_point = (test_sample_point_ppm(&table[i]) + 500) / 1000;
+
+        // The table itself is exact and valid
+        test_within_limit(&table[i], limit, i);
+        TEST_ASSERT(BITTIME_CLOCK_HZ % (table[i].prescaler * test_tq_nbr(&table[i])) == 0);
+        TEST_ASSERT(test_bitrate(&table[i]) == bitrate[i]);
+
+        TEST_ASSERT(bittime_solve(bitrate[i], sample_point, table[i].sjw, limit, &cfg) == HAL_OK);
+        test_within_limit(&cfg, limit, i);
+
+        // Exact bitrate, and a sample point no worse than the table
+        TEST_ASSERT(BITTIME_CLOCK_HZ % (cfg.prescaler * test_tq_nbr(&cfg)) == 0);
+        TEST_ASSERT(test_bitrate(&cfg) == bitrate[i]);
+        TEST_ASSERT(test_abs_diff(test_sample_point_ppm(&cfg), sample_point * 1000)
+                    <= test_abs_diff(test_sample_point_ppm(&table[i]), sample_point * 1000));
+        TEST_ASSERT(cfg.sjw == table[i].sjw);
+
+        // SJW as large as allowed if not given
+        TEST_ASSERT(bittime_solve(bitrate[i], sample_point, 0, limit, &cfg) == HAL_OK);
+        TEST_ASSERT(cfg.sjw == ((limit->sjw_max < cfg.time_seg2) ? limit->sjw_max : cfg.time_seg2));
+    }
+}
+
+static void test_nominal_table(void)
+{
+    test_table(bittime_nominal_bitrate, bittime_nominal_cfg, CAN_BITRATE_INVALID, &bittime_limit_nominal);
+}
+
+static void test_data_table(void)
+{
+    test_table(bittime_data_bitrate, bittime_data_cfg, CAN_DATA_BITRATE_INVALID, &bittime_limit_data);
+}
+
+static void test_invalid_target(void)
+{
+    struct can_bitrate_cfg cfg = {0};
+
+    TEST_ASSERT(bittime_solve(0, 875, 0, &bittime_limit_nominal, &cfg) == HAL_ERROR);
+    TEST_ASSERT(bittime_solve(500000, 0, 0, &bittime_limit_nominal, &cfg) == HAL_ERROR);
+    TEST_ASSERT(bittime_solve(500000, 1000, 0, &bittime_limit_nominal, &cfg) == HAL_ERROR);
+
+    // SJW over the phase segment 2 or the register
+    TEST_ASSERT(bittime_solve(6000000, 800, 3, &bittime_limit_data, &cfg) == HAL_ERROR);
+    TEST_ASSERT(bittime_solve(500000, 875, 129, &bittime_limit_nominal, &cfg) == HAL_ERROR);
+
+    // Too slow or too fast for the clock
+    TEST_ASSERT(bittime_solve(500, 875, 0, &bittime_limit_nominal, &cfg) == HAL_ERROR);
+    TEST_ASSERT(bittime_solve(25000000, 800, 0, &bittime_limit_data, &cfg) == HAL_ERROR);
+}
+
+int main(void)
+{
+    test_nominal_table();
+    test_data_table();
+    test_invalid_target();
+
+    if (test_fail_cnt)
+    {
+        printf("bittime test: %u failure(s)\n", test_fail_cnt);
+        return 1;
+    }
+    printf("bittime test: OK\n");
+    return 0;
+}
@@ -12,11 +12,11 @@ class DeviceUnderTest:
         self.print_on = False
 
 
-    def open(self):
-        # connect to serial
+    def open(self, ctrl: bool = False):
+        # connect to serial (data port or control port)
         # device name should be changed
-        #self.ser = serial.Serial('/dev/ttyACM0', timeout=1, write_timeout=1)
-        self.ser = serial.Serial('COM9', timeout=1, write_timeout=1)
+        #self.ser = serial.Serial('/dev/ttyACM1' if ctrl else '/dev/ttyACM0', timeout=1, write_timeout=1)
+        self.ser = serial.Serial('COM10' if ctrl else 'COM9', timeout=1, write_timeout=1)
 
 
     def setup(self):
@@ -24,20 +24,8 @@ class DeviceUnderTest:
         self.send(b"\r\r\r")
         self.receive()
 
-        # reset to default status
-        self.send(b"C\r")
-        self.receive()
-        self.send(b"S4\r")
-        self.receive()
-        self.send(b"Y2\r")
-        self.receive()
-        self.send(b"Z0\r")
-        self.receive()
-        self.send(b"W2\r")
-        self.receive()
-        self.send(b"M00000000\r")
-        self.receive()
-        self.send(b"mFFFFFFFF\r")       # mFFFFFFFF -> Pass all
+        # reset to default status (close, S4, Y2, Z0, W2, M00000000 and mFFFFFFFF)
+        self.send(b"p0\r")
         self.receive()
 
 
@@ -0,0 +1,102 @@
+// Simulated flash memory for host tests of the non-volatile memory
+// Same interface as nvm_flash.c on the device. A power loss can be injected after a number of
+// program/erase operations, which leaves the operation incomplete and ignores later ones.
+
+#include <string.h>
+#include "stm32g0xx_hal.h"
+#include "nvm_flash.h"
+#include "nvm_flash_sim.h"
+
+#define SIM_DWORD_NBR_PER_PAGE    (NVM_FLASH_PAGE_SIZE / 8)
+
+uint64_t nvm_flash_sim_mem[NVM_FLASH_PAGE_NBR * SIM_DWORD_NBR_PER_PAGE];
+uint32_t nvm_flash_sim_erase_cnt[NVM_FLASH_PAGE_NBR];
+
+static int32_t sim_op_remain = -1;      /* Operations until power loss, -1 for no loss */
+static uint8_t sim_power_lost = 0;
+static uint32_t sim_op_cnt = 0;
+
+// Erase all pages and clear statistics
+void nvm_flash_sim_clear(void)
+{
+    memset(nvm_flash_sim_mem, 0xFF, sizeof(nvm_flash_sim_mem));
+    memset(nvm_flash_sim_erase_cnt, 0, sizeof(nvm_flash_sim_erase_cnt));
+    nvm_flash_sim_power_on();
+}
+
+// Lose the power on the (op_nbr + 1)th program/erase operation
+void nvm_flash_sim_fail_after(int32_t op_nbr)
+{
+    sim_op_remain = op_nbr;
+}
+
+// Restore the power
+void nvm_flash_sim_power_on(void)
+{
+    sim_op_remain = -1;
+    sim_power_lost = 0;
+    sim_op_cnt = 0;
+}
+
+// Number of program/erase operations since power on
+uint32_t nvm_flash_sim_get_op_cnt(void)
+{
+    return sim_op_cnt;
+}
+
+// Return 1 if the power is lost on this operation
+static uint8_t sim_is_power_lost(void)
+{
+    if (sim_power_lost) return 1;
+    sim_op_cnt++;
+    if (sim_op_remain == 0)
+    {
+        sim_power_lost = 1;
+        return 1;
+    }
+    if (0 < sim_op_remain) sim_op_remain--;
+    return 0;
+}
+
+uint64_t nvm_flash_read(uint8_t page, uint16_t offset)
+{
+    return nvm_flash_sim_mem[page * SIM_DWORD_NBR_PER_PAGE + offset / 8];
+}
+
+HAL_StatusTypeDef nvm_flash_program(uint8_t page, uint16_t offset, uint64_t data)
+{
+    if (NVM_FLASH_PAGE_NBR <= page || NVM_FLASH_PAGE_SIZE <= offset) return HAL_ERROR;
+
+    uint64_t *dword = &nvm_flash_sim_mem[page * SIM_DWORD_NBR_PER_PAGE + offset / 8];
+    if (sim_power_lost) return HAL_ERROR;
+    if (*dword != NVM_FLASH_ERASED) return HAL_ERROR;
+
+    // Incomplete program leaves only a part of the bits cleared
+    if (sim_is_power_lost())
+    {
+        *dword = data | 0x00000000FFFFFFFFULL;
+        return HAL_ERROR;
+    }
+
+    *dword = data;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef nvm_flash_erase(uint8_t page)
+{
+    if (NVM_FLASH_PAGE_NBR <= page) return HAL_ERROR;
+
+    uint64_t *first = &nvm_flash_sim_mem[page * SIM_DWORD_NBR_PER_PAGE];
+    if (sim_power_lost) return HAL_ERROR;
+
+    // Incomplete erase leaves the first half of the page including the header
+    if (sim_is_power_lost())
+    {
+        memset(first + SIM_DWORD_NBR_PER_PAGE / 2, 0xFF, NVM_FLASH_PAGE_SIZE / 2);
+        return HAL_ERROR;
+    }
+
+    memset(first, 0xFF, NVM_FLASH_PAGE_SIZE);
+    nvm_flash_sim_erase_cnt[page]++;
+    return HAL_OK;
+}
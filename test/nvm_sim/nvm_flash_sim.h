@@ -0,0 +1,16 @@
+// Simulated flash memory for host tests of the non-volatile memory
+
+#ifndef _NVM_FLASH_SIM_H
+#define _NVM_FLASH_SIM_H
+
+#include <stdint.h>
+
+extern uint64_t nvm_flash_sim_mem[];
+extern uint32_t nvm_flash_sim_erase_cnt[];
+
+void nvm_flash_sim_clear(void);
+void nvm_flash_sim_fail_after(int32_t op_nbr);
+void nvm_flash_sim_power_on(void);
+uint32_t nvm_flash_sim_get_op_cnt(void);
+
+#endif // _NVM_FLASH_SIM_H
@@ -0,0 +1,194 @@
+// Host test of the log-structured non-volatile memory with the simulated flash
+//
+// Build and run from the root directory:
+//   gcc -Wall -Werror -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -DUSE_HAL_DRIVER -DSTM32G0B1xx
+//       -Iannus-mirabilis/Core/Inc -Iannus-mirabilis/Slcan/Inc -Iannus-mirabilis/Drivers/STM32G0xx_HAL_Driver/Inc
+//       -Iannus-mirabilis/Drivers/CMSIS/Device/ST/STM32G0xx/Include -Iannus-mirabilis/Drivers/CMSIS/Include
+//       -Itest/nvm_sim -o test/nvm_sim/test_nvm_log
+//       annus-mirabilis/Slcan/Src/nvm_log.c test/nvm_sim/nvm_flash_sim.c test/nvm_sim/test_nvm_log.c
+//   ./test/nvm_sim/test_nvm_log
+
+#include <stdio.h>
+#include "stm32g0xx_hal.h"
+#include "nvm_flash.h"
+#include "nvm_log.h"
+#include "nvm_flash_sim.h"
+
+#define TEST_KEY_NBR        (6)
+
+static uint32_t test_fail_cnt = 0;
+
+#define TEST_ASSERT(cond) \
+    do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __func__, __LINE__, #cond); test_fail_cnt++; } } while (0)
+
+// Run deferred tasks until done (or a limit if the flash is broken)
+static void test_process_all(void)
+{
+    for (uint32_t i = 0; i < 1000 && nvm_log_is_pending(); i++)
+        nvm_log_process(ENABLE);
+}
+
+static void test_blank_memory(void)
+{
+    uint64_t value;
+
+    nvm_flash_sim_clear();
+    TEST_ASSERT(nvm_log_init() == HAL_ERROR);
+    TEST_ASSERT(nvm_log_read(0, &value) == HAL_ERROR);
+
+    // Kept in RAM until the first page is made
+    TEST_ASSERT(nvm_log_write(1, 0x1234) == HAL_OK);
+    TEST_ASSERT(nvm_log_read(1, &value) == HAL_OK && value == 0x1234);
+    TEST_ASSERT(nvm_log_is_pending());
+    nvm_log_process(DISABLE);
+    TEST_ASSERT(nvm_flash_sim_get_op_cnt() == 0);
+
+    test_process_all();
+    TEST_ASSERT(!nvm_log_is_pending());
+
+    // Restored after reboot
+    TEST_ASSERT(nvm_log_init() == HAL_OK);
+    TEST_ASSERT(nvm_log_read(1, &value) == HAL_OK && value == 0x1234);
+    TEST_ASSERT(nvm_log_read(0, &value) == HAL_ERROR);
+    TEST_ASSERT(nvm_log_write(NVM_LOG_KEY_NBR, 0) == HAL_ERROR);
+}
+
+static void test_append_without_erase(void)
+{
+    uint64_t value;
+
+    nvm_flash_sim_clear();
+    nvm_log_init();
+    nvm_log_write(0, 0);
+    test_process_all();
+    uint32_t erase_cnt = nvm_flash_sim_erase_cnt[0] + nvm_flash_sim_erase_cnt[1];
+
+    // Writes while the bus is busy never erase
+    for (uint64_t i = 1; i <= 300; i++)
+    {
+        TEST_ASSERT(nvm_log_write(0, i) == HAL_OK);
+        nvm_log_process(DISABLE);
+    }
+    TEST_ASSERT(nvm_flash_sim_erase_cnt[0] + nvm_flash_sim_erase_cnt[1] == erase_cnt);
+    TEST_ASSERT(nvm_log_read(0, &value) == HAL_OK && value == 300);
+    TEST_ASSERT(nvm_log_is_pending());
+
+    // Compaction when idle
+    test_process_all();
+    TEST_ASSERT(!nvm_log_is_pending());
+    nvm_log_init();
+    TEST_ASSERT(nvm_log_read(0, &value) == HAL_OK && value == 300);
+}
+
+static void test_wear_leveling(void)
+{
+    uint64_t value;
+    uint32_t write_nbr = 10000;
+
+    nvm_flash_sim_clear();
+    nvm_log_init();
+    for (uint64_t i = 0; i < write_nbr; i++)
+    {
+        nvm_log_write(i % TEST_KEY_NBR, i);
+        nvm_log_process(ENABLE);
+    }
+    test_process_all();
+
+    // Erase is spread over pages and needed once per many writes
+    uint32_t erase_0 = nvm_flash_sim_erase_cnt[0];
+    uint32_t erase_1 = nvm_flash_sim_erase_cnt[1];
+    TEST_ASSERT(erase_0 + erase_1 < write_nbr / 50);
+    TEST_ASSERT(erase_0 <= erase_1 + 1 && erase_1 <= erase_0 + 1);
+
+    nvm_log_init();
+    for (uint8_t key = 0; key < TEST_KEY_NBR; key++)
+    {
+        TEST_ASSERT(nvm_log_read(key, &value) == HAL_OK && value == (write_nbr - 1 - key) / TEST_KEY_NBR * TEST_KEY_NBR + key);
+    }
+}
+
+// Write value i to key (i % TEST_KEY_NBR) and record the values known to be stored
+static uint32_t test_write_sequence(uint64_t *durable, uint64_t *written, uint32_t write_nbr)
+{
+    for (uint64_t i = TEST_KEY_NBR; i < write_nbr; i++)
+    {
+        nvm_log_write(i % TEST_KEY_NBR, i);
+        written[i % TEST_KEY_NBR] = i;
+        nvm_log_process((i % 3) ? ENABLE : DISABLE);
+        if (!nvm_log_is_pending())
+        {
+            for (uint8_t key = 0; key < TEST_KEY_NBR; key++) durable[key] = written[key];
+        }
+    }
+    return nvm_flash_sim_get_op_cnt();
+}
+
+static void test_power_loss(void)
+{
+    uint64_t value;
+    uint32_t write_nbr = 600;
+    uint32_t op_nbr = 0;
+    uint32_t erase_nbr = 0;
+
+    for (int32_t fail = -1; fail < (int32_t)op_nbr || fail == -1; fail++)
+    {
+        uint64_t durable[TEST_KEY_NBR];
+        uint64_t written[TEST_KEY_NBR];
+
+        // Initial values are stored
+        nvm_flash_sim_clear();
+        nvm_log_init();
+        for (uint8_t key = 0; key < TEST_KEY_NBR; key++)
+        {
+            nvm_log_write(key, key);
+            durable[key] = key;
+            written[key] = key;
+        }
+        test_process_all();
+
+        // Lose power at each flash operation of the sequence
+        nvm_flash_sim_power_on();
+        nvm_flash_sim_fail_after(fail);
+        uint32_t cnt = test_write_sequence(durable, written, write_nbr);
+        if (fail == -1)
+        {
+            op_nbr = cnt;
+            erase_nbr = nvm_flash_sim_erase_cnt[0] + nvm_flash_sim_erase_cnt[1];
+        }
+
+        // Each key has a value written to it, not older than the last stored one
+        nvm_flash_sim_power_on();
+        TEST_ASSERT(nvm_log_init() == HAL_OK);
+        for (uint8_t key = 0; key < TEST_KEY_NBR; key++)
+        {
+            TEST_ASSERT(nvm_log_read(key, &value) == HAL_OK);
+            TEST_ASSERT(value % TEST_KEY_NBR == key);
+            TEST_ASSERT(durable[key] <= value && value <= written[key]);
+        }
+
+        // Memory is still usable
+        nvm_log_write(0, 6000);
+        test_process_all();
+        TEST_ASSERT(!nvm_log_is_pending());
+        nvm_log_init();
+        TEST_ASSERT(nvm_log_read(0, &value) == HAL_OK && value == 6000);
+        if (test_fail_cnt) break;
+    }
+    TEST_ASSERT(erase_nbr >= 3);    /* sequence covers some compactions */
+}
+
+int main(void)
+{
+    test_blank_memory();
+    test_append_without_erase();
+    test_wear_leveling();
+    test_power_loss();
+
+    if (test_fail_cnt)
+    {
+        printf("nvm log test: %u failure(s)\n", test_fail_cnt);
+        return 1;
+    }
+    printf("nvm log test: OK\n");
+    return 0;
+}
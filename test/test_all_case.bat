@@ -3,6 +3,14 @@
 :: Run all test cases
 echo.
 echo.
+echo Running nvm simulation test cases
+gcc -Wall -Werror -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -DUSE_HAL_DRIVER -DSTM32G0B1xx -Iannus-mirabilis\Core\Inc -Iannus-mirabilis\Slcan\Inc -Iannus-mirabilis\Drivers\STM32G0xx_HAL_Driver\Inc -Iannus-mirabilis\Drivers\CMSIS\Device\ST\STM32G0xx\Include -Iannus-mirabilis\Drivers\CMSIS\Include -Itest\nvm_sim -o test\nvm_sim\test_nvm_log.exe annus-mirabilis\Slcan\Src\nvm_log.c test\nvm_sim\nvm_flash_sim.c test\nvm_sim\test_nvm_log.c && test\nvm_sim\test_nvm_log.exe
+echo.
+echo.
+echo Running bit timing simulation test cases
+gcc -Wall -Werror -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -DUSE_HAL_DRIVER -DSTM32G0B1xx -Iannus-mirabilis\Core\Inc -Iannus-mirabilis\Slcan\Inc -Iannus-mirabilis\Drivers\STM32G0xx_HAL_Driver\Inc -Iannus-mirabilis\Drivers\CMSIS\Device\ST\STM32G0xx\Include -Iannus-mirabilis\Drivers\CMSIS\Include -o test\bittime_sim\test_bittime.exe annus-mirabilis\Slcan\Src\bittime.c test\bittime_sim\test_bittime.c && test\bittime_sim\test_bittime.exe
+echo.
+echo.
 echo Running slcan test cases
 python test\test_slcan.py
 echo.
@@ -11,6 +19,10 @@ echo Running loopback test cases
 python test\test_loopback.py
 echo.
 echo.
+echo Running port test cases
+python test\test_port.py
+echo.
+echo.
 echo Running error test cases
 python test\test_error.py
 echo.
@@ -2,10 +2,19 @@
 
 # Set permission for USB port
 sudo chmod 666 /dev/ttyACM0
+sudo chmod 666 /dev/ttyACM1
 
 # Run all test cases
 echo ""
 echo ""
+echo "Run nvm simulation test cases"
+gcc -Wall -Werror -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -DUSE_HAL_DRIVER -DSTM32G0B1xx -Iannus-mirabilis/Core/Inc -Iannus-mirabilis/Slcan/Inc -Iannus-mirabilis/Drivers/STM32G0xx_HAL_Driver/Inc -Iannus-mirabilis/Drivers/CMSIS/Device/ST/STM32G0xx/Include -Iannus-mirabilis/Drivers/CMSIS/Include -Itest/nvm_sim -o test/nvm_sim/test_nvm_log annus-mirabilis/Slcan/Src/nvm_log.c test/nvm_sim/nvm_flash_sim.c test/nvm_sim/test_nvm_log.c && ./test/nvm_sim/test_nvm_log
+echo ""
+echo ""
+echo "Run bit timing simulation test cases"
+gcc -Wall -Werror -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -DUSE_HAL_DRIVER -DSTM32G0B1xx -Iannus-mirabilis/Core/Inc -Iannus-mirabilis/Slcan/Inc -Iannus-mirabilis/Drivers/STM32G0xx_HAL_Driver/Inc -Iannus-mirabilis/Drivers/CMSIS/Device/ST/STM32G0xx/Include -Iannus-mirabilis/Drivers/CMSIS/Include -o test/bittime_sim/test_bittime annus-mirabilis/Slcan/Src/bittime.c test/bittime_sim/test_bittime.c && ./test/bittime_sim/test_bittime
+echo ""
+echo ""
 echo "Run slcan test cases"
 python3 test/test_slcan.py
 echo ""
@@ -14,6 +23,10 @@ echo "Run loopback test cases"
 python3 test/test_loopback.py
 echo ""
 echo ""
+echo "Run port test cases"
+python3 test/test_port.py
+echo ""
+echo ""
 echo "Run error test cases"
 python3 test/test_error.py
 echo ""
@@ -25,6 +38,7 @@ echo ""
 echo "Reset the device then press enter..."
 read input
 sudo chmod 666 /dev/ttyACM0
+sudo chmod 666 /dev/ttyACM1
 echo ""
 echo ""
 echo "Run test after reset"
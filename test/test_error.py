@@ -86,6 +86,47 @@ class ErrorTestCase(unittest.TestCase):
         self.assertEqual(self.dut.receive(), b"\r")
 
 
+    def test_tx_limit(self):
+        #self.dut.print_on = True
+        self.dut.send(b"E\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # cancel frames not acknowledged in 50ms
+        self.dut.send(b"-1000032\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"O\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t0000\r")
+        self.assertEqual(self.dut.receive(), b"z\r")
+        self.dut.send(b"T000000010\r")
+        self.assertEqual(self.dut.receive(), b"z\r")
+        time.sleep(0.2)
+        self.assertEqual(self.dut.receive(), b"c2000\r" + b"C200000001\r")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # cancel frames after 5 retries
+        self.dut.send(b"-1050000\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"O\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t0000\r")
+        self.assertEqual(self.dut.receive(), b"z\r")
+        time.sleep(0.2)
+        self.assertEqual(self.dut.receive(), b"c1000\r")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        self.dut.send(b"e\r")
+        self.assertTrue(self.dut.receive().endswith(b", tx_cancel_retry_expiry=[1, 2]\r"))
+        self.dut.send(b"-10\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"-1\r")  # Enable auto retransmission without limit
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"E\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+
     def test_error_passive(self):
         #self.dut.print_on = True
         self.dut.send(b"O\r")
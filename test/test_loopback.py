@@ -560,6 +560,274 @@ class LoopbackTestCase(unittest.TestCase):
         self.assertEqual(self.dut.receive(), b"\r")
 
 
+    def test_sequence_on(self):
+        # check sequence number in rx frame and tx event
+        self.dut.send(b"z0023\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        for i in range(0, 3):
+            self.dut.send(b"t03F0\r")
+            rx_data = self.dut.receive()
+            seq = b"%04X" % i
+            self.assertEqual(len(rx_data), len(b"\r" + b"zt03F0" + seq + b"\r" + b"t03F0" + seq + b"\r"))
+            if rx_data[1] == b"z"[0]:
+                self.assertEqual(rx_data, b"\r" + b"zt03F0" + seq + b"\r" + b"t03F0" + seq + b"\r")
+            else:
+                self.assertEqual(rx_data, b"\r" + b"t03F0" + seq + b"\r" + b"zt03F0" + seq + b"\r")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # sequence restarts on open
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t03F0\r")
+        rx_data = self.dut.receive()
+        self.assertTrue(b"t03F00000\r" in rx_data)
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"z0001\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+
+    def test_tx_latency(self):
+        # check latency in tx event and the histogram
+        self.dut.send(b"E\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"e\r")
+        self.assertEqual(self.dut.receive(), b"e: tx_latency_us_p50_p99_max=[0, 0, 0], tx_latency_cnt=0"
+                                             b", rx_latency_us_p50_p99_max=[0, 0, 0], rx_latency_cnt=0"
+                                             b", tx_attempt_frame_cnt=0, tx_arb_lost_cnt=0, tx_err_retry_cnt=0, tx_attempt_max=0"
+                                             b", tx_cancel_retry_expiry=[0, 0]\r")
+        self.dut.send(b"z0042\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        for i in range(0, 10):
+            self.dut.send(b"t03F0\r")
+            rx_data = self.dut.receive()
+            self.assertEqual(len(rx_data), len(b"\r" + b"zt03F0" + b"XXXX" + b"\r"))
+            self.assertEqual(rx_data[0:6], b"\r" + b"zt03F0")
+            self.assertLess(int(rx_data[6:10], 16), 0x1000)
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        self.dut.send(b"e\r")
+        rx_data = self.dut.receive()
+        self.assertEqual(rx_data[0:30], b"e: tx_latency_us_p50_p99_max=[")
+        self.assertTrue(rx_data.endswith(b"], rx_latency_cnt=0"
+                                         b", tx_attempt_frame_cnt=0, tx_arb_lost_cnt=0, tx_err_retry_cnt=0, tx_attempt_max=0"
+                                         b", tx_cancel_retry_expiry=[0, 0]\r"))
+        tx_part = rx_data[30:rx_data.index(b", rx_latency")]
+        self.assertTrue(tx_part.endswith(b"], tx_latency_cnt=10"))
+        lat = [int(v) for v in tx_part[:-20].split(b", ")]
+        self.assertTrue(lat[0] <= lat[1] <= lat[2])
+        self.dut.send(b"e0\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"E\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"z0001\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+
+    def test_tx_attempt(self):
+        # check attempts in tx event, not counted in loopback mode
+        self.dut.send(b"z0082\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t03F0\r")
+        self.assertEqual(self.dut.receive(), b"\r" + b"zt03F0" + b"01" + b"\r")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # attempts follow latency
+        self.dut.send(b"z00C2\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t03F0\r")
+        rx_data = self.dut.receive()
+        self.assertEqual(len(rx_data), len(b"\r" + b"zt03F0" + b"XXXX" + b"01" + b"\r"))
+        self.assertEqual(rx_data[0:6], b"\r" + b"zt03F0")
+        self.assertEqual(rx_data[10:], b"01" + b"\r")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        self.dut.send(b"e\r")
+        self.assertTrue(self.dut.receive().endswith(b", tx_attempt_frame_cnt=0, tx_arb_lost_cnt=0, tx_err_retry_cnt=0, tx_attempt_max=0"
+                                                    b", tx_cancel_retry_expiry=[0, 0]\r"))
+        self.dut.send(b"z0001\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+
+    def test_rx_latency(self):
+        # check the histogram of rx frames handed to USB
+        self.dut.send(b"E\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        for i in range(0, 10):
+            self.dut.send(b"t03F0\r")
+            self.assertEqual(self.dut.receive(), b"z\rt03F0\r")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        self.dut.send(b"e\r")
+        rx_data = self.dut.receive()
+        self.assertTrue(rx_data.startswith(b"e: tx_latency_us_p50_p99_max=["))
+        rx_part = rx_data[rx_data.index(b", rx_latency_us_p50_p99_max=[") + 29:rx_data.index(b", tx_attempt")]
+        self.assertTrue(rx_part.endswith(b"], rx_latency_cnt=10"))
+        lat = [int(v) for v in rx_part[:-20].split(b", ")]
+        self.assertTrue(lat[0] <= lat[1] <= lat[2])
+        self.assertLess(lat[2], 100000)
+        self.dut.send(b"E\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+
+    def test_bus_load_sample(self):
+        # check frames counted in the bus load samples
+        self.dut.send(b"l00640\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        for i in range(0, 10):
+            self.dut.send(b"t03F0\r")
+            self.assertEqual(self.dut.receive(), b"z\rt03F0\r")
+        time.sleep(0.3)
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        self.dut.send(b"l\r")
+        rx_data = self.dut.receive()
+        self.assertEqual(rx_data[0:1], b"l")
+        self.assertEqual((len(rx_data) - 2) % 20, 0)
+        samples = [rx_data[i:i + 20] for i in range(1, len(rx_data) - 1, 20)]
+        self.assertGreaterEqual(len(samples), 3)
+        self.assertEqual(sum([int(s[8:12], 16) for s in samples]), 10)
+        self.assertGreaterEqual(sum([int(s[0:8], 16) for s in samples]), 10 * 44)
+        self.assertEqual(sum([int(s[12:16], 16) for s in samples]), 0)
+        self.dut.send(b"l\r")
+        self.assertEqual(self.dut.receive(), b"l\r")
+
+        self.dut.send(b"l00002\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"l0000\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"l00000\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+
+    def test_payload_filter(self):
+        # report only classical data frames with the first data byte 0x11
+        self.dut.send(b"G0218" + b"1100000000000000" + b"00FFFFFFFFFFFFFF\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t100111\r")
+        self.assertEqual(self.dut.receive(), b"z\rt100111\r")
+        self.dut.send(b"t100122\r")
+        self.assertEqual(self.dut.receive(), b"z\r")
+        self.dut.send(b"t1000\r")
+        self.assertEqual(self.dut.receive(), b"z\r")
+        self.dut.send(b"d100111\r")
+        self.assertEqual(self.dut.receive(), b"z\r")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # report all after clear
+        self.dut.send(b"G0\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t100122\r")
+        self.assertEqual(self.dut.receive(), b"z\rt100122\r")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # invalid format
+        self.dut.send(b"G0281\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"G0281" + b"1100000000000000" + b"00FFFFFFFFFFFFFF\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+
+
+    def test_filter_id_set(self):
+        # accept only the CAN IDs in the set
+        self.dut.send(b"H\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"H100101102200\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"h18DB33F1\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"W3\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"h\r")
+        self.assertEqual(self.dut.receive(), b"h: ids_std_ext=[4, 1], filters_std_ext=[2, 1], false_accept_std_ext=[0, 0], false_accept_ppm=0\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t1020\r")
+        self.assertEqual(self.dut.receive(), b"z\rt1020\r")
+        self.dut.send(b"t1030\r")
+        self.assertEqual(self.dut.receive(), b"z\r")
+        self.dut.send(b"T18DB33F10\r")
+        self.assertEqual(self.dut.receive(), b"Z\rT18DB33F10\r")
+        self.dut.send(b"T18DB33F20\r")
+        self.assertEqual(self.dut.receive(), b"Z\r")
+
+        # changes are applied without closing
+        self.dut.send(b"H300\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t3000\r")
+        self.assertEqual(self.dut.receive(), b"z\rt3000\r")
+        self.dut.send(b"W2\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t1030\r")
+        self.assertEqual(self.dut.receive(), b"z\rt1030\r")
+        self.dut.send(b"W3\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t1030\r")
+        self.assertEqual(self.dut.receive(), b"z\r")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # false accepts of the hardware are discarded by the firmware
+        self.dut.send(b"H\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        for i in range(0, 6):
+            ids = b"".join(format((i * 10 + j) * 0x10, "03X").encode() for j in range(0, 10))
+            self.dut.send(b"H" + ids + b"\r")
+            self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"h\r")
+        self.assertEqual(self.dut.receive(), b"h: ids_std_ext=[60, 0], filters_std_ext=[28, 0], false_accept_std_ext=[75, 0], false_accept_ppm=555555\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t3600\r")
+        self.assertEqual(self.dut.receive(), b"z\rt3600\r")
+        self.dut.send(b"t3610\r")
+        self.assertEqual(self.dut.receive(), b"z\r")
+        self.dut.send(b"t0100\r")
+        self.assertEqual(self.dut.receive(), b"z\rt0100\r")
+        self.dut.send(b"t0110\r")
+        self.assertEqual(self.dut.receive(), b"z\r")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # back to the simple filter mode
+        self.dut.send(b"H\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"W2\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # invalid format
+        self.dut.send(b"H10\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"H800\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"h20000000\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+
+
     def test_esi_on(self):
         cmd_send_std = (b"r", b"t", b"d", b"b")
         cmd_send_ext = (b"R", b"T", b"D", b"B")
@@ -734,6 +1002,53 @@ class LoopbackTestCase(unittest.TestCase):
         self.assertEqual(self.dut.receive(), b"\r")
         
 
+    def test_filter_live(self):
+        #self.dut.print_on = True
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t03F0\r")
+        self.assertEqual(self.dut.receive(), b"z\rt03F0\r")
+
+        # narrow to 0x03F without closing
+        self.dut.send(b"M0000003F\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"mFFFFF800\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t03F0\r")
+        self.assertEqual(self.dut.receive(), b"z\rt03F0\r")
+        self.dut.send(b"t7C00\r")
+        self.assertEqual(self.dut.receive(), b"z\r")
+        self.dut.send(b"T0000003F0\r")
+        self.assertEqual(self.dut.receive(), b"Z\r")
+
+        # widen again
+        self.dut.send(b"mFFFFFFFF\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t7C00\r")
+        self.assertEqual(self.dut.receive(), b"z\rt7C00\r")
+        self.dut.send(b"T0000003F0\r")
+        self.assertEqual(self.dut.receive(), b"Z\rT0000003F0\r")
+
+        # switch the report settings without closing
+        self.dut.send(b"Z1\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t03F0\r")
+        rx_data = self.dut.receive()
+        self.assertEqual(rx_data[0:7], b"z\rt03F0")
+        self.assertEqual(len(rx_data), len(b"z\rt03F0XXXX\r"))
+        self.dut.send(b"z0002\r")    # Tx on, Rx off
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t03F0\r")
+        self.assertEqual(self.dut.receive(), b"\rzt03F0\r")
+        self.dut.send(b"Z0\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t03F0\r")
+        self.assertEqual(self.dut.receive(), b"z\rt03F0\r")
+
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+
     def test_filter_every_bits(self):
         # receive std
         self.dut.send(b"M80000000\r")
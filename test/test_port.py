@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+
+import unittest
+
+import time
+from device_under_test import DeviceUnderTest
+
+
+class PortTestCase(unittest.TestCase):
+
+    print_on: bool
+    dut: DeviceUnderTest
+    ctrl: DeviceUnderTest
+
+    def setUp(self):
+        self.dut = DeviceUnderTest()
+        self.dut.open()
+        self.dut.setup()
+        self.ctrl = DeviceUnderTest()
+        self.ctrl.open(ctrl=True)
+        self.ctrl.send(b"\r\r\r")
+        self.ctrl.receive()
+
+
+    def tearDown(self):
+        # close serial
+        self.ctrl.close()
+        self.dut.close()
+
+
+    def test_ctrl_port_reply(self):
+        # check response only comes back on the port of the command
+        self.ctrl.send(b"V\r")
+        rx_data = self.ctrl.receive()
+        self.assertEqual(len(rx_data), len(b"V1013\r"))
+        self.assertEqual(rx_data[0], b"V1013\r"[0])
+        self.assertEqual(self.dut.receive(), b"")
+
+        self.ctrl.send(b"V0\r")
+        self.assertEqual(self.ctrl.receive(), b"\a")
+        self.assertEqual(self.dut.receive(), b"")
+
+        # data port still accepts commands
+        self.dut.send(b"V\r")
+        self.assertEqual(len(self.dut.receive()), len(b"V1013\r"))
+        self.assertEqual(self.ctrl.receive(), b"")
+
+
+    def test_ctrl_port_status(self):
+        # open on data port, poll status on control port
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.ctrl.send(b"F\r")
+        self.assertEqual(self.ctrl.receive(), b"F00\r")
+        self.ctrl.send(b"f\r")
+        self.assertEqual(self.ctrl.receive()[0], b"f"[0])
+        self.assertEqual(self.dut.receive(), b"")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+
+    def test_ctrl_port_load_stream(self):
+        # stream a bus load sample every 100ms on control port only
+        self.dut.send(b"l00641\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        time.sleep(0.35)
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        rx_data = self.ctrl.receive()
+        self.assertEqual(rx_data[-1:], b"\r")
+        lines = rx_data[:-1].split(b"\r")
+        self.assertGreaterEqual(len(lines), 3)
+        for line in lines:
+            self.assertEqual(line, b"l" + b"0" * 20)
+
+        self.ctrl.send(b"l00000\r")
+        self.assertEqual(self.ctrl.receive(), b"\r")
+        self.assertEqual(self.dut.receive(), b"")
+
+
+    def test_ctrl_port_frame(self):
+        # frames sent from control port are reported on data port only
+        self.dut.send(b"Z1\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.ctrl.send(b"t03F0\r")
+        self.assertEqual(self.ctrl.receive(), b"z\r")
+        rx_data = self.dut.receive()
+        self.assertEqual(rx_data[0:5], b"t03F0")
+        self.assertEqual(len(rx_data), len(b"t03F0XXXX\r"))
+
+        # status poll does not interleave with the frame stream
+        for i in range(0, 10):
+            self.ctrl.send(b"F\r")
+            self.dut.send(b"t03F0\r")
+        time.sleep(0.1)
+        rx_ctrl = self.ctrl.receive()
+        rx_data = self.dut.receive()
+        self.assertEqual(rx_ctrl, b"F00\r" * 10)
+        self.assertEqual(rx_data.count(b"F00\r"), 0)
+        self.assertEqual(rx_data.count(b"z\r"), 10)
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"Z0\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -22,6 +22,35 @@ class LoopbackTestCase(unittest.TestCase):
         self.dut.close()
 
 
+    def test_profile(self):
+        #self.dut.print_on = True
+
+        # default profile, pass all without timestamp
+        self.dut.send(b"p0\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t7C00\r")
+        self.assertEqual(self.dut.receive(), b"z\rt7C00\r")
+
+        # stored profile, closes the channel and pass 0x03F with timestamp
+        self.dut.send(b"p1\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t03F0\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t03F0\r")
+        rx_data = self.dut.receive()
+        self.assertEqual(len(rx_data), len(b"z\rt03F0TTTT\r"))
+        self.assertEqual(rx_data[0:-5], b"z\rt03F0")
+        self.dut.send(b"t7C00\r")
+        self.assertEqual(self.dut.receive(), b"z\r")
+
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+
     def test_serial(self):
         self.dut.send(b"N\r")
         self.assertEqual(self.dut.receive(), b"NA123\r")
@@ -44,6 +44,11 @@ class LoopbackTestCase(unittest.TestCase):
         self.dut.send(b"C\r")
         self.assertEqual(self.dut.receive(), b"\r")
 
+        # store the same setting as profile 1, channel kept closed
+        self.dut.send(b"p10\r")
+        time.sleep(0.1)         # Extra wait for flash update
+        self.assertEqual(self.dut.receive(), b"\r")
+
         # update setting in RAM
         self.dut.send(b"z0000\r")
         self.assertEqual(self.dut.receive(), b"\r")
@@ -2,6 +2,7 @@
 
 import unittest
 
+import re
 import time
 from device_under_test import DeviceUnderTest
 
@@ -135,7 +136,81 @@ class ShortTestCase(unittest.TestCase):
         self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"-1\r")  # Enable auto retransmission
         self.assertEqual(self.dut.receive(), b"\r")
-        
+
+
+
+    def read_bus_off_stat(self) -> tuple:
+        # bus off count, recovery count and bus off durations in ms
+        self.dut.send(b"o\r")
+        rx_data = self.dut.receive()
+        match = re.fullmatch(rb"o: bus_off_cnt=(\d+), recovery_cnt=(\d+), bus_off_ms_last_max_total=\[(\d+), (\d+), (\d+)\]\r", rx_data)
+        self.assertIsNotNone(match)
+        return tuple(int(x) for x in match.groups())
+
+
+    def test_bus_off_recovery(self):
+        #self.dut.print_on = True
+        # check setting
+        self.dut.send(b"o2000000\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"o000000\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"o0000000\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # cannot recover when closed or not bus off
+        self.dut.send(b"u\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"O\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"u\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"u0\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+
+        # manual recovery keeps the channel open
+        stat = self.read_bus_off_stat()
+        self.dut.send(b"t0000\r")
+        self.assertEqual(self.dut.receive(), b"z\r")
+        time.sleep(0.1)     # wait for bus off ( > 1ms * 255 / 8)
+        self.dut.send(b"F\r")
+        self.dut.receive()
+        self.dut.send(b"f\r")
+        self.assertEqual(self.dut.receive()[0:17], b"f: node_sts=BUS_O")
+        time.sleep(0.1)
+        self.dut.send(b"O\r")
+        self.assertEqual(self.dut.receive(), b"\a")     # O does not recover
+        self.dut.send(b"u\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        time.sleep(0.1)
+        new = self.read_bus_off_stat()
+        self.assertGreaterEqual(new[0], stat[0] + 1)
+        self.assertEqual(new[1], stat[1] + 1)
+        self.assertGreaterEqual(new[4], stat[4] + 100)
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # automatic recovery after 50ms, up to twice
+        self.dut.send(b"o1003202\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"O\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        stat = self.read_bus_off_stat()
+        for i in range(0, 3):
+            self.dut.send(b"t0000\r")
+            self.dut.receive()
+            time.sleep(0.2)
+        new = self.read_bus_off_stat()
+        self.assertGreaterEqual(new[0], stat[0] + 1)
+        self.assertLessEqual(new[1], stat[1] + 2)
+        self.assertGreaterEqual(new[1], stat[1] + 1)
+        self.assertGreaterEqual(new[2], 50)
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        self.dut.send(b"o0000000\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -229,14 +229,73 @@ class SlcanTestCase(unittest.TestCase):
         self.dut.send(b"s0G460908\r")
         self.assertEqual(self.dut.receive(), b"\a")
 
+        # check read back
+        self.dut.send(b"s10460908\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"s\r")
+        self.assertEqual(self.dut.receive(), b"s10460908\r")
+        self.dut.send(b"S4\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"s\r")
+        self.assertEqual(self.dut.receive(), b"s04690E0D\r")
+
+
+    def test_S_target_command(self):
+        # check solved timing against the table of S command
+        for idx in range(0, 9):
+            self.dut.send(b"S" + str(idx).encode() + b"\r")
+            self.assertEqual(self.dut.receive(), b"\r")
+            table = self.get_bit_timing(b"s")
+
+            self.dut.send(b"S%06X%03X%02X\r" % (self.calc_bitrate(table), self.calc_sample_point(table), table[3]))
+            self.assertEqual(self.dut.receive(), b"\r")
+            solved = self.get_bit_timing(b"s")
+            self.assertEqual(self.calc_bitrate(solved), self.calc_bitrate(table))
+            self.assertEqual(self.calc_sample_point(solved), self.calc_sample_point(table))
+            self.assertEqual(solved[3], table[3])
+
+        # automatic sjw and arbitrary bitrate
+        self.dut.send(b"S01458536B00\r")             # 83.333kbps, 87.5%
+        self.assertEqual(self.dut.receive(), b"\r")
+        solved = self.get_bit_timing(b"s")
+        self.assertEqual(self.calc_bitrate(solved), 83333)
+        self.assertEqual(solved[3], solved[2])
+
+        # check response in CAN normal mode
+        self.dut.send(b"O\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"S07A12036B00\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # not possible
+        self.dut.send(b"S00000036B00\r")             # zero bitrate
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"S07A12000000\r")             # zero sample point
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"S07A1203E800\r")             # 100% sample point
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"S07A12036B81\r")             # sjw out of range
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"S7A120036B00\r")             # 8Mbps, not possible on 60MHz clock
+        self.assertEqual(self.dut.receive(), b"\a")
+
+        # invalid format
+        self.dut.send(b"S07A12036B0\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"S07A12036B0G\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"S4\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
 
     def test_Y_command(self):
         # check response to Y with CAN port closed
         for idx in range(0, 10):
             cmd = "Y" + str(idx) + "\r"
             self.dut.send(cmd.encode())
-            #if idx in (0, 1, 2, 4, 5, 8):
-            if idx in (0, 1, 2, 3, 4, 5):
+            if idx in (0, 1, 2, 3, 4, 5, 6):
                 self.assertEqual(self.dut.receive(), b"\r")
             else:
                 self.assertEqual(self.dut.receive(), b"\a")
@@ -323,6 +382,111 @@ class SlcanTestCase(unittest.TestCase):
         self.dut.send(b"y0G1E0908\r")
         self.assertEqual(self.dut.receive(), b"\a")
 
+        # check read back
+        self.dut.send(b"y021E0908\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"y\r")
+        self.assertEqual(self.dut.receive(), b"y021E0908\r")
+        self.dut.send(b"Y2\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"y\r")
+        self.assertEqual(self.dut.receive(), b"y020A0403\r")
+
+
+    def test_Y_target_command(self):
+        # check solved timing against the table of Y command
+        for idx in range(0, 7):
+            self.dut.send(b"Y" + str(idx).encode() + b"\r")
+            self.assertEqual(self.dut.receive(), b"\r")
+            table = self.get_bit_timing(b"y")
+
+            self.dut.send(b"Y%06X%03X%02X\r" % (self.calc_bitrate(table), self.calc_sample_point(table), table[3]))
+            self.assertEqual(self.dut.receive(), b"\r")
+            solved = self.get_bit_timing(b"y")
+            self.assertEqual(self.calc_bitrate(solved), self.calc_bitrate(table))
+            self.assertEqual(self.calc_sample_point(solved), self.calc_sample_point(table))
+            self.assertEqual(solved[3], table[3])
+
+        # loopback at the solved timing
+        self.dut.send(b"Y1E848032000\r")             # 2Mbps, 80%
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"b03F80011223344556677\r")
+        self.assertEqual(self.dut.receive(), b"z\rb03F80011223344556677\r")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # not possible on 60MHz clock
+        self.dut.send(b"Y7A120032000\r")             # 8Mbps
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"Y00823532000\r")             # 33.333kbps, too slow for data prescaler
+        self.assertEqual(self.dut.receive(), b"\a")
+
+        # invalid format
+        self.dut.send(b"Y1E84803200\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"Y2\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+
+    def test_a_command(self):
+        # no other node on the bus, nothing to detect
+        timing = self.get_bit_timing(b"s")
+        self.dut.send(b"a\r")
+        time.sleep(1)                               # takes up to 1.6 sec
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.assertEqual(self.get_bit_timing(b"s"), timing)  # setting is kept
+
+        # other commands are handled during detection, settings are locked
+        self.dut.send(b"a\r")
+        self.dut.send(b"V\r")
+        self.assertEqual(self.dut.receive(), b"VW1AM\r")
+        self.dut.send(b"O\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"S4\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"a\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+
+        # C cancels the detection, the pending a is answered first
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\a\r")
+        self.assertEqual(self.get_bit_timing(b"s"), timing)  # setting is kept
+
+        # channel still works after detection
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t03F0\r")
+        self.assertEqual(self.dut.receive(), b"z\rt03F0\r")
+
+        # not allowed while open
+        self.dut.send(b"a\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # invalid format
+        self.dut.send(b"a0\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+
+
+    def get_bit_timing(self, cmd: bytes) -> tuple:
+        # read prescaler, time seg1, time seg2 and sjw
+        self.dut.send(cmd + b"\r")
+        rx_data = self.dut.receive()
+        self.assertEqual(len(rx_data), len(b"sddxxyyzz\r"))
+        self.assertEqual(rx_data[0:1], cmd)
+        return tuple(int(rx_data[i:i + 2], 16) for i in (1, 3, 5, 7))
+
+
+    def calc_bitrate(self, timing: tuple) -> int:
+        return 60000000 // (timing[0] * (1 + timing[1] + timing[2]))
+
+
+    def calc_sample_point(self, timing: tuple) -> int:
+        return round(1000 * (1 + timing[1]) / (1 + timing[1] + timing[2]))
+
 
     def test_Z_command(self):
         # Without option
@@ -364,7 +528,10 @@ class SlcanTestCase(unittest.TestCase):
         for idx in range(0, 10):
             cmd = "Z" + str(idx) + "\r"
             self.dut.send(cmd.encode())
-            self.assertEqual(self.dut.receive(), b"\a")
+            if idx in range(0, 3):
+                self.assertEqual(self.dut.receive(), b"\r")
+            else:
+                self.assertEqual(self.dut.receive(), b"\a")
         self.dut.send(b"C\r")
         self.assertEqual(self.dut.receive(), b"\r")
 
@@ -374,7 +541,10 @@ class SlcanTestCase(unittest.TestCase):
         for idx in range(0, 10):
             cmd = "Z" + str(idx) + "\r"
             self.dut.send(cmd.encode())
-            self.assertEqual(self.dut.receive(), b"\a")
+            if idx in range(0, 3):
+                self.assertEqual(self.dut.receive(), b"\r")
+            else:
+                self.assertEqual(self.dut.receive(), b"\a")
         self.dut.send(b"C\r")
         self.assertEqual(self.dut.receive(), b"\r")
 
@@ -408,7 +578,10 @@ class SlcanTestCase(unittest.TestCase):
         for idx in range(0, 10):
             cmd = "z" + str(idx) + "000\r"
             self.dut.send(cmd.encode())
-            self.assertEqual(self.dut.receive(), b"\a")
+            if idx in range(0, 3):
+                self.assertEqual(self.dut.receive(), b"\r")
+            else:
+                self.assertEqual(self.dut.receive(), b"\a")
         self.dut.send(b"C\r")
         self.assertEqual(self.dut.receive(), b"\r")
 
@@ -418,7 +591,10 @@ class SlcanTestCase(unittest.TestCase):
         for idx in range(0, 10):
             cmd = "z" + str(idx) + "000\r"
             self.dut.send(cmd.encode())
-            self.assertEqual(self.dut.receive(), b"\a")
+            if idx in range(0, 3):
+                self.assertEqual(self.dut.receive(), b"\r")
+            else:
+                self.assertEqual(self.dut.receive(), b"\a")
         self.dut.send(b"C\r")
         self.assertEqual(self.dut.receive(), b"\r")
 
@@ -502,28 +678,40 @@ class SlcanTestCase(unittest.TestCase):
         for idx in range(0, 10):
             cmd = "W" + str(idx) + "\r"
             self.dut.send(cmd.encode())
-            if idx == 2:
+            if idx == 2 or idx == 3:
                 self.assertEqual(self.dut.receive(), b"\r")
             else:
                 self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"W2\r")
+        self.assertEqual(self.dut.receive(), b"\r")
 
-        # check response in CAN normal mode
+        # check response in CAN normal mode, applied without closing
         self.dut.send(b"O\r")
         self.assertEqual(self.dut.receive(), b"\r")
         for idx in range(0, 10):
             cmd = "W" + str(idx) + "\r"
             self.dut.send(cmd.encode())
-            self.assertEqual(self.dut.receive(), b"\a")
+            if idx == 2 or idx == 3:
+                self.assertEqual(self.dut.receive(), b"\r")
+            else:
+                self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"W2\r")
+        self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"C\r")
         self.assertEqual(self.dut.receive(), b"\r")
 
-        # check response in CAN silent mode
+        # check response in CAN silent mode, applied without closing
         self.dut.send(b"L\r")
         self.assertEqual(self.dut.receive(), b"\r")
         for idx in range(0, 10):
             cmd = "W" + str(idx) + "\r"
             self.dut.send(cmd.encode())
-            self.assertEqual(self.dut.receive(), b"\a")
+            if idx == 2 or idx == 3:
+                self.assertEqual(self.dut.receive(), b"\r")
+            else:
+                self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"W2\r")
+        self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"C\r")
         self.assertEqual(self.dut.receive(), b"\r")
 
@@ -547,9 +735,9 @@ class SlcanTestCase(unittest.TestCase):
         self.dut.send(b"O\r")
         self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"M00000000\r")
-        self.assertEqual(self.dut.receive(), b"\a")
+        self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"MFFFFFFFF\r")
-        self.assertEqual(self.dut.receive(), b"\a")
+        self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"C\r")
         self.assertEqual(self.dut.receive(), b"\r")
 
@@ -557,9 +745,9 @@ class SlcanTestCase(unittest.TestCase):
         self.dut.send(b"L\r")
         self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"M00000000\r")
-        self.assertEqual(self.dut.receive(), b"\a")
+        self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"MFFFFFFFF\r")
-        self.assertEqual(self.dut.receive(), b"\a")
+        self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"C\r")
         self.assertEqual(self.dut.receive(), b"\r")
 
@@ -583,9 +771,9 @@ class SlcanTestCase(unittest.TestCase):
         self.dut.send(b"O\r")
         self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"m00000000\r")
-        self.assertEqual(self.dut.receive(), b"\a")
+        self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"mFFFFFFFF\r")
-        self.assertEqual(self.dut.receive(), b"\a")
+        self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"C\r")
         self.assertEqual(self.dut.receive(), b"\r")
 
@@ -593,9 +781,9 @@ class SlcanTestCase(unittest.TestCase):
         self.dut.send(b"L\r")
         self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"m00000000\r")
-        self.assertEqual(self.dut.receive(), b"\a")
+        self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"mFFFFFFFF\r")
-        self.assertEqual(self.dut.receive(), b"\a")
+        self.assertEqual(self.dut.receive(), b"\r")
         self.dut.send(b"C\r")
         self.assertEqual(self.dut.receive(), b"\r")
 
@@ -654,6 +842,146 @@ class SlcanTestCase(unittest.TestCase):
         self.assertEqual(self.dut.receive(), b"\r")
 
 
+    def test_q_command(self):
+        # check response after the channel was opened once
+        self.dut.send(b"O\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"q\r")
+        rx_data = self.dut.receive()
+        self.assertEqual(rx_data[0:19], b"q: boot_to_open_us=")
+        self.assertEqual(rx_data[-1:], b"\r")
+        self.assertTrue(rx_data[19:-1].isdigit())
+
+        # value does not change on reopen
+        self.dut.send(b"O\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"q\r")
+        self.assertEqual(self.dut.receive(), rx_data)
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # invalid format
+        self.dut.send(b"q0\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+
+
+    def test_p_command(self):
+        # check default profile closes the channel
+        self.dut.send(b"O\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"p0\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"F\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+
+        # check stored profile opens the channel in listen only mode
+        self.dut.send(b"Z2\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"p32\r")
+        time.sleep(0.1)         # Extra wait for flash update
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"p0\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"p3\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"F\r")
+        self.assertEqual(self.dut.receive(), b"F00\r")
+        self.dut.send(b"t03F0\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+
+        # check invalid profile keeps the channel open
+        self.dut.send(b"p4\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"F\r")
+        self.assertEqual(self.dut.receive(), b"F00\r")
+        self.dut.send(b"p0\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # invalid format
+        self.dut.send(b"p\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"p4\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"p00\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"p13\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"p40\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"p0000\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"pG\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+
+
+    def test_j_command(self):
+        # check format
+        self.dut.send(b"J\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"j\r")
+        rx_data = self.dut.receive()
+        self.assertEqual(rx_data[0:27], b"j: loss_can_rx0_rx1_txe=[0x")
+        self.assertEqual(rx_data[-1:], b"\r")
+        self.assertEqual(rx_data.count(b"0x"), 22)
+
+        # no loss at low load
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        for i in range(0, 10):
+            self.dut.send(b"t03F0\r")
+        self.dut.receive()
+        self.dut.send(b"j\r")
+        rx_data = self.dut.receive()
+        self.assertTrue(b"loss_can_rx0_rx1_txe=[0x00000000, 0x00000000, 0x00000000]" in rx_data)
+        self.assertTrue(b"loss_can_tx_queue_add=[0x00000000, 0x00000000]" in rx_data)
+        self.assertFalse(b"peak_can_tx_queue=0x0000," in rx_data)
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # invalid format
+        self.dut.send(b"j0\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"J0\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+
+
+    def test_K_command(self):
+        # set and clear rules
+        for n in range(0, 3):
+            self.dut.send(b"K" + str(n).encode() + b"80000100FFFFF800\r")
+            self.assertEqual(self.dut.receive(), b"\r")
+            self.dut.send(b"K" + str(n).encode() + b"\r")
+            self.assertEqual(self.dut.receive(), b"\r")
+
+        # frames are not shed at low load
+        self.dut.send(b"K080000100FFFFF800\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"J\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"t2000\r")
+        self.assertEqual(self.dut.receive(), b"z\rt2000\r")
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"j\r")
+        self.assertTrue(b"loss_shed_class0_3=[0x00000000, 0x00000000, 0x00000000, 0x00000000]" in self.dut.receive())
+        self.dut.send(b"K0\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        # invalid format
+        self.dut.send(b"K3\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"K380000100FFFFF800\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"K080000100FFFFF8\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+        self.dut.send(b"K\r")
+        self.assertEqual(self.dut.receive(), b"\a")
+
+
     def test_send_command(self):
         cmd_send_std = (b"r", b"t", b"d", b"b")
         cmd_send_ext = (b"R", b"T", b"D", b"B")
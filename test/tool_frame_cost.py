@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+
+import unittest
+
+import time
+from device_under_test import DeviceUnderTest
+
+
+# Frames of each measurement
+ROUND_TRIP_NBR = 1000
+BURST_NBR = 32
+BURST_ROUND_NBR = 20
+
+# Frame looped back by the device, classical and CAN FD with bit rate switch
+FRAME_CLASSIC = b"t03F0"
+FRAME_FD = b"b03FF" + b"00112233445566778899AABBCCDDEEFF" * 4
+
+
+def decode_debug(rx_data: bytes) -> list:
+    # split "?AA-MM[-LLLL[-CCCC]][CR]" into its values, older firmware replies fewer fields
+    return [int(field, 16) for field in rx_data[1:-1].split(b"-")]
+
+
+def percentile(values: list, ratio: float) -> float:
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * ratio))]
+
+
+class FrameCostTestCase(unittest.TestCase):
+
+    dut: DeviceUnderTest
+
+    def setUp(self):
+        self.dut = DeviceUnderTest()
+        self.dut.open()
+
+        # same setup on every firmware to compare, without commands added later
+        self.dut.send(b"\r\r\rC\r")
+        self.dut.receive()
+        self.dut.send(b"S8\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"Y5\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"Z0\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+
+    def tearDown(self):
+        self.dut.send(b"C\r")
+        self.dut.receive()
+        # close serial
+        self.dut.close()
+
+
+    def read_debug(self) -> list:
+        self.dut.send(b"?\r")
+        rx_data = self.dut.receive()
+        self.assertEqual(rx_data[0:1], b"?")
+        return decode_debug(rx_data)
+
+
+    def test_round_trip(self):
+        # time from sending a frame to receiving its report in loopback, one frame at a time
+        # the spread of this time is the latency jitter seen by the host
+        reply = b"z\r" + FRAME_CLASSIC + b"\r"
+        self.read_debug()
+
+        times_us = []
+        for i in range(0, ROUND_TRIP_NBR):
+            start = time.perf_counter()
+            self.dut.send(FRAME_CLASSIC + b"\r")
+            rx_data = self.dut.ser.read_until(reply)
+            times_us.append((time.perf_counter() - start) * 1e6)
+            self.assertEqual(rx_data, reply)
+
+        debug = self.read_debug()
+        print("")
+        print("round trip us: min=%.0f, median=%.0f, p99=%.0f, max=%.0f, jitter(p99-min)=%.0f" %
+              (min(times_us), percentile(times_us, 0.5), percentile(times_us, 0.99), max(times_us),
+               percentile(times_us, 0.99) - min(times_us)))
+        print("debug: " + ", ".join("%d" % value for value in debug))
+
+
+    def run_burst(self, label: str):
+        # frames queued back to back, the debug reply covers the frames of all rounds
+        # the tx reports and the rx reports may interleave, so only the rx frames are counted
+        # by their ID and data, the timestamp behind them differs
+        reply = FRAME_FD[1:]
+        self.read_debug()
+
+        for i in range(0, BURST_ROUND_NBR):
+            self.dut.send((FRAME_FD + b"\r") * BURST_NBR)
+            rx_data = b""
+            while rx_data.count(reply) < BURST_NBR:
+                tmp = self.dut.ser.read_until(reply)
+                self.assertNotEqual(tmp, b"")
+                rx_data = rx_data + tmp
+        self.dut.receive()
+
+        debug = self.read_debug()
+        print("")
+        print("burst of %d x %d FD frames, %s" % (BURST_ROUND_NBR, BURST_NBR, label))
+        # loop cycle time on the polling firmware, time from event post to dispatch on the event driven one
+        print("loop cycle or dispatch delay us: ave=%d, max=%d" % (debug[0], debug[1]))
+        if 3 <= len(debug):
+            print("rx latency max us: %d" % debug[2])
+        if 4 <= len(debug):
+            print("cycles per accepted frame: %d" % debug[3])
+
+
+    def test_burst(self):
+        self.run_burst("no timestamp")
+
+
+    def test_burst_timestamp(self):
+        # the report formatter has the most work with microsecond timestamps
+        self.dut.send(b"C\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"Z2\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.dut.send(b"=\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+        self.run_burst("microsecond timestamp")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+
+import unittest
+
+from device_under_test import DeviceUnderTest
+
+
+# Core clock of the device, counts of the cycle timestamp per microsecond
+CYCLE_PER_US = 60
+
+# Event ids in the same order as enum trace_event in trace.h
+TRACE_EVENT = (
+    "NONE",
+    "USB_RX",
+    "USB_TX_START",
+    "USB_TX_CPLT",
+    "CAN_RX0",
+    "CAN_RX1",
+    "CAN_TX_EVENT",
+    "CAN_TX_SUBMIT",
+    "PARSE_START",
+    "PARSE_END",
+    "FLASH_PROGRAM_START",
+    "FLASH_PROGRAM_END",
+    "FLASH_ERASE_START",
+    "FLASH_ERASE_END",
+)
+
+
+def decode_trace(lines: list) -> tuple:
+    # split "#" replies into (event, payload, cycle) records and the number of lost records
+    records = []
+    lost = 0
+    for line in lines:
+        body = line[1:-1]
+        if len(body) == 8:
+            lost = int(body, 16)
+            continue
+        for i in range(0, len(body), 16):
+            event = int(body[i:i + 8], 16)
+            cycle = int(body[i + 8:i + 16], 16)
+            records.append((event & 0xFF, event >> 8, cycle))
+    return records, lost
+
+
+def render_timeline(records: list) -> list:
+    # one line per record with the time from the first record and from the previous one
+    rows = []
+    if len(records) == 0:
+        return rows
+    first = records[0][2]
+    last = first
+    for event, payload, cycle in records:
+        name = TRACE_EVENT[event] if event < len(TRACE_EVENT) else "UNKNOWN_%02X" % event
+        since_first = ((cycle - first) & 0xFFFFFFFF) / CYCLE_PER_US
+        since_last = ((cycle - last) & 0xFFFFFFFF) / CYCLE_PER_US
+        rows.append("%12.2f us  +%10.2f us  %-20s 0x%06X" % (since_first, since_last, name, payload))
+        last = cycle
+    return rows
+
+
+class TraceDumpTestCase(unittest.TestCase):
+
+    dut: DeviceUnderTest
+
+    def setUp(self):
+        self.dut = DeviceUnderTest()
+        self.dut.open()
+
+
+    def tearDown(self):
+        # close serial
+        self.dut.close()
+
+
+    def test_trace_dump(self):
+        # freeze the trace, read all records and print the timeline
+        # the firmware should be built with TRACE_ENABLE in trace.h
+        self.dut.send(b"#0\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+        lines = []
+        while True:
+            self.dut.send(b"#\r")
+            rx_data = self.dut.receive()
+            self.assertEqual(rx_data[0:1], b"#")
+            lines.append(rx_data.decode())
+            if len(rx_data) == len(b"#LLLLLLLL\r"):
+                break
+
+        records, lost = decode_trace(lines)
+        for row in render_timeline(records):
+            print(row)
+        print("records=%d, lost=%d" % (len(records), lost))
+
+        # restart recording
+        self.dut.send(b"#1\r")
+        self.assertEqual(self.dut.receive(), b"\r")
+
+
+if __name__ == "__main__":
+    unittest.main()